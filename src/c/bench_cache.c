@@ -0,0 +1,202 @@
+// Benchmark for the ptk_cache file tier codecs.
+// Measures encode/decode throughput and the time to write/read the encoded
+// frames through the file system, for raw and compressed storage.
+#include "cache_codec.h"
+
+#include <ovbase.h>
+
+#ifndef WIN32_LEAN_AND_MEAN
+#  define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+
+#include <stdio.h>
+#include <string.h>
+
+enum {
+  frame_width = 1000,
+  frame_height = 1600,
+  iterations = 20,
+};
+
+struct frame {
+  char const *name;
+  uint8_t *data;
+  size_t size;
+};
+
+static double now_sec(void) {
+  static LARGE_INTEGER freq;
+  if (freq.QuadPart == 0) {
+    QueryPerformanceFrequency(&freq);
+  }
+  LARGE_INTEGER t;
+  QueryPerformanceCounter(&t);
+  return (double)t.QuadPart / (double)freq.QuadPart;
+}
+
+// Character-like frame: an opaque ellipse with an antialiased edge on a transparent background
+static void fill_character(uint8_t *const data) {
+  double const cx = (double)frame_width * 0.5;
+  double const cy = (double)frame_height * 0.55;
+  double const rx = (double)frame_width * 0.3;
+  double const ry = (double)frame_height * 0.4;
+  for (int y = 0; y < frame_height; ++y) {
+    for (int x = 0; x < frame_width; ++x) {
+      uint8_t *const p = data + ((size_t)y * frame_width + (size_t)x) * 4;
+      double const dx = ((double)x - cx) / rx;
+      double const dy = ((double)y - cy) / ry;
+      double const d = dx * dx + dy * dy;
+      if (d > 1.0) {
+        memset(p, 0, 4);
+        continue;
+      }
+      uint8_t const a = d > 0.98 ? (uint8_t)((1.0 - d) * 50.0 * 255.0) : 255;
+      p[0] = (uint8_t)(x * a / frame_width);
+      p[1] = (uint8_t)(y * a / frame_height);
+      p[2] = (uint8_t)((x ^ y) & a);
+      p[3] = a;
+    }
+  }
+}
+
+static void fill_opaque(uint8_t *const data) {
+  uint32_t v = 0x12345678;
+  for (size_t i = 0; i < (size_t)frame_width * frame_height; ++i) {
+    v = v * 1664525 + 1013904223;
+    memcpy(data + i * 4, &v, 3);
+    data[i * 4 + 3] = 255;
+  }
+}
+
+static bool write_file(wchar_t const *const path, void const *const data, size_t const size) {
+  HANDLE const file = CreateFileW(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  DWORD written = 0;
+  bool const ok = WriteFile(file, data, (DWORD)size, &written, NULL) && written == size;
+  CloseHandle(file);
+  return ok;
+}
+
+static bool read_file(wchar_t const *const path, void *const data, size_t const size) {
+  HANDLE const file = CreateFileW(
+      path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  DWORD bytes_read = 0;
+  bool const ok = ReadFile(file, data, (DWORD)size, &bytes_read, NULL) && bytes_read == size;
+  CloseHandle(file);
+  return ok;
+}
+
+static void bench(struct frame const *const f, struct ptk_cache_codec const *const codec, wchar_t const *const path) {
+  uint8_t *encoded = NULL;
+  uint8_t *decoded = NULL;
+  if (!OV_REALLOC(&encoded, codec->bound(f->size), 1) || !OV_REALLOC(&decoded, f->size, 1)) {
+    printf("out of memory\n");
+    goto cleanup;
+  }
+
+  {
+    double encode_sec = 0, decode_sec = 0, write_sec = 0, read_sec = 0;
+    size_t encoded_size = 0;
+    for (int i = 0; i < iterations; ++i) {
+      double t = now_sec();
+      encoded_size = codec->encode(f->data, f->size, encoded);
+      encode_sec += now_sec() - t;
+
+      t = now_sec();
+      if (!write_file(path, encoded, encoded_size)) {
+        printf("write failed\n");
+        goto cleanup;
+      }
+      write_sec += now_sec() - t;
+
+      t = now_sec();
+      if (!read_file(path, encoded, encoded_size)) {
+        printf("read failed\n");
+        goto cleanup;
+      }
+      read_sec += now_sec() - t;
+
+      t = now_sec();
+      if (!codec->decode(encoded, encoded_size, decoded, f->size)) {
+        printf("decode failed\n");
+        goto cleanup;
+      }
+      decode_sec += now_sec() - t;
+    }
+    if (memcmp(decoded, f->data, f->size) != 0) {
+      printf("roundtrip mismatch\n");
+      goto cleanup;
+    }
+
+    double const mb = (double)f->size * iterations / (1024.0 * 1024.0);
+    printf("%-10s %-9s ratio %6.3f  encode %8.1f MB/s  decode %8.1f MB/s  put %8.1f MB/s  get %8.1f MB/s\n",
+           f->name,
+           codec->name,
+           (double)encoded_size / (double)f->size,
+           mb / encode_sec,
+           mb / decode_sec,
+           mb / (encode_sec + write_sec),
+           mb / (read_sec + decode_sec));
+  }
+
+cleanup:
+  if (decoded) {
+    OV_FREE(&decoded);
+  }
+  if (encoded) {
+    OV_FREE(&encoded);
+  }
+}
+
+int main(void) {
+  struct frame frames[] = {
+      {.name = "character"},
+      {.name = "opaque"},
+  };
+  struct ptk_cache_codec const *const codecs[] = {&ptk_cache_codec_raw, &ptk_cache_codec_zero_rle};
+  wchar_t path[MAX_PATH + 32] = {0};
+  int result = 1;
+
+  ov_init();
+
+  DWORD const len = GetTempPathW(MAX_PATH, path);
+  if (len == 0 || len > MAX_PATH) {
+    printf("GetTempPathW failed\n");
+    goto cleanup;
+  }
+  wcscpy(path + len, L"ptk_bench_cache.bin");
+
+  for (size_t i = 0; i < sizeof(frames) / sizeof(frames[0]); ++i) {
+    frames[i].size = (size_t)frame_width * frame_height * 4;
+    if (!OV_REALLOC(&frames[i].data, frames[i].size, 1)) {
+      printf("out of memory\n");
+      goto cleanup;
+    }
+  }
+  fill_character(frames[0].data);
+  fill_opaque(frames[1].data);
+
+  printf("%dx%d BGRA, %d iterations\n", frame_width, frame_height, iterations);
+  for (size_t i = 0; i < sizeof(frames) / sizeof(frames[0]); ++i) {
+    for (size_t j = 0; j < sizeof(codecs) / sizeof(codecs[0]); ++j) {
+      bench(&frames[i], codecs[j], path);
+    }
+  }
+  result = 0;
+
+cleanup:
+  DeleteFileW(path);
+  for (size_t i = 0; i < sizeof(frames) / sizeof(frames[0]); ++i) {
+    if (frames[i].data) {
+      OV_FREE(&frames[i].data);
+    }
+  }
+  ov_exit();
+  return result;
+}
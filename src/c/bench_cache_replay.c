@@ -0,0 +1,211 @@
+// Replay benchmark for the ptk_cache eviction policies.
+// Reads the "PSD:draw: ... cachekey=... size=WxH" lines that debug mode writes to
+// the log and replays them against each policy the way the plugin uses the cache:
+// a draw checks the cache, renders on a miss, then the input plugin borrows the frame.
+//
+// Usage: bench_cache_replay <log file> [memory MiB] [file MiB]
+#include "cache.h"
+#include "logf.h"
+
+#include <ovarray.h>
+#include <ovbase.h>
+
+#ifndef WIN32_LEAN_AND_MEAN
+#  define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Stub for logging functions (cache.c depends on logf.h)
+void ptk_logf_warn(struct ov_error const *const err, char const *const reference, char const *const format, ...) {
+  (void)err;
+  (void)reference;
+  (void)format;
+}
+
+struct access {
+  uint64_t ckey;
+  int32_t width;
+  int32_t height;
+};
+
+static double now_sec(void) {
+  static LARGE_INTEGER freq;
+  if (freq.QuadPart == 0) {
+    QueryPerformanceFrequency(&freq);
+  }
+  LARGE_INTEGER t;
+  QueryPerformanceCounter(&t);
+  return (double)t.QuadPart / (double)freq.QuadPart;
+}
+
+// Parse one log line, returns false if it is not a draw record
+static bool parse_line(char const *const line, struct access *const a) {
+  char const *p = strstr(line, "cachekey=");
+  if (!p) {
+    return false;
+  }
+  char *end = NULL;
+  a->ckey = strtoull(p + 9, &end, 16);
+  if (end != p + 9 + 16) {
+    return false;
+  }
+  p = strstr(end, "size=");
+  if (!p) {
+    return false;
+  }
+  long const w = strtol(p + 5, &end, 10);
+  if (*end != 'x') {
+    return false;
+  }
+  long const h = strtol(end + 1, &end, 10);
+  if (w <= 0 || h <= 0 || w > 16384 || h > 16384) {
+    return false;
+  }
+  a->width = (int32_t)w;
+  a->height = (int32_t)h;
+  return true;
+}
+
+static bool load_trace(char const *const path, struct access **const trace) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    return false;
+  }
+  bool result = false;
+  char line[1024];
+  while (fgets(line, sizeof(line), f)) {
+    struct access a = {0};
+    if (!parse_line(line, &a)) {
+      continue;
+    }
+    size_t const len = OV_ARRAY_LENGTH(*trace);
+    if (!OV_ARRAY_GROW(trace, len + 1)) {
+      goto cleanup;
+    }
+    (*trace)[len] = a;
+    OV_ARRAY_SET_LENGTH(*trace, len + 1);
+  }
+  result = true;
+
+cleanup:
+  fclose(f);
+  return result;
+}
+
+static void replay(struct access const *const trace,
+                   enum ptk_cache_policy const policy,
+                   char const *const name,
+                   size_t const memory_limit,
+                   size_t const file_limit,
+                   uint8_t *const frame) {
+  struct ov_error err = {0};
+  struct ptk_cache *c = NULL;
+  struct ptk_cache_ref *ref = NULL;
+  size_t hits = 0;
+
+  c = ptk_cache_create(&err);
+  if (!c) {
+    printf("ptk_cache_create failed\n");
+    goto cleanup;
+  }
+  ptk_cache_set_policy(c, policy);
+  ptk_cache_set_limits(c, memory_limit, file_limit);
+
+  {
+    size_t const n = OV_ARRAY_LENGTH(trace);
+    double const start = now_sec();
+    for (size_t i = 0; i < n; ++i) {
+      struct access const *const a = &trace[i];
+      if (ptk_cache_contains(c, a->ckey)) {
+        ++hits;
+      } else {
+        memset(frame, (int)(a->ckey & 0xff), (size_t)a->width * (size_t)a->height * 4);
+        if (!ptk_cache_put(c, a->ckey, frame, a->width, a->height, &err)) {
+          printf("ptk_cache_put failed\n");
+          goto cleanup;
+        }
+      }
+      void const *data = NULL;
+      int32_t width = 0;
+      int32_t height = 0;
+      if (!ptk_cache_borrow(c, a->ckey, &ref, &data, &width, &height, &err)) {
+        printf("ptk_cache_borrow failed\n");
+        goto cleanup;
+      }
+      ptk_cache_release(c, &ref);
+    }
+    ptk_cache_flush(c);
+    double const sec = now_sec() - start;
+    printf("%-4s hits %8zu / %8zu (%5.1f%%)  %8.3f sec\n",
+           name,
+           hits,
+           n,
+           n ? (double)hits * 100.0 / (double)n : 0.0,
+           sec);
+  }
+
+cleanup:
+  OV_ERROR_DESTROY(&err);
+  ptk_cache_release(c, &ref);
+  ptk_cache_destroy(&c);
+}
+
+int main(int argc, char **argv) {
+  struct access *trace = NULL;
+  uint8_t *frame = NULL;
+  int result = 1;
+
+  ov_init();
+
+  if (argc < 2) {
+    printf("usage: bench_cache_replay <log file> [memory MiB] [file MiB]\n");
+    goto cleanup;
+  }
+  size_t const memory_limit = (size_t)(argc > 2 ? strtoul(argv[2], NULL, 10) : 256) * 1024 * 1024;
+  size_t const file_limit = (size_t)(argc > 3 ? strtoul(argv[3], NULL, 10) : 256) * 1024 * 1024;
+
+  if (!load_trace(argv[1], &trace)) {
+    printf("failed to read %s\n", argv[1]);
+    goto cleanup;
+  }
+  if (!trace) {
+    printf("no draw records found, enable debug mode to record them\n");
+    goto cleanup;
+  }
+
+  {
+    size_t frame_size = 0;
+    for (size_t i = 0; i < OV_ARRAY_LENGTH(trace); ++i) {
+      size_t const size = (size_t)trace[i].width * (size_t)trace[i].height * 4;
+      if (size > frame_size) {
+        frame_size = size;
+      }
+    }
+    if (!OV_REALLOC(&frame, frame_size, 1)) {
+      printf("out of memory\n");
+      goto cleanup;
+    }
+  }
+
+  printf("%zu draws, memory %zu MiB, file %zu MiB\n",
+         OV_ARRAY_LENGTH(trace),
+         memory_limit / (1024 * 1024),
+         file_limit / (1024 * 1024));
+  replay(trace, ptk_cache_policy_lru, "lru", memory_limit, file_limit, frame);
+  replay(trace, ptk_cache_policy_2q, "2q", memory_limit, file_limit, frame);
+  result = 0;
+
+cleanup:
+  if (frame) {
+    OV_FREE(&frame);
+  }
+  if (trace) {
+    OV_ARRAY_DESTROY(&trace);
+  }
+  ov_exit();
+  return result;
+}
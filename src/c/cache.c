@@ -4,6 +4,7 @@
 #include <ovarray.h>
 #include <ovhashmap.h>
 #include <ovprintf.h>
+#include <ovthreads.h>
 #include <ovutf.h>
 
 #ifndef WIN32_LEAN_AND_MEAN
@@ -13,14 +14,23 @@
 
 #include <string.h>
 
+#include "cache_codec.h"
 #include "logf.h"
 
 enum {
   CACHEKEY_HEX_LEN = 16,
-  MEMORY_CACHE_LIMIT = 256 * 1024 * 1024, // 256MB
-  FILE_CACHE_LIMIT = 256 * 1024 * 1024,   // 256MB
+  DEFAULT_MEMORY_CACHE_LIMIT = 256 * 1024 * 1024, // 256MB
+  DEFAULT_FILE_CACHE_LIMIT = 256 * 1024 * 1024,   // 256MB
+  PERSIST_INDEX_MAGIC = 0x50435450,               // "PTCP"
+  PERSIST_INDEX_VERSION = 1,
+  WRITE_QUEUE_CAPACITY = 16,
 };
 
+static wchar_t const g_persist_dir_name[] = L"PSDToolKitCache";
+static wchar_t const g_persist_index_name[] = L"index.bin";
+static wchar_t const g_persist_index_tmp_name[] = L"index.tmp";
+static wchar_t const g_persist_lock_name[] = L"lock";
+
 // Convert uint64 cache key to 16-character hex string
 static void ckey_to_hex(uint64_t ckey, char hex[CACHEKEY_HEX_LEN + 1]) {
   static char const hexchars[] = "0123456789abcdef";
@@ -37,25 +47,143 @@ struct cache_entry {
   int32_t height;
   uint8_t *data;    // BGRA pixel data (memory tier only)
   size_t data_size; // width * height * 4
+  HANDLE mapping;   // file mapping backing data when adopted from a slot, NULL for heap data
   bool in_file;     // true if data is in file tier
+  size_t file_size; // size of the cache file (file tier only)
+  size_t refcount;  // number of outstanding borrows, pinned in memory while > 0
+  bool orphaned;    // removed from the cache while borrowed, freed on last release
+  bool writing;     // queued for the writer thread, pinned in memory until collected
+  // Eviction policy state
+  bool protected_;     // in the protected list (2Q only)
+  uint32_t references; // number of borrows while on probation (2Q only)
   // LRU doubly-linked list
   struct cache_entry *lru_prev;
   struct cache_entry *lru_next;
 };
 
+struct cache_lru {
+  struct cache_entry *head; // oldest (first to evict)
+  struct cache_entry *tail; // newest
+};
+
+// Scratch buffer for encoding and decoding, one per thread
+struct codec_buf {
+  uint8_t *ptr;
+  size_t size;
+};
+
+// A cache file written by the writer thread.
+// The entry data is only read by the writer and stays valid until the job is collected.
+struct write_job {
+  struct cache_entry *entry;
+  wchar_t const *dir; // temp_dir or persist_dir
+  struct ptk_cache_codec const *codec;
+  bool persistent; // true for a copy to the persistent tier, false for a move to the file tier
+  // Set by the writer thread
+  bool ok;
+  size_t file_size;
+  struct ov_error err;
+};
+
+// Eviction order of the memory and file tiers.
+// The persistent tier always uses plain LRU.
+struct cache_policy {
+  // Add a new entry
+  void (*add)(struct ptk_cache *c, struct cache_entry *entry);
+  // Mark an entry as used, borrowed is true when its data was handed out
+  void (*touch)(struct ptk_cache *c, struct cache_entry *entry, bool borrowed);
+  // Remove an entry
+  void (*remove)(struct ptk_cache *c, struct cache_entry *entry);
+  // Next eviction candidate after entry, or the first one if entry is NULL
+  struct cache_entry *(*next)(struct ptk_cache const *c, struct cache_entry const *entry);
+};
+
 struct ptk_cache {
   wchar_t *temp_dir;            // %TEMP%/ptk_{pid}_{id}/ (null-terminated, OV_ARRAY)
   HANDLE dir_lock;              // directory lock handle
   struct ov_hashmap *entries;   // cachekey_hex -> cache_entry* (pointer to heap-allocated entry)
-  struct cache_entry *lru_head; // oldest (first to evict)
-  struct cache_entry *lru_tail; // newest
+  struct cache_policy const *policy;
+  struct cache_lru lru;           // all entries for LRU, probation entries for 2Q
+  struct cache_lru protected_lru; // protected entries for 2Q
+  size_t protected_size;          // total data_size of protected entries
   size_t memory_used;
   size_t file_used;
+  size_t memory_limit;
+  size_t file_limit;
+  struct ptk_cache_codec const *codec; // codec for new cache files
+  struct codec_buf read_buf;           // used by the calling thread for decoding
+  // Writer thread, cache files are written behind so callers never wait on disk I/O.
+  // Jobs are a ring: [collect, pos) are written, [pos, tail) are waiting for the writer.
+  thrd_t writer;
+  bool writer_created;
+  mtx_t write_mtx;
+  cnd_t write_cnd;
+  struct write_job write_jobs[WRITE_QUEUE_CAPACITY];
+  size_t write_tail;          // guarded by write_mtx
+  size_t write_pos;           // guarded by write_mtx
+  size_t write_collect;       // calling thread only
+  bool write_exit;            // guarded by write_mtx
+  size_t memory_pending;      // bytes of memory tier entries being moved to the file tier
+  struct codec_buf write_buf; // used by the writer thread for encoding
+  // Persistent tier, NULL persist_dir when disabled
+  wchar_t *persist_dir;                // directory with trailing separator (null-terminated, OV_ARRAY)
+  HANDLE persist_lock;                 // lock file handle, deleted on close
+  struct ov_hashmap *persist_entries;  // cachekey_hex -> cache_entry* (file_size only, no data)
+  struct cache_lru persist_lru;
+  uint64_t persist_used;
+  uint64_t persist_limit;
+  // Counters, current sizes are filled in by ptk_cache_get_stats
+  struct ptk_cache_stats stats;
+};
+
+// Header of a cache file, followed by size bytes of encoded pixel data
+struct cache_file_header {
+  int32_t width;
+  int32_t height;
+  uint32_t codec_id;
+  uint32_t size;
+};
+
+// Persistent tier index, followed by count records from oldest to newest
+struct persist_index_header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t count;
+};
+
+struct persist_index_record {
+  char cachekey_hex[CACHEKEY_HEX_LEN];
+  int32_t width;
+  int32_t height;
+  uint32_t file_size;
+};
+
+struct ptk_cache_slot {
+  HANDLE mapping;
+  uint8_t *data;
+  int32_t width;
+  int32_t height;
+  char name[64];
 };
 
+// Monotonic time in microseconds
+static uint64_t now_usec(void) {
+  static LARGE_INTEGER freq;
+  if (freq.QuadPart == 0) {
+    QueryPerformanceFrequency(&freq);
+  }
+  LARGE_INTEGER t;
+  QueryPerformanceCounter(&t);
+  return (uint64_t)(t.QuadPart / freq.QuadPart) * 1000000 +
+         (uint64_t)(t.QuadPart % freq.QuadPart) * 1000000 / (uint64_t)freq.QuadPart;
+}
+
 // Instance counter for unique directory names
 static LONG g_instance_counter = 0;
 
+// Slot counter for unique file mapping names
+static LONG g_slot_counter = 0;
+
 static void get_entry_key(void const *const item, void const **const key, size_t *const key_bytes) {
   // item is a pointer to cache_entry* (i.e., cache_entry**)
   struct cache_entry *const *const entry_ptr = (struct cache_entry *const *)item;
@@ -63,67 +191,182 @@ static void get_entry_key(void const *const item, void const **const key, size_t
   *key_bytes = CACHEKEY_HEX_LEN;
 }
 
+// Release memory tier storage of an entry
+static void free_entry_data(struct cache_entry *entry) {
+  if (entry->mapping) {
+    if (entry->data) {
+      UnmapViewOfFile(entry->data);
+    }
+    CloseHandle(entry->mapping);
+    entry->mapping = NULL;
+    entry->data = NULL;
+    return;
+  }
+  if (entry->data) {
+    OV_FREE(&entry->data);
+  }
+}
+
+// Look up an entry by hex key, returns NULL if not found
+static struct cache_entry *find_entry(struct ov_hashmap *const map, char const cachekey_hex[CACHEKEY_HEX_LEN + 1]) {
+  if (!map) {
+    return NULL;
+  }
+  struct cache_entry key_entry = {0};
+  memcpy(key_entry.cachekey_hex, cachekey_hex, CACHEKEY_HEX_LEN);
+  struct cache_entry *key_ptr = &key_entry;
+  void const *const_ptr = OV_HASHMAP_GET(map, &key_ptr);
+  return const_ptr ? *(struct cache_entry *const *)const_ptr : NULL;
+}
+
 // Move entry to tail of LRU list (most recently used)
-static void lru_touch(struct ptk_cache *const c, struct cache_entry *entry) {
-  if (entry == c->lru_tail) {
+static void lru_touch(struct cache_lru *const l, struct cache_entry *entry) {
+  if (entry == l->tail) {
     return; // already at tail
   }
   // Remove from current position
   if (entry->lru_prev) {
     entry->lru_prev->lru_next = entry->lru_next;
   } else {
-    c->lru_head = entry->lru_next;
+    l->head = entry->lru_next;
   }
   if (entry->lru_next) {
     entry->lru_next->lru_prev = entry->lru_prev;
   }
   // Add to tail
-  entry->lru_prev = c->lru_tail;
+  entry->lru_prev = l->tail;
   entry->lru_next = NULL;
-  if (c->lru_tail) {
-    c->lru_tail->lru_next = entry;
+  if (l->tail) {
+    l->tail->lru_next = entry;
   }
-  c->lru_tail = entry;
-  if (!c->lru_head) {
-    c->lru_head = entry;
+  l->tail = entry;
+  if (!l->head) {
+    l->head = entry;
   }
 }
 
 // Remove entry from LRU list
-static void lru_remove(struct ptk_cache *const c, struct cache_entry *entry) {
+static void lru_remove(struct cache_lru *const l, struct cache_entry *entry) {
   if (entry->lru_prev) {
     entry->lru_prev->lru_next = entry->lru_next;
   } else {
-    c->lru_head = entry->lru_next;
+    l->head = entry->lru_next;
   }
   if (entry->lru_next) {
     entry->lru_next->lru_prev = entry->lru_prev;
   } else {
-    c->lru_tail = entry->lru_prev;
+    l->tail = entry->lru_prev;
   }
   entry->lru_prev = NULL;
   entry->lru_next = NULL;
 }
 
 // Add entry to tail of LRU list
-static void lru_add(struct ptk_cache *const c, struct cache_entry *entry) {
-  entry->lru_prev = c->lru_tail;
+static void lru_add(struct cache_lru *const l, struct cache_entry *entry) {
+  entry->lru_prev = l->tail;
   entry->lru_next = NULL;
-  if (c->lru_tail) {
-    c->lru_tail->lru_next = entry;
+  if (l->tail) {
+    l->tail->lru_next = entry;
+  }
+  l->tail = entry;
+  if (!l->head) {
+    l->head = entry;
+  }
+}
+
+static void lru_policy_add(struct ptk_cache *const c, struct cache_entry *const entry) { lru_add(&c->lru, entry); }
+
+static void lru_policy_touch(struct ptk_cache *const c, struct cache_entry *const entry, bool const borrowed) {
+  (void)borrowed;
+  lru_touch(&c->lru, entry);
+}
+
+static void lru_policy_remove(struct ptk_cache *const c, struct cache_entry *const entry) {
+  lru_remove(&c->lru, entry);
+}
+
+static struct cache_entry *lru_policy_next(struct ptk_cache const *const c, struct cache_entry const *const entry) {
+  return entry ? entry->lru_next : c->lru.head;
+}
+
+static struct cache_policy const g_lru_policy = {
+    .add = lru_policy_add,
+    .touch = lru_policy_touch,
+    .remove = lru_policy_remove,
+    .next = lru_policy_next,
+};
+
+// Simplified 2Q.
+// New entries wait in a probation FIFO (c->lru) and move to the protected LRU
+// when borrowed a second time, so frames that are only shown once while
+// scrubbing or playing through the timeline are evicted before frames that
+// keep coming back. The protected list is capped to leave room for probation.
+static void twoq_demote_overflow(struct ptk_cache *const c) {
+  size_t const cap = (c->memory_limit / 4 + c->file_limit / 4) * 3;
+  while (c->protected_size > cap && c->protected_lru.head) {
+    struct cache_entry *const entry = c->protected_lru.head;
+    lru_remove(&c->protected_lru, entry);
+    c->protected_size -= entry->data_size;
+    entry->protected_ = false;
+    entry->references = 1; // promoted again by the next borrow
+    lru_add(&c->lru, entry);
+  }
+}
+
+static void twoq_add(struct ptk_cache *const c, struct cache_entry *const entry) {
+  entry->protected_ = false;
+  entry->references = 0;
+  lru_add(&c->lru, entry);
+}
+
+static void twoq_touch(struct ptk_cache *const c, struct cache_entry *const entry, bool const borrowed) {
+  if (entry->protected_) {
+    lru_touch(&c->protected_lru, entry);
+    return;
+  }
+  if (!borrowed || ++entry->references < 2) {
+    return; // probation is FIFO
+  }
+  lru_remove(&c->lru, entry);
+  entry->protected_ = true;
+  lru_add(&c->protected_lru, entry);
+  c->protected_size += entry->data_size;
+  twoq_demote_overflow(c);
+}
+
+static void twoq_remove(struct ptk_cache *const c, struct cache_entry *const entry) {
+  if (!entry->protected_) {
+    lru_remove(&c->lru, entry);
+    return;
   }
-  c->lru_tail = entry;
-  if (!c->lru_head) {
-    c->lru_head = entry;
+  lru_remove(&c->protected_lru, entry);
+  c->protected_size -= entry->data_size;
+  entry->protected_ = false;
+}
+
+static struct cache_entry *twoq_next(struct ptk_cache const *const c, struct cache_entry const *const entry) {
+  if (!entry) {
+    return c->lru.head ? c->lru.head : c->protected_lru.head;
   }
+  if (entry->lru_next || entry->protected_) {
+    return entry->lru_next;
+  }
+  return c->protected_lru.head;
 }
 
+static struct cache_policy const g_2q_policy = {
+    .add = twoq_add,
+    .touch = twoq_touch,
+    .remove = twoq_remove,
+    .next = twoq_next,
+};
+
 // Build file path for cache entry
-static bool build_cache_file_path(struct ptk_cache const *const c,
+static bool build_cache_file_path(wchar_t const *const dir,
                                   wchar_t **path,
                                   char const *cachekey_hex,
                                   struct ov_error *const err) {
-  size_t const dir_len = OV_ARRAY_LENGTH(c->temp_dir);
+  size_t const dir_len = OV_ARRAY_LENGTH(dir);
   size_t const filename_len = CACHEKEY_HEX_LEN + 4; // "xxxx.bin"
   bool result = false;
 
@@ -131,7 +374,7 @@ static bool build_cache_file_path(struct ptk_cache const *const c,
     OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
     goto cleanup;
   }
-  memcpy(*path, c->temp_dir, dir_len * sizeof(wchar_t));
+  memcpy(*path, dir, dir_len * sizeof(wchar_t));
   for (size_t i = 0; i < CACHEKEY_HEX_LEN; ++i) {
     (*path)[dir_len + i] = (wchar_t)cachekey_hex[i];
   }
@@ -147,16 +390,49 @@ cleanup:
   return result;
 }
 
-// Write entry data to file
-static bool
-write_entry_to_file(struct ptk_cache const *const c, struct cache_entry *entry, struct ov_error *const err) {
+// Make sure the codec scratch buffer holds at least size bytes
+static bool ensure_codec_buf(struct codec_buf *const buf, size_t const size, struct ov_error *const err) {
+  if (buf->size >= size) {
+    return true;
+  }
+  if (!OV_REALLOC(&buf->ptr, size, 1)) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
+    return false;
+  }
+  buf->size = size;
+  return true;
+}
+
+// Write entry data to a file in dir
+static bool write_entry_to_file(struct codec_buf *const buf,
+                                wchar_t const *const dir,
+                                struct ptk_cache_codec const *codec,
+                                struct cache_entry const *entry,
+                                size_t *const file_size,
+                                struct ov_error *const err) {
   wchar_t *path = NULL;
   HANDLE file = INVALID_HANDLE_VALUE;
   DWORD written = 0;
-  size_t data_size = 0;
   bool result = false;
 
-  if (!build_cache_file_path(c, &path, entry->cachekey_hex, err)) {
+  // Encode first; fall back to raw when the codec does not help
+  uint8_t const *payload = entry->data;
+  size_t payload_size = entry->data_size;
+  if (codec != &ptk_cache_codec_raw) {
+    if (!ensure_codec_buf(buf, codec->bound(entry->data_size), err)) {
+      OV_ERROR_ADD_TRACE(err);
+      goto cleanup;
+    }
+    size_t const encoded_size = codec->encode(entry->data, entry->data_size, buf->ptr);
+    if (encoded_size < entry->data_size) {
+      payload = buf->ptr;
+      payload_size = encoded_size;
+    } else {
+      codec = &ptk_cache_codec_raw;
+    }
+  }
+
+  if (!build_cache_file_path(dir, &path, entry->cachekey_hex, err)) {
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
@@ -167,22 +443,25 @@ write_entry_to_file(struct ptk_cache const *const c, struct cache_entry *entry,
     goto cleanup;
   }
 
-  // Write header: width, height
-  if (!WriteFile(file, &entry->width, sizeof(entry->width), &written, NULL) || written != sizeof(entry->width)) {
-    OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
-    goto cleanup;
-  }
-  if (!WriteFile(file, &entry->height, sizeof(entry->height), &written, NULL) || written != sizeof(entry->height)) {
-    OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
-    goto cleanup;
+  {
+    struct cache_file_header const header = {
+        .width = entry->width,
+        .height = entry->height,
+        .codec_id = codec->id,
+        .size = (uint32_t)payload_size,
+    };
+    if (!WriteFile(file, &header, sizeof(header), &written, NULL) || written != sizeof(header)) {
+      OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
+      goto cleanup;
+    }
   }
 
   // Write pixel data
-  data_size = entry->data_size;
-  if (!WriteFile(file, entry->data, (DWORD)data_size, &written, NULL) || written != data_size) {
+  if (!WriteFile(file, payload, (DWORD)payload_size, &written, NULL) || written != payload_size) {
     OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
     goto cleanup;
   }
+  *file_size = sizeof(struct cache_file_header) + payload_size;
 
   result = true;
 
@@ -197,59 +476,92 @@ cleanup:
   return result;
 }
 
-// Read entry data from file
-static bool
-read_entry_from_file(struct ptk_cache const *const c, struct cache_entry *entry, struct ov_error *const err) {
+// Read entry data from a file in dir
+static bool read_entry_from_file(struct ptk_cache *const c,
+                                 wchar_t const *const dir,
+                                 struct cache_entry *entry,
+                                 struct ov_error *const err) {
   wchar_t *path = NULL;
   HANDLE file = INVALID_HANDLE_VALUE;
   DWORD bytes_read = 0;
-  int32_t width = 0;
-  int32_t height = 0;
+  struct cache_file_header header = {0};
+  struct ptk_cache_codec const *codec = NULL;
   size_t data_size = 0;
+  uint64_t const start = now_usec();
   bool result = false;
 
-  if (!build_cache_file_path(c, &path, entry->cachekey_hex, err)) {
+  if (!build_cache_file_path(dir, &path, entry->cachekey_hex, err)) {
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
 
-  file = CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  file = CreateFileW(path,
+                     GENERIC_READ,
+                     FILE_SHARE_READ,
+                     NULL,
+                     OPEN_EXISTING,
+                     FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                     NULL);
   if (file == INVALID_HANDLE_VALUE) {
     OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
     goto cleanup;
   }
 
   // Read header
-  if (!ReadFile(file, &width, sizeof(width), &bytes_read, NULL) || bytes_read != sizeof(width)) {
-    OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
-    goto cleanup;
-  }
-  if (!ReadFile(file, &height, sizeof(height), &bytes_read, NULL) || bytes_read != sizeof(height)) {
+  if (!ReadFile(file, &header, sizeof(header), &bytes_read, NULL) || bytes_read != sizeof(header)) {
     OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
     goto cleanup;
   }
 
-  // Validate dimensions
-  if (width != entry->width || height != entry->height) {
+  // Validate dimensions and codec
+  codec = ptk_cache_codec_find(header.codec_id);
+  if (header.width != entry->width || header.height != entry->height || !codec) {
     OV_ERROR_SET_GENERIC(err, ov_error_generic_fail);
     goto cleanup;
   }
 
   // Allocate and read pixel data
-  data_size = (size_t)width * (size_t)height * 4;
+  data_size = (size_t)header.width * (size_t)header.height * 4;
   if (!OV_REALLOC(&entry->data, data_size, 1)) {
     OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
     goto cleanup;
   }
-  if (!ReadFile(file, entry->data, (DWORD)data_size, &bytes_read, NULL) || bytes_read != data_size) {
-    OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
-    goto cleanup;
+  if (codec == &ptk_cache_codec_raw) {
+    if (header.size != data_size || !ReadFile(file, entry->data, (DWORD)data_size, &bytes_read, NULL) ||
+        bytes_read != data_size) {
+      OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
+      goto cleanup;
+    }
+  } else {
+    if (!ensure_codec_buf(&c->read_buf, header.size, err)) {
+      OV_ERROR_ADD_TRACE(err);
+      goto cleanup;
+    }
+    if (!ReadFile(file, c->read_buf.ptr, header.size, &bytes_read, NULL) || bytes_read != header.size) {
+      OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
+      goto cleanup;
+    }
+    if (!codec->decode(c->read_buf.ptr, header.size, entry->data, data_size)) {
+      OV_ERROR_SET_GENERIC(err, ov_error_generic_fail);
+      goto cleanup;
+    }
   }
   entry->data_size = data_size;
 
+  {
+    uint64_t const elapsed = now_usec() - start;
+    ++c->stats.file_reads;
+    c->stats.file_read_usec += elapsed;
+    if (elapsed > c->stats.file_read_max_usec) {
+      c->stats.file_read_max_usec = elapsed;
+    }
+  }
   result = true;
 
 cleanup:
+  if (!result && entry->data) {
+    OV_FREE(&entry->data);
+  }
   if (file != INVALID_HANDLE_VALUE) {
     CloseHandle(file);
     file = INVALID_HANDLE_VALUE;
@@ -261,11 +573,11 @@ cleanup:
 }
 
 // Delete cache file for entry
-static void delete_entry_file(struct ptk_cache const *const c, struct cache_entry const *entry) {
+static void delete_entry_file(wchar_t const *const dir, struct cache_entry const *entry) {
   wchar_t *path = NULL;
   struct ov_error err = {0};
 
-  if (!build_cache_file_path(c, &path, entry->cachekey_hex, &err)) {
+  if (!build_cache_file_path(dir, &path, entry->cachekey_hex, &err)) {
     OV_ERROR_REPORT(&err, NULL);
     goto cleanup;
   }
@@ -278,57 +590,33 @@ cleanup:
   }
 }
 
-// Evict entries from memory to file tier
-static bool evict_memory_to_file(struct ptk_cache *const c, struct ov_error *const err) {
-  bool result = false;
-
-  while (c->memory_used > MEMORY_CACHE_LIMIT && c->lru_head) {
-    // Find oldest entry in memory
-    struct cache_entry *entry = c->lru_head;
-    while (entry && entry->in_file) {
-      entry = entry->lru_next;
-    }
-    if (!entry) {
-      break; // No more memory entries
-    }
-
-    // Write to file
-    if (!write_entry_to_file(c, entry, err)) {
-      OV_ERROR_ADD_TRACE(err);
-      goto cleanup;
-    }
-
-    // Free memory, mark as file-based
-    c->memory_used -= entry->data_size;
-    c->file_used += entry->data_size;
-    OV_FREE(&entry->data);
-    entry->in_file = true;
-  }
-  result = true;
-
-cleanup:
-  return result;
+// Remove an unborrowed entry from the memory and file tiers and free it.
+// Accounting and file deletion are up to the caller.
+static void remove_entry(struct ptk_cache *const c, struct cache_entry *entry) {
+  c->policy->remove(c, entry);
+  struct cache_entry *entry_for_delete = entry;
+  OV_HASHMAP_DELETE(c->entries, &entry_for_delete);
+  free_entry_data(entry);
+  OV_FREE(&entry);
 }
 
 // Evict entries from file tier (delete)
 static void evict_file_tier(struct ptk_cache *const c) {
-  while (c->file_used > FILE_CACHE_LIMIT && c->lru_head) {
-    // Find oldest entry in file tier
-    struct cache_entry *entry = c->lru_head;
+  while (c->file_used > c->file_limit) {
+    // Find the first entry in file tier in eviction order
+    struct cache_entry *entry = c->policy->next(c, NULL);
     while (entry && !entry->in_file) {
-      entry = entry->lru_next;
+      entry = c->policy->next(c, entry);
     }
     if (!entry) {
       break;
     }
 
     // Delete file and remove from cache
-    delete_entry_file(c, entry);
-    c->file_used -= entry->data_size;
-    lru_remove(c, entry);
-    struct cache_entry *entry_for_delete = entry;
-    OV_HASHMAP_DELETE(c->entries, &entry_for_delete);
-    OV_FREE(&entry);
+    delete_entry_file(c->temp_dir, entry);
+    c->file_used -= entry->file_size;
+    remove_entry(c, entry);
+    ++c->stats.file_evictions;
   }
 }
 
@@ -485,127 +773,938 @@ cleanup:
   }
 }
 
-struct ptk_cache *ptk_cache_create(struct ov_error *const err) {
-  struct ptk_cache *cache = NULL;
-
-  // Cleanup orphaned directories first
-  cleanup_orphaned_directories();
-
-  // Allocate cache structure
-  if (!OV_REALLOC(&cache, 1, sizeof(struct ptk_cache))) {
+// Persistent tier
+//
+// Entries written to the persistent directory outlive the cache instance and are
+// found again by later instances. index.bin keeps their LRU order between sessions,
+// files missing from it (e.g. written after the last index save before a crash)
+// are adopted when the directory is opened.
+
+// Build path: dir + name
+static bool build_persist_path(wchar_t const *const dir,
+                               wchar_t const *const name,
+                               wchar_t **const path,
+                               struct ov_error *const err) {
+  size_t const dir_len = OV_ARRAY_LENGTH(dir);
+  size_t const name_len = wcslen(name);
+  if (!OV_ARRAY_GROW(path, dir_len + name_len + 1)) {
     OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
-    goto cleanup;
+    return false;
   }
-  *cache = (struct ptk_cache){
-      .dir_lock = INVALID_HANDLE_VALUE,
-  };
+  memcpy(*path, dir, dir_len * sizeof(wchar_t));
+  memcpy(*path + dir_len, name, (name_len + 1) * sizeof(wchar_t));
+  OV_ARRAY_SET_LENGTH(*path, dir_len + name_len);
+  return true;
+}
 
-  // Get temp path
-  {
+// Build the persistent directory path with a trailing separator.
+// dir NULL selects %TEMP%\PSDToolKitCache\.
+static bool build_persist_dir(wchar_t const *const dir, wchar_t **const path, struct ov_error *const err) {
+  wchar_t *base = NULL;
+  size_t base_len = 0;
+  bool result = false;
+
+  if (dir) {
+    base_len = wcslen(dir);
+    if (!OV_ARRAY_GROW(&base, base_len + 1)) {
+      OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
+      goto cleanup;
+    }
+    memcpy(base, dir, (base_len + 1) * sizeof(wchar_t));
+  } else {
     DWORD const temp_len = GetTempPathW(0, NULL);
     if (temp_len == 0) {
       OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
       goto cleanup;
     }
-
-    wchar_t *temp_path = NULL;
-    if (!OV_ARRAY_GROW(&temp_path, temp_len)) {
+    size_t const name_len = wcslen(g_persist_dir_name);
+    if (!OV_ARRAY_GROW(&base, temp_len + name_len)) {
       OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
       goto cleanup;
     }
-    GetTempPathW(temp_len, temp_path);
-    size_t const actual_temp_len = wcslen(temp_path);
-    OV_ARRAY_SET_LENGTH(temp_path, actual_temp_len);
-
-    // Build directory name: ptk_{pid}_{instance}/
-    DWORD const pid = GetCurrentProcessId();
-    LONG const instance_id = InterlockedIncrement(&g_instance_counter);
-    wchar_t suffix_str[32] = {0};
-    int const suffix_len = ov_snprintf_wchar(
-        suffix_str, sizeof(suffix_str) / sizeof(suffix_str[0]), NULL, L"%1$lu_%2$ld", pid, instance_id);
-    if (suffix_len < 0) {
-      OV_ARRAY_DESTROY(&temp_path);
-      OV_ERROR_SET_GENERIC(err, ov_error_generic_fail);
-      goto cleanup;
-    }
+    GetTempPathW(temp_len, base);
+    base_len = wcslen(base);
+    memcpy(base + base_len, g_persist_dir_name, (name_len + 1) * sizeof(wchar_t));
+    base_len += name_len;
+  }
+  if (base_len == 0) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_invalid_argument);
+    goto cleanup;
+  }
 
-    // temp_path + "ptk_" + suffix + "\"
-    size_t const dir_len = actual_temp_len + 4 + (size_t)suffix_len + 1;
-    if (!OV_ARRAY_GROW(&cache->temp_dir, dir_len + 1)) {
-      OV_ARRAY_DESTROY(&temp_path);
+  {
+    bool const has_sep = base[base_len - 1] == L'\\' || base[base_len - 1] == L'/';
+    size_t const len = base_len + (has_sep ? 0 : 1);
+    if (!OV_ARRAY_GROW(path, len + 1)) {
       OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
       goto cleanup;
     }
-    memcpy(cache->temp_dir, temp_path, actual_temp_len * sizeof(wchar_t));
-    cache->temp_dir[actual_temp_len + 0] = L'p';
-    cache->temp_dir[actual_temp_len + 1] = L't';
-    cache->temp_dir[actual_temp_len + 2] = L'k';
-    cache->temp_dir[actual_temp_len + 3] = L'_';
-    memcpy(cache->temp_dir + actual_temp_len + 4, suffix_str, (size_t)suffix_len * sizeof(wchar_t));
-    cache->temp_dir[actual_temp_len + 4 + (size_t)suffix_len] = L'\\';
-    cache->temp_dir[actual_temp_len + 4 + (size_t)suffix_len + 1] = L'\0';
-    OV_ARRAY_SET_LENGTH(cache->temp_dir, dir_len);
+    memcpy(*path, base, base_len * sizeof(wchar_t));
+    (*path)[len - 1] = has_sep ? base[base_len - 1] : L'\\';
+    (*path)[len] = L'\0';
+    OV_ARRAY_SET_LENGTH(*path, len);
+  }
 
-    OV_ARRAY_DESTROY(&temp_path);
+  result = true;
+
+cleanup:
+  if (base) {
+    OV_ARRAY_DESTROY(&base);
   }
+  return result;
+}
 
-  // Create directory
-  if (!CreateDirectoryW(cache->temp_dir, NULL)) {
-    DWORD const e = GetLastError();
-    if (e != ERROR_ALREADY_EXISTS) {
-      OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(e));
-      goto cleanup;
+static bool is_cachekey_hex(char const *const s) {
+  for (size_t i = 0; i < CACHEKEY_HEX_LEN; ++i) {
+    if (!((s[i] >= '0' && s[i] <= '9') || (s[i] >= 'a' && s[i] <= 'f'))) {
+      return false;
     }
   }
+  return true;
+}
 
-  // Lock directory
-  cache->dir_lock = CreateFileW(cache->temp_dir,
-                                GENERIC_READ,
-                                0, // no sharing
-                                NULL,
-                                OPEN_EXISTING,
-                                FILE_FLAG_BACKUP_SEMANTICS,
-                                NULL);
-  if (cache->dir_lock == INVALID_HANDLE_VALUE) {
-    OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
-    goto cleanup;
+// Register a persistent tier entry as the most recently used one
+static bool persist_add(struct ptk_cache *const c,
+                        char const *const cachekey_hex,
+                        int32_t const width,
+                        int32_t const height,
+                        size_t const file_size,
+                        struct ov_error *const err) {
+  struct cache_entry *entry = NULL;
+  if (!OV_REALLOC(&entry, 1, sizeof(struct cache_entry))) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
+    return false;
   }
+  *entry = (struct cache_entry){
+      .width = width,
+      .height = height,
+      .in_file = true,
+      .file_size = file_size,
+  };
+  memcpy(entry->cachekey_hex, cachekey_hex, CACHEKEY_HEX_LEN);
 
-  // Create hashmap (stores cache_entry* pointers, not cache_entry directly)
-  cache->entries = OV_HASHMAP_CREATE_DYNAMIC(sizeof(struct cache_entry *), 64, get_entry_key);
-  if (!cache->entries) {
+  struct cache_entry *entry_ptr = entry;
+  if (!OV_HASHMAP_SET(c->persist_entries, &entry_ptr)) {
+    OV_FREE(&entry);
     OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
-    goto cleanup;
+    return false;
   }
+  lru_add(&c->persist_lru, entry);
+  c->persist_used += file_size;
+  return true;
+}
 
-  return cache;
-
-cleanup:
-  ptk_cache_destroy(&cache);
-  return NULL;
+// Delete a persistent tier entry and its file
+static void persist_drop(struct ptk_cache *const c, struct cache_entry *entry) {
+  delete_entry_file(c->persist_dir, entry);
+  c->persist_used -= entry->file_size;
+  lru_remove(&c->persist_lru, entry);
+  struct cache_entry *entry_for_delete = entry;
+  OV_HASHMAP_DELETE(c->persist_entries, &entry_for_delete);
+  OV_FREE(&entry);
 }
 
-void ptk_cache_destroy(struct ptk_cache **const c) {
-  if (!c || !*c) {
-    return;
+// Delete the oldest persistent tier entries until the size limit is met
+static void persist_evict(struct ptk_cache *const c) {
+  while (c->persist_used > c->persist_limit && c->persist_lru.head) {
+    persist_drop(c, c->persist_lru.head);
+    ++c->stats.persistent_evictions;
   }
+}
 
-  struct ptk_cache *cache = *c;
-
-  ptk_cache_clear(cache);
-  if (cache->entries) {
-    OV_HASHMAP_DESTROY(&cache->entries);
-  }
-  if (cache->dir_lock != INVALID_HANDLE_VALUE) {
-    CloseHandle(cache->dir_lock);
-    cache->dir_lock = INVALID_HANDLE_VALUE;
-  }
-  if (cache->temp_dir) {
-    // Delete the directory (should be empty now)
-    RemoveDirectoryW(cache->temp_dir);
-    OV_ARRAY_DESTROY(&cache->temp_dir);
+// Mark a persisted key as recently used, returns false if it is not persisted
+static bool persist_touch(struct ptk_cache *const c, char const cachekey_hex[CACHEKEY_HEX_LEN + 1]) {
+  struct cache_entry *const entry = find_entry(c->persist_entries, cachekey_hex);
+  if (!entry) {
+    return false;
   }
-  OV_FREE(c);
+  lru_touch(&c->persist_lru, entry);
+  return true;
+}
+
+// Load index.bin. A missing, foreign or truncated index is ignored,
+// persist_adopt_files picks up the files it would have listed.
+// Files listed in the index but deleted since are dropped when first read.
+static bool persist_load_index(struct ptk_cache *const c, struct ov_error *const err) {
+  wchar_t *path = NULL;
+  HANDLE file = INVALID_HANDLE_VALUE;
+  struct persist_index_record *records = NULL;
+  DWORD bytes_read = 0;
+  struct persist_index_header header = {0};
+  bool result = false;
+
+  if (!build_persist_path(c->persist_dir, g_persist_index_name, &path, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
+
+  file = CreateFileW(path,
+                     GENERIC_READ,
+                     FILE_SHARE_READ,
+                     NULL,
+                     OPEN_EXISTING,
+                     FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                     NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    DWORD const e = GetLastError();
+    if (e == ERROR_FILE_NOT_FOUND) {
+      result = true;
+      goto cleanup;
+    }
+    OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(e));
+    goto cleanup;
+  }
+
+  if (!ReadFile(file, &header, sizeof(header), &bytes_read, NULL) || bytes_read != sizeof(header) ||
+      header.magic != PERSIST_INDEX_MAGIC || header.version != PERSIST_INDEX_VERSION || header.count == 0) {
+    result = true;
+    goto cleanup;
+  }
+
+  {
+    size_t const records_size = (size_t)header.count * sizeof(struct persist_index_record);
+    if (!OV_REALLOC(&records, header.count, sizeof(struct persist_index_record))) {
+      OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
+      goto cleanup;
+    }
+    if (!ReadFile(file, records, (DWORD)records_size, &bytes_read, NULL) || bytes_read != records_size) {
+      result = true;
+      goto cleanup;
+    }
+  }
+
+  for (uint32_t i = 0; i < header.count; ++i) {
+    struct persist_index_record const *const r = &records[i];
+    char cachekey_hex[CACHEKEY_HEX_LEN + 1];
+    memcpy(cachekey_hex, r->cachekey_hex, CACHEKEY_HEX_LEN);
+    cachekey_hex[CACHEKEY_HEX_LEN] = '\0';
+    if (!is_cachekey_hex(cachekey_hex) || r->width <= 0 || r->height <= 0 || r->file_size == 0 ||
+        find_entry(c->persist_entries, cachekey_hex)) {
+      continue;
+    }
+    if (!persist_add(c, cachekey_hex, r->width, r->height, r->file_size, err)) {
+      OV_ERROR_ADD_TRACE(err);
+      goto cleanup;
+    }
+  }
+
+  result = true;
+
+cleanup:
+  if (records) {
+    OV_FREE(&records);
+  }
+  if (file != INVALID_HANDLE_VALUE) {
+    CloseHandle(file);
+    file = INVALID_HANDLE_VALUE;
+  }
+  if (path) {
+    OV_ARRAY_DESTROY(&path);
+  }
+  return result;
+}
+
+// Read the header of a cache file, returns false if the file is not a valid cache file
+static bool read_cache_file_header(wchar_t const *const path,
+                                   uint64_t const file_size,
+                                   struct cache_file_header *const header) {
+  HANDLE const file =
+      CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  DWORD bytes_read = 0;
+  bool const ok = ReadFile(file, header, sizeof(*header), &bytes_read, NULL) && bytes_read == sizeof(*header);
+  CloseHandle(file);
+  return ok && header->width > 0 && header->height > 0 && ptk_cache_codec_find(header->codec_id) &&
+         file_size == sizeof(*header) + (uint64_t)header->size;
+}
+
+// Register *.bin files that are not in the index and delete anything unusable
+static bool persist_adopt_files(struct ptk_cache *const c, struct ov_error *const err) {
+  wchar_t *pattern = NULL;
+  wchar_t *file_path = NULL;
+  WIN32_FIND_DATAW find_data = {0};
+  HANDLE find_handle = INVALID_HANDLE_VALUE;
+  bool result = false;
+
+  if (!build_persist_path(c->persist_dir, L"*.bin", &pattern, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
+
+  find_handle = FindFirstFileW(pattern, &find_data);
+  if (find_handle == INVALID_HANDLE_VALUE) {
+    result = true;
+    goto cleanup;
+  }
+
+  do {
+    if (find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+      continue;
+    }
+    if (!build_persist_path(c->persist_dir, find_data.cFileName, &file_path, err)) {
+      OV_ERROR_ADD_TRACE(err);
+      goto cleanup;
+    }
+
+    // Expect {cachekey_hex}.bin
+    char cachekey_hex[CACHEKEY_HEX_LEN + 1] = {0};
+    bool valid_name = wcslen(find_data.cFileName) == CACHEKEY_HEX_LEN + 4 &&
+                      wcscmp(find_data.cFileName + CACHEKEY_HEX_LEN, L".bin") == 0;
+    for (size_t i = 0; valid_name && i < CACHEKEY_HEX_LEN; ++i) {
+      valid_name = find_data.cFileName[i] < 0x80;
+      cachekey_hex[i] = (char)find_data.cFileName[i];
+    }
+    if (valid_name && !is_cachekey_hex(cachekey_hex)) {
+      valid_name = false;
+    }
+    if (valid_name && find_entry(c->persist_entries, cachekey_hex)) {
+      continue;
+    }
+
+    uint64_t const file_size = ((uint64_t)find_data.nFileSizeHigh << 32) | find_data.nFileSizeLow;
+    struct cache_file_header header = {0};
+    if (!valid_name || !read_cache_file_header(file_path, file_size, &header)) {
+      DeleteFileW(file_path);
+      continue;
+    }
+    if (!persist_add(c, cachekey_hex, header.width, header.height, (size_t)file_size, err)) {
+      OV_ERROR_ADD_TRACE(err);
+      goto cleanup;
+    }
+  } while (FindNextFileW(find_handle, &find_data));
+
+  result = true;
+
+cleanup:
+  if (find_handle != INVALID_HANDLE_VALUE) {
+    FindClose(find_handle);
+    find_handle = INVALID_HANDLE_VALUE;
+  }
+  if (file_path) {
+    OV_ARRAY_DESTROY(&file_path);
+  }
+  if (pattern) {
+    OV_ARRAY_DESTROY(&pattern);
+  }
+  return result;
+}
+
+// Write index.bin through a temporary file so a crash never leaves a torn index
+static bool persist_save_index(struct ptk_cache *const c, struct ov_error *const err) {
+  wchar_t *path = NULL;
+  wchar_t *tmp_path = NULL;
+  uint8_t *buf = NULL;
+  HANDLE file = INVALID_HANDLE_VALUE;
+  DWORD written = 0;
+  bool result = false;
+
+  size_t count = 0;
+  for (struct cache_entry const *e = c->persist_lru.head; e; e = e->lru_next) {
+    ++count;
+  }
+  size_t const buf_size = sizeof(struct persist_index_header) + count * sizeof(struct persist_index_record);
+
+  if (!build_persist_path(c->persist_dir, g_persist_index_name, &path, err) ||
+      !build_persist_path(c->persist_dir, g_persist_index_tmp_name, &tmp_path, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
+  if (!OV_REALLOC(&buf, buf_size, 1)) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
+    goto cleanup;
+  }
+
+  {
+    struct persist_index_header const header = {
+        .magic = PERSIST_INDEX_MAGIC,
+        .version = PERSIST_INDEX_VERSION,
+        .count = (uint32_t)count,
+    };
+    memcpy(buf, &header, sizeof(header));
+    uint8_t *p = buf + sizeof(header);
+    for (struct cache_entry const *e = c->persist_lru.head; e; e = e->lru_next) {
+      struct persist_index_record r = {
+          .width = e->width,
+          .height = e->height,
+          .file_size = (uint32_t)e->file_size,
+      };
+      memcpy(r.cachekey_hex, e->cachekey_hex, CACHEKEY_HEX_LEN);
+      memcpy(p, &r, sizeof(r));
+      p += sizeof(r);
+    }
+  }
+
+  file = CreateFileW(tmp_path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
+    goto cleanup;
+  }
+  if (!WriteFile(file, buf, (DWORD)buf_size, &written, NULL) || written != buf_size) {
+    OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
+    goto cleanup;
+  }
+  CloseHandle(file);
+  file = INVALID_HANDLE_VALUE;
+
+  if (!MoveFileExW(tmp_path, path, MOVEFILE_REPLACE_EXISTING)) {
+    OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
+    goto cleanup;
+  }
+
+  result = true;
+
+cleanup:
+  if (file != INVALID_HANDLE_VALUE) {
+    CloseHandle(file);
+    file = INVALID_HANDLE_VALUE;
+  }
+  if (buf) {
+    OV_FREE(&buf);
+  }
+  if (tmp_path) {
+    OV_ARRAY_DESTROY(&tmp_path);
+  }
+  if (path) {
+    OV_ARRAY_DESTROY(&path);
+  }
+  return result;
+}
+
+// Writer thread
+
+static int writer_thread(void *userdata) {
+  struct ptk_cache *const c = (struct ptk_cache *)userdata;
+  mtx_lock(&c->write_mtx);
+  for (;;) {
+    while (c->write_pos == c->write_tail && !c->write_exit) {
+      cnd_wait(&c->write_cnd, &c->write_mtx);
+    }
+    if (c->write_pos == c->write_tail) {
+      break; // exit requested and nothing left to write
+    }
+    struct write_job *const job = &c->write_jobs[c->write_pos % WRITE_QUEUE_CAPACITY];
+    mtx_unlock(&c->write_mtx);
+
+    job->ok = write_entry_to_file(&c->write_buf, job->dir, job->codec, job->entry, &job->file_size, &job->err);
+    if (!job->ok) {
+      OV_ERROR_ADD_TRACE(&job->err);
+    }
+
+    mtx_lock(&c->write_mtx);
+    ++c->write_pos;
+    cnd_broadcast(&c->write_cnd);
+  }
+  mtx_unlock(&c->write_mtx);
+  return 0;
+}
+
+// Apply the result of a written job
+static void finish_write(struct ptk_cache *const c, struct write_job *const job) {
+  struct cache_entry *const entry = job->entry;
+  entry->writing = false;
+  if (!job->persistent) {
+    c->memory_pending -= entry->data_size;
+  }
+
+  if (!job->ok) {
+    // Non-fatal, the entry stays in the memory tier
+    ptk_logf_warn(&job->err,
+                  "%1$hs",
+                  "%1$hs",
+                  job->persistent ? "failed to write cache entry to persistent directory"
+                                  : "failed to evict cache to file tier");
+    OV_ERROR_REPORT(&job->err, NULL);
+    return;
+  }
+
+  if (job->persistent) {
+    struct ov_error err = {0};
+    if (!persist_add(c, entry->cachekey_hex, entry->width, entry->height, job->file_size, &err)) {
+      delete_entry_file(c->persist_dir, entry);
+      ptk_logf_warn(&err, "%1$hs", "%1$hs", "failed to write cache entry to persistent directory");
+      OV_ERROR_REPORT(&err, NULL);
+      return;
+    }
+    persist_evict(c);
+    return;
+  }
+
+  if (entry->refcount > 0) {
+    // Borrowed while being written, keep it in memory
+    delete_entry_file(c->temp_dir, entry);
+    return;
+  }
+
+  // Free memory, mark as file-based
+  c->memory_used -= entry->data_size;
+  c->file_used += job->file_size;
+  entry->file_size = job->file_size;
+  free_entry_data(entry);
+  entry->in_file = true;
+  ++c->stats.memory_evictions;
+  if (c->file_used > c->file_limit) {
+    evict_file_tier(c);
+  }
+}
+
+// Apply all jobs the writer thread has finished
+static void collect_writes(struct ptk_cache *const c) {
+  if (c->write_collect == c->write_tail) {
+    return;
+  }
+  mtx_lock(&c->write_mtx);
+  size_t const done = c->write_pos;
+  mtx_unlock(&c->write_mtx);
+  while (c->write_collect != done) {
+    finish_write(c, &c->write_jobs[c->write_collect % WRITE_QUEUE_CAPACITY]);
+    ++c->write_collect;
+  }
+}
+
+// Wait until the writer thread is idle and apply its results
+static void drain_writes(struct ptk_cache *const c) {
+  if (!c->writer_created) {
+    return;
+  }
+  mtx_lock(&c->write_mtx);
+  while (c->write_pos != c->write_tail) {
+    cnd_wait(&c->write_cnd, &c->write_mtx);
+  }
+  mtx_unlock(&c->write_mtx);
+  collect_writes(c);
+}
+
+// Queue an entry for the writer thread. Only waits when the queue is full.
+static void enqueue_write(struct ptk_cache *const c,
+                          struct cache_entry *const entry,
+                          wchar_t const *const dir,
+                          bool const persistent) {
+  while (c->write_tail - c->write_collect == WRITE_QUEUE_CAPACITY) {
+    mtx_lock(&c->write_mtx);
+    while (c->write_pos == c->write_collect) {
+      cnd_wait(&c->write_cnd, &c->write_mtx);
+    }
+    mtx_unlock(&c->write_mtx);
+    collect_writes(c);
+  }
+
+  entry->writing = true;
+  if (!persistent) {
+    c->memory_pending += entry->data_size;
+  }
+  c->write_jobs[c->write_tail % WRITE_QUEUE_CAPACITY] = (struct write_job){
+      .entry = entry,
+      .dir = dir,
+      .codec = c->codec,
+      .persistent = persistent,
+  };
+
+  mtx_lock(&c->write_mtx);
+  ++c->write_tail;
+  cnd_broadcast(&c->write_cnd);
+  mtx_unlock(&c->write_mtx);
+}
+
+// Start moving memory tier entries to the file tier in eviction order until the memory limit is met.
+// Entries stay readable from memory until their file is written.
+static void evict_memory_to_file(struct ptk_cache *const c) {
+  collect_writes(c);
+  while (c->memory_used - c->memory_pending > c->memory_limit) {
+    // Find the first entry in memory that is neither borrowed nor already being written
+    struct cache_entry *entry = c->policy->next(c, NULL);
+    while (entry && (entry->in_file || entry->refcount > 0 || entry->writing)) {
+      entry = c->policy->next(c, entry);
+    }
+    if (!entry) {
+      break; // No more evictable memory entries
+    }
+
+    if (find_entry(c->persist_entries, entry->cachekey_hex)) {
+      // Already stored in the persistent tier, reload from there on demand
+      c->memory_used -= entry->data_size;
+      remove_entry(c, entry);
+      ++c->stats.memory_evictions;
+      continue;
+    }
+
+    enqueue_write(c, entry, c->temp_dir, false);
+  }
+}
+
+// Copy a new memory tier entry to the persistent tier in the background
+static void persist_store(struct ptk_cache *const c, struct cache_entry *const entry) {
+  if (!c->persist_dir || persist_touch(c, entry->cachekey_hex)) {
+    return;
+  }
+  enqueue_write(c, entry, c->persist_dir, true);
+}
+
+// Close the persistent tier, keeping its files on disk
+static void persist_close(struct ptk_cache *const c, bool const save_index) {
+  // Pending jobs refer to persist_dir
+  drain_writes(c);
+  if (c->persist_entries) {
+    if (save_index) {
+      struct ov_error err = {0};
+      if (!persist_save_index(c, &err)) {
+        ptk_logf_warn(&err, "%1$hs", "%1$hs", "failed to save persistent cache index");
+        OV_ERROR_REPORT(&err, NULL);
+      }
+    }
+    size_t iter = 0;
+    struct cache_entry **entry_ptr = NULL;
+    while (OV_HASHMAP_ITER(c->persist_entries, &iter, &entry_ptr)) {
+      struct cache_entry *entry = *entry_ptr;
+      OV_FREE(&entry);
+    }
+    OV_HASHMAP_DESTROY(&c->persist_entries);
+  }
+  c->persist_lru = (struct cache_lru){0};
+  c->persist_used = 0;
+  c->persist_limit = 0;
+  if (c->persist_lock != INVALID_HANDLE_VALUE) {
+    CloseHandle(c->persist_lock);
+    c->persist_lock = INVALID_HANDLE_VALUE;
+  }
+  if (c->persist_dir) {
+    OV_ARRAY_DESTROY(&c->persist_dir);
+  }
+}
+
+struct ptk_cache *ptk_cache_create(struct ov_error *const err) {
+  struct ptk_cache *cache = NULL;
+
+  // Cleanup orphaned directories first
+  cleanup_orphaned_directories();
+
+  // Allocate cache structure
+  if (!OV_REALLOC(&cache, 1, sizeof(struct ptk_cache))) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
+    goto cleanup;
+  }
+  *cache = (struct ptk_cache){
+      .dir_lock = INVALID_HANDLE_VALUE,
+      .policy = &g_lru_policy,
+      .memory_limit = DEFAULT_MEMORY_CACHE_LIMIT,
+      .file_limit = DEFAULT_FILE_CACHE_LIMIT,
+      .codec = &ptk_cache_codec_zero_rle,
+      .persist_lock = INVALID_HANDLE_VALUE,
+  };
+  mtx_init(&cache->write_mtx, mtx_plain);
+  cnd_init(&cache->write_cnd);
+
+  // Get temp path
+  {
+    DWORD const temp_len = GetTempPathW(0, NULL);
+    if (temp_len == 0) {
+      OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
+      goto cleanup;
+    }
+
+    wchar_t *temp_path = NULL;
+    if (!OV_ARRAY_GROW(&temp_path, temp_len)) {
+      OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
+      goto cleanup;
+    }
+    GetTempPathW(temp_len, temp_path);
+    size_t const actual_temp_len = wcslen(temp_path);
+    OV_ARRAY_SET_LENGTH(temp_path, actual_temp_len);
+
+    // Build directory name: ptk_{pid}_{instance}/
+    DWORD const pid = GetCurrentProcessId();
+    LONG const instance_id = InterlockedIncrement(&g_instance_counter);
+    wchar_t suffix_str[32] = {0};
+    int const suffix_len = ov_snprintf_wchar(
+        suffix_str, sizeof(suffix_str) / sizeof(suffix_str[0]), NULL, L"%1$lu_%2$ld", pid, instance_id);
+    if (suffix_len < 0) {
+      OV_ARRAY_DESTROY(&temp_path);
+      OV_ERROR_SET_GENERIC(err, ov_error_generic_fail);
+      goto cleanup;
+    }
+
+    // temp_path + "ptk_" + suffix + "\"
+    size_t const dir_len = actual_temp_len + 4 + (size_t)suffix_len + 1;
+    if (!OV_ARRAY_GROW(&cache->temp_dir, dir_len + 1)) {
+      OV_ARRAY_DESTROY(&temp_path);
+      OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
+      goto cleanup;
+    }
+    memcpy(cache->temp_dir, temp_path, actual_temp_len * sizeof(wchar_t));
+    cache->temp_dir[actual_temp_len + 0] = L'p';
+    cache->temp_dir[actual_temp_len + 1] = L't';
+    cache->temp_dir[actual_temp_len + 2] = L'k';
+    cache->temp_dir[actual_temp_len + 3] = L'_';
+    memcpy(cache->temp_dir + actual_temp_len + 4, suffix_str, (size_t)suffix_len * sizeof(wchar_t));
+    cache->temp_dir[actual_temp_len + 4 + (size_t)suffix_len] = L'\\';
+    cache->temp_dir[actual_temp_len + 4 + (size_t)suffix_len + 1] = L'\0';
+    OV_ARRAY_SET_LENGTH(cache->temp_dir, dir_len);
+
+    OV_ARRAY_DESTROY(&temp_path);
+  }
+
+  // Create directory
+  if (!CreateDirectoryW(cache->temp_dir, NULL)) {
+    DWORD const e = GetLastError();
+    if (e != ERROR_ALREADY_EXISTS) {
+      OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(e));
+      goto cleanup;
+    }
+  }
+
+  // Lock directory
+  cache->dir_lock = CreateFileW(cache->temp_dir,
+                                GENERIC_READ,
+                                0, // no sharing
+                                NULL,
+                                OPEN_EXISTING,
+                                FILE_FLAG_BACKUP_SEMANTICS,
+                                NULL);
+  if (cache->dir_lock == INVALID_HANDLE_VALUE) {
+    OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
+    goto cleanup;
+  }
+
+  // Create hashmap (stores cache_entry* pointers, not cache_entry directly)
+  cache->entries = OV_HASHMAP_CREATE_DYNAMIC(sizeof(struct cache_entry *), 64, get_entry_key);
+  if (!cache->entries) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
+    goto cleanup;
+  }
+
+  if (thrd_create(&cache->writer, writer_thread, cache) != thrd_success) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_fail);
+    goto cleanup;
+  }
+  cache->writer_created = true;
+
+  return cache;
+
+cleanup:
+  ptk_cache_destroy(&cache);
+  return NULL;
+}
+
+void ptk_cache_destroy(struct ptk_cache **const c) {
+  if (!c || !*c) {
+    return;
+  }
+
+  struct ptk_cache *cache = *c;
+
+  ptk_cache_clear(cache);
+  persist_close(cache, true);
+  if (cache->writer_created) {
+    mtx_lock(&cache->write_mtx);
+    cache->write_exit = true;
+    cnd_broadcast(&cache->write_cnd);
+    mtx_unlock(&cache->write_mtx);
+    thrd_join(cache->writer, NULL);
+    cache->writer_created = false;
+  }
+  if (cache->entries) {
+    OV_HASHMAP_DESTROY(&cache->entries);
+  }
+  if (cache->dir_lock != INVALID_HANDLE_VALUE) {
+    CloseHandle(cache->dir_lock);
+    cache->dir_lock = INVALID_HANDLE_VALUE;
+  }
+  if (cache->temp_dir) {
+    // Delete the directory (should be empty now)
+    RemoveDirectoryW(cache->temp_dir);
+    OV_ARRAY_DESTROY(&cache->temp_dir);
+  }
+  if (cache->read_buf.ptr) {
+    OV_FREE(&cache->read_buf.ptr);
+  }
+  if (cache->write_buf.ptr) {
+    OV_FREE(&cache->write_buf.ptr);
+  }
+  mtx_destroy(&cache->write_mtx);
+  cnd_destroy(&cache->write_cnd);
+  OV_FREE(c);
+}
+
+void ptk_cache_set_codec(struct ptk_cache *const c, struct ptk_cache_codec const *const codec) {
+  if (!c) {
+    return;
+  }
+  c->codec = codec ? codec : &ptk_cache_codec_raw;
+}
+
+void ptk_cache_set_limits(struct ptk_cache *const c, size_t const memory_limit, size_t const file_limit) {
+  if (!c) {
+    return;
+  }
+  c->memory_limit = memory_limit;
+  c->file_limit = file_limit;
+  if (c->policy == &g_2q_policy) {
+    twoq_demote_overflow(c);
+  }
+  evict_memory_to_file(c);
+  evict_file_tier(c);
+}
+
+void ptk_cache_set_policy(struct ptk_cache *const c, enum ptk_cache_policy const policy) {
+  if (!c) {
+    return;
+  }
+  struct cache_policy const *const p = policy == ptk_cache_policy_2q ? &g_2q_policy : &g_lru_policy;
+  if (c->policy == p) {
+    return;
+  }
+  // Both policies keep c->lru, so fold the protected entries back in as the most recently used
+  while (c->protected_lru.head) {
+    struct cache_entry *const entry = c->protected_lru.head;
+    lru_remove(&c->protected_lru, entry);
+    entry->protected_ = false;
+    lru_add(&c->lru, entry);
+  }
+  for (struct cache_entry *entry = c->lru.head; entry; entry = entry->lru_next) {
+    entry->references = 0;
+  }
+  c->protected_size = 0;
+  c->policy = p;
+}
+
+void ptk_cache_flush(struct ptk_cache *const c) {
+  if (!c) {
+    return;
+  }
+  drain_writes(c);
+}
+
+void ptk_cache_get_stats(struct ptk_cache const *const c, struct ptk_cache_stats *const stats) {
+  if (!c || !stats) {
+    return;
+  }
+  *stats = c->stats;
+  stats->memory_used = c->memory_used;
+  stats->memory_limit = c->memory_limit;
+  stats->file_used = c->file_used;
+  stats->file_limit = c->file_limit;
+  stats->persistent_used = c->persist_used;
+  stats->persistent_limit = c->persist_dir ? c->persist_limit : 0;
+}
+
+bool ptk_cache_enable_persistent(struct ptk_cache *const c,
+                                 wchar_t const *const dir,
+                                 uint64_t const size_limit,
+                                 struct ov_error *const err) {
+  if (!c || size_limit == 0) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_invalid_argument);
+    return false;
+  }
+
+  wchar_t *new_dir = NULL;
+  wchar_t *lock_path = NULL;
+  bool result = false;
+
+  if (!build_persist_dir(dir, &new_dir, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
+  if (c->persist_dir && wcscmp(c->persist_dir, new_dir) == 0) {
+    c->persist_limit = size_limit;
+    persist_evict(c);
+    result = true;
+    goto cleanup;
+  }
+  persist_close(c, true);
+
+  if (!CreateDirectoryW(new_dir, NULL)) {
+    DWORD const e = GetLastError();
+    if (e != ERROR_ALREADY_EXISTS) {
+      OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(e));
+      goto cleanup;
+    }
+  }
+
+  // Only one process may use the directory at a time
+  if (!build_persist_path(new_dir, g_persist_lock_name, &lock_path, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
+  c->persist_lock = CreateFileW(
+      lock_path, GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+  if (c->persist_lock == INVALID_HANDLE_VALUE) {
+    OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
+    goto cleanup;
+  }
+
+  c->persist_entries = OV_HASHMAP_CREATE_DYNAMIC(sizeof(struct cache_entry *), 64, get_entry_key);
+  if (!c->persist_entries) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
+    goto cleanup;
+  }
+  c->persist_dir = new_dir;
+  new_dir = NULL;
+  c->persist_limit = size_limit;
+
+  if (!persist_load_index(c, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
+  if (!persist_adopt_files(c, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
+  persist_evict(c);
+
+  result = true;
+
+cleanup:
+  if (!result) {
+    persist_close(c, false);
+  }
+  if (lock_path) {
+    OV_ARRAY_DESTROY(&lock_path);
+  }
+  if (new_dir) {
+    OV_ARRAY_DESTROY(&new_dir);
+  }
+  return result;
+}
+
+void ptk_cache_disable_persistent(struct ptk_cache *const c) {
+  if (!c) {
+    return;
+  }
+  persist_close(c, true);
+}
+
+// Add an entry to the memory tier without evicting anything.
+// On success, ownership of entry is transferred to the cache.
+static bool register_entry(struct ptk_cache *const c, struct cache_entry *const entry, struct ov_error *const err) {
+  struct cache_entry *entry_ptr = entry;
+  if (!OV_HASHMAP_SET(c->entries, &entry_ptr)) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
+    return false;
+  }
+
+  // Add to eviction order (entry is heap-allocated, address is stable)
+  c->policy->add(c, entry);
+  c->memory_used += entry->data_size;
+  return true;
+}
+
+// Register a newly created entry and evict older entries if limits are exceeded.
+// On success, ownership of entry is transferred to the cache.
+static bool insert_entry(struct ptk_cache *const c, struct cache_entry *const entry, struct ov_error *const err) {
+  if (!register_entry(c, entry, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    return false;
+  }
+  c->stats.bytes_in += entry->data_size;
+  persist_store(c, entry);
+
+  // Evict if needed
+  evict_memory_to_file(c);
+  if (c->file_used > c->file_limit) {
+    evict_file_tier(c);
+  }
+  return true;
 }
 
 bool ptk_cache_put(struct ptk_cache *const c,
@@ -626,19 +1725,12 @@ bool ptk_cache_put(struct ptk_cache *const c,
   size_t const data_size = (size_t)width * (size_t)height * 4;
   struct cache_entry *new_entry = NULL;
 
-  // Check if already exists - need a temporary entry for key lookup
-  struct cache_entry key_entry = {0};
-  memcpy(key_entry.cachekey_hex, cachekey_hex, CACHEKEY_HEX_LEN);
-  struct cache_entry *key_ptr = &key_entry;
-
   // Look up existing entry
   {
-    void const *const_ptr = OV_HASHMAP_GET(c->entries, &key_ptr);
-    if (const_ptr) {
-      // Entry exists - get pointer from hashmap
-      struct cache_entry *existing = *(struct cache_entry *const *)const_ptr;
-      // Already cached, just touch LRU
-      lru_touch(c, existing);
+    struct cache_entry *existing = find_entry(c->entries, cachekey_hex);
+    if (existing) {
+      // Already cached, just mark as used
+      c->policy->touch(c, existing, false);
       result = true;
       goto cleanup;
     }
@@ -663,49 +1755,237 @@ bool ptk_cache_put(struct ptk_cache *const c,
   }
   memcpy(new_entry->data, data, data_size);
 
-  // Add pointer to hashmap
-  if (!OV_HASHMAP_SET(c->entries, &new_entry)) {
+  if (!insert_entry(c, new_entry, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
+
+  new_entry = NULL; // ownership transferred to hashmap
+  result = true;
+
+cleanup:
+  if (new_entry) {
+    free_entry_data(new_entry);
+    OV_FREE(&new_entry);
+  }
+  return result;
+}
+
+struct ptk_cache_slot *
+ptk_cache_slot_create(struct ptk_cache *const c, int32_t const width, int32_t const height, struct ov_error *const err) {
+  if (!c || width <= 0 || height <= 0) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_invalid_argument);
+    return NULL;
+  }
+
+  struct ptk_cache_slot *slot = NULL;
+  uint64_t const data_size = (uint64_t)width * (uint64_t)height * 4;
+  wchar_t name[64];
+  bool result = false;
+
+  if (!OV_REALLOC(&slot, 1, sizeof(struct ptk_cache_slot))) {
     OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
     goto cleanup;
   }
+  *slot = (struct ptk_cache_slot){
+      .width = width,
+      .height = height,
+  };
 
-  // Add to LRU (new_entry is heap-allocated, address is stable)
-  lru_add(c, new_entry);
-  c->memory_used += data_size;
+  // Build mapping name: Local\PSDTKit_Slot_{pid}_{counter}
+  wsprintfW(name,
+            L"Local\\PSDTKit_Slot_%lu_%ld",
+            GetCurrentProcessId(),
+            InterlockedIncrement(&g_slot_counter));
+  for (size_t i = 0;; ++i) {
+    slot->name[i] = (char)name[i];
+    if (name[i] == L'\0') {
+      break;
+    }
+  }
 
-  // Evict if needed
-  if (c->memory_used > MEMORY_CACHE_LIMIT) {
-    struct ov_error evict_err = {0};
-    if (!evict_memory_to_file(c, &evict_err)) {
-      // Non-fatal, just log
-      ptk_logf_warn(&evict_err, "%1$hs", "%1$hs", "failed to evict cache to file tier");
-      OV_ERROR_REPORT(&evict_err, NULL);
+  slot->mapping = CreateFileMappingW(
+      INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(data_size >> 32), (DWORD)(data_size & 0xffffffff), name);
+  if (!slot->mapping) {
+    OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
+    goto cleanup;
+  }
+  slot->data = (uint8_t *)MapViewOfFile(slot->mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)data_size);
+  if (!slot->data) {
+    OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
+    goto cleanup;
+  }
+
+  result = true;
+
+cleanup:
+  if (!result) {
+    ptk_cache_slot_destroy(&slot);
+  }
+  return slot;
+}
+
+void ptk_cache_slot_destroy(struct ptk_cache_slot **const slot) {
+  if (!slot || !*slot) {
+    return;
+  }
+  struct ptk_cache_slot *s = *slot;
+  if (s->data) {
+    UnmapViewOfFile(s->data);
+    s->data = NULL;
+  }
+  if (s->mapping) {
+    CloseHandle(s->mapping);
+    s->mapping = NULL;
+  }
+  OV_FREE(slot);
+}
+
+char const *ptk_cache_slot_get_name(struct ptk_cache_slot const *const slot) { return slot ? slot->name : NULL; }
+
+void *ptk_cache_slot_get_data(struct ptk_cache_slot *const slot) { return slot ? slot->data : NULL; }
+
+bool ptk_cache_put_slot(struct ptk_cache *const c,
+                        uint64_t ckey,
+                        struct ptk_cache_slot **const slot,
+                        struct ov_error *const err) {
+  if (!c || !slot || !*slot) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_invalid_argument);
+    return false;
+  }
+
+  char cachekey_hex[CACHEKEY_HEX_LEN + 1];
+  ckey_to_hex(ckey, cachekey_hex);
+
+  bool result = false;
+  struct cache_entry *new_entry = NULL;
+
+  {
+    struct cache_entry *existing = find_entry(c->entries, cachekey_hex);
+    if (existing) {
+      // Already cached, keep the existing data and discard the slot
+      c->policy->touch(c, existing, false);
+      ptk_cache_slot_destroy(slot);
+      result = true;
+      goto cleanup;
     }
   }
-  if (c->file_used > FILE_CACHE_LIMIT) {
-    evict_file_tier(c);
+
+  if (!OV_REALLOC(&new_entry, 1, sizeof(struct cache_entry))) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
+    goto cleanup;
+  }
+  *new_entry = (struct cache_entry){0};
+  memcpy(new_entry->cachekey_hex, cachekey_hex, CACHEKEY_HEX_LEN);
+  new_entry->width = (*slot)->width;
+  new_entry->height = (*slot)->height;
+  new_entry->data_size = (size_t)(*slot)->width * (size_t)(*slot)->height * 4;
+  new_entry->data = (*slot)->data;
+  new_entry->mapping = (*slot)->mapping;
+  new_entry->in_file = false;
+
+  if (!insert_entry(c, new_entry, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
   }
 
-  new_entry = NULL; // ownership transferred to hashmap
+  // The mapping now belongs to the entry
+  (*slot)->data = NULL;
+  (*slot)->mapping = NULL;
+  ptk_cache_slot_destroy(slot);
+  new_entry = NULL;
   result = true;
 
 cleanup:
   if (new_entry) {
-    if (new_entry->data) {
-      OV_FREE(&new_entry->data);
-    }
     OV_FREE(&new_entry);
   }
   return result;
 }
 
-bool ptk_cache_get(struct ptk_cache *const c,
-                   uint64_t ckey,
-                   void **data,
-                   int32_t *width,
-                   int32_t *height,
-                   struct ov_error *const err) {
-  if (!c || !data || !width || !height) {
+bool ptk_cache_contains(struct ptk_cache *const c, uint64_t ckey) {
+  if (!c) {
+    return false;
+  }
+  char cachekey_hex[CACHEKEY_HEX_LEN + 1];
+  ckey_to_hex(ckey, cachekey_hex);
+  struct cache_entry *const entry = find_entry(c->entries, cachekey_hex);
+  if (!entry) {
+    bool const found = persist_touch(c, cachekey_hex);
+    if (found) {
+      ++c->stats.contains_hits;
+    } else {
+      ++c->stats.contains_misses;
+    }
+    return found;
+  }
+  c->policy->touch(c, entry, false);
+  persist_touch(c, cachekey_hex);
+  ++c->stats.contains_hits;
+  return true;
+}
+
+// Load a persisted entry into the memory tier.
+// Sets *loaded to NULL if the key is not persisted or its file is unusable.
+static bool persist_load(struct ptk_cache *const c,
+                         char const cachekey_hex[CACHEKEY_HEX_LEN + 1],
+                         struct cache_entry **const loaded,
+                         struct ov_error *const err) {
+  *loaded = NULL;
+  struct cache_entry *const persisted = find_entry(c->persist_entries, cachekey_hex);
+  if (!persisted) {
+    return true;
+  }
+
+  struct cache_entry *entry = NULL;
+  bool result = false;
+
+  if (!OV_REALLOC(&entry, 1, sizeof(struct cache_entry))) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
+    goto cleanup;
+  }
+  *entry = (struct cache_entry){
+      .width = persisted->width,
+      .height = persisted->height,
+  };
+  memcpy(entry->cachekey_hex, cachekey_hex, CACHEKEY_HEX_LEN);
+
+  {
+    struct ov_error read_err = {0};
+    if (!read_entry_from_file(c, c->persist_dir, entry, &read_err)) {
+      // Deleted or damaged file, forget it and report a miss
+      ptk_logf_warn(&read_err, "%1$hs", "%1$hs", "failed to read cache entry from persistent directory");
+      OV_ERROR_REPORT(&read_err, NULL);
+      persist_drop(c, persisted);
+      result = true;
+      goto cleanup;
+    }
+  }
+  if (!register_entry(c, entry, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
+
+  *loaded = entry;
+  entry = NULL;
+  result = true;
+
+cleanup:
+  if (entry) {
+    free_entry_data(entry);
+    OV_FREE(&entry);
+  }
+  return result;
+}
+
+bool ptk_cache_borrow(struct ptk_cache *const c,
+                      uint64_t ckey,
+                      struct ptk_cache_ref **const ref,
+                      void const **const data,
+                      int32_t *const width,
+                      int32_t *const height,
+                      struct ov_error *const err) {
+  if (!c || !ref || !data || !width || !height) {
     OV_ERROR_SET_GENERIC(err, ov_error_generic_invalid_argument);
     return false;
   }
@@ -713,6 +1993,7 @@ bool ptk_cache_get(struct ptk_cache *const c,
   char cachekey_hex[CACHEKEY_HEX_LEN + 1];
   ckey_to_hex(ckey, cachekey_hex);
 
+  *ref = NULL;
   *data = NULL;
   *width = 0;
   *height = 0;
@@ -720,59 +2001,132 @@ bool ptk_cache_get(struct ptk_cache *const c,
   bool result = false;
   struct cache_entry *entry = NULL;
 
-  // Create temporary entry for key lookup
-  struct cache_entry key_entry = {0};
-  memcpy(key_entry.cachekey_hex, cachekey_hex, CACHEKEY_HEX_LEN);
-  struct cache_entry *key_ptr = &key_entry;
-
-  // Look up entry
-  {
-    void const *const_ptr = OV_HASHMAP_GET(c->entries, &key_ptr);
-    if (!const_ptr) {
+  // Look up entry, falling back to the persistent tier
+  entry = find_entry(c->entries, cachekey_hex);
+  if (!entry) {
+    if (!persist_load(c, cachekey_hex, &entry, err)) {
+      OV_ERROR_ADD_TRACE(err);
+      goto cleanup;
+    }
+    if (!entry) {
       // Cache miss - not an error
+      ++c->stats.misses;
       result = true;
       goto cleanup;
     }
-    entry = *(struct cache_entry *const *)const_ptr;
+    ++c->stats.persistent_hits;
+  } else if (entry->in_file) {
+    ++c->stats.file_hits;
+  } else {
+    ++c->stats.memory_hits;
   }
 
-  // Touch LRU
-  lru_touch(c, entry);
+  // Mark as used
+  c->policy->touch(c, entry, true);
+  persist_touch(c, cachekey_hex);
 
   // If in file tier, read back to memory
   if (entry->in_file) {
-    if (!read_entry_from_file(c, entry, err)) {
+    if (!read_entry_from_file(c, c->temp_dir, entry, err)) {
       OV_ERROR_ADD_TRACE(err);
       goto cleanup;
     }
     entry->in_file = false;
-    c->file_used -= entry->data_size;
+    c->file_used -= entry->file_size;
+    entry->file_size = 0;
     c->memory_used += entry->data_size;
     // Delete file
-    delete_entry_file(c, entry);
-
-    // Evict if needed
-    if (c->memory_used > MEMORY_CACHE_LIMIT) {
-      struct ov_error evict_err = {0};
-      if (!evict_memory_to_file(c, &evict_err)) {
-        ptk_logf_warn(&evict_err, "%1$hs", "%1$hs", "failed to evict cache to file tier");
-        OV_ERROR_REPORT(&evict_err, NULL);
-      }
-    }
+    delete_entry_file(c->temp_dir, entry);
   }
 
-  // Allocate and copy data for caller
-  if (!OV_REALLOC(data, entry->data_size, 1)) {
-    OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
-    goto cleanup;
-  }
-  memcpy(*data, entry->data, entry->data_size);
+  // Pin before evicting so the entry we are about to return stays in memory
+  ++entry->refcount;
+
+  // Evict if needed
+  evict_memory_to_file(c);
+
+  *ref = (struct ptk_cache_ref *)entry;
+  *data = entry->data;
   *width = entry->width;
   *height = entry->height;
+  c->stats.bytes_out += entry->data_size;
+
+  result = true;
+
+cleanup:
+  return result;
+}
+
+void ptk_cache_release(struct ptk_cache *const c, struct ptk_cache_ref **const ref) {
+  if (!ref || !*ref) {
+    return;
+  }
+
+  struct cache_entry *entry = (struct cache_entry *)*ref;
+  *ref = NULL;
+  if (entry->refcount > 0) {
+    --entry->refcount;
+  }
+  if (entry->refcount > 0) {
+    return;
+  }
+
+  if (entry->orphaned) {
+    // Removed from the cache while borrowed, the last borrower frees it
+    free_entry_data(entry);
+    OV_FREE(&entry);
+    return;
+  }
+
+  // Eviction may have been blocked by this borrow
+  if (c) {
+    evict_memory_to_file(c);
+  }
+}
+
+bool ptk_cache_get(struct ptk_cache *const c,
+                   uint64_t ckey,
+                   void **data,
+                   int32_t *width,
+                   int32_t *height,
+                   struct ov_error *const err) {
+  if (!c || !data || !width || !height) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_invalid_argument);
+    return false;
+  }
+
+  *data = NULL;
+
+  struct ptk_cache_ref *ref = NULL;
+  void const *borrowed = NULL;
+  bool result = false;
+
+  if (!ptk_cache_borrow(c, ckey, &ref, &borrowed, width, height, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
+  if (!ref) {
+    // Cache miss - not an error
+    result = true;
+    goto cleanup;
+  }
+
+  // Allocate and copy data for caller
+  {
+    size_t const data_size = (size_t)*width * (size_t)*height * 4;
+    if (!OV_REALLOC(data, data_size, 1)) {
+      OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
+      *width = 0;
+      *height = 0;
+      goto cleanup;
+    }
+    memcpy(*data, borrowed, data_size);
+  }
 
   result = true;
 
 cleanup:
+  ptk_cache_release(c, &ref);
   return result;
 }
 
@@ -781,25 +2135,35 @@ void ptk_cache_clear(struct ptk_cache *const c) {
     return;
   }
 
+  // Pending jobs read entry data
+  drain_writes(c);
+
   if (c->entries) {
     // Free all entry data and entries themselves
     size_t iter = 0;
     struct cache_entry **entry_ptr = NULL;
     while (OV_HASHMAP_ITER(c->entries, &iter, &entry_ptr)) {
       struct cache_entry *entry = *entry_ptr;
-      if (entry->data) {
-        OV_FREE(&entry->data);
+      if (entry->refcount > 0) {
+        // Still borrowed, the last ptk_cache_release frees it
+        entry->orphaned = true;
+        entry->lru_prev = NULL;
+        entry->lru_next = NULL;
+        continue;
       }
+      free_entry_data(entry);
       if (entry->in_file) {
-        delete_entry_file(c, entry);
+        delete_entry_file(c->temp_dir, entry);
       }
       OV_FREE(&entry);
     }
     OV_HASHMAP_CLEAR(c->entries);
   }
 
-  c->lru_head = NULL;
-  c->lru_tail = NULL;
+  c->lru = (struct cache_lru){0};
+  c->protected_lru = (struct cache_lru){0};
+  c->protected_size = 0;
   c->memory_used = 0;
+  c->memory_pending = 0;
   c->file_used = 0;
 }
@@ -5,12 +5,16 @@
 #include <stdint.h>
 
 struct ptk_cache;
+struct ptk_cache_slot;
+struct ptk_cache_ref;
+struct ptk_cache_codec;
 
 /**
  * Create a new cache instance.
  *
  * Creates a temporary directory under TEMP/ptk_{pid}_{instance}/ and acquires an exclusive lock.
  * Also cleans up orphaned cache directories from previous crashed processes.
+ * Starts the writer thread that writes cache files in the background.
  *
  * @param err Error details on failure
  * @return Pointer to created cache instance, or NULL on failure
@@ -20,18 +24,147 @@ NODISCARD struct ptk_cache *ptk_cache_create(struct ov_error *err);
 /**
  * Destroy a cache instance.
  *
- * Releases the directory lock and deletes all cached files.
+ * Waits for pending writes, releases the directory lock and deletes all
+ * cached files except those in the persistent tier.
  *
  * @param c Pointer to cache instance pointer (will be set to NULL)
  */
 void ptk_cache_destroy(struct ptk_cache **c);
 
+/**
+ * Select the codec used for files written to the file tier.
+ *
+ * Files already written keep their codec and stay readable.
+ * The default is ptk_cache_codec_zero_rle.
+ *
+ * @param c Cache instance
+ * @param codec Codec to use, NULL selects ptk_cache_codec_raw
+ */
+void ptk_cache_set_codec(struct ptk_cache *c, struct ptk_cache_codec const *codec);
+
+/**
+ * Eviction policy of the memory and file tiers.
+ */
+enum ptk_cache_policy {
+  /**
+   * Evict the least recently used entries first.
+   */
+  ptk_cache_policy_lru = 0,
+  /**
+   * Scan-resistant 2Q.
+   *
+   * Entries borrowed only once are evicted first in insertion order, so a
+   * single pass over many frames does not push out frames that are shown
+   * repeatedly.
+   */
+  ptk_cache_policy_2q = 1,
+};
+
+/**
+ * Set the size limits of the memory and file tiers.
+ *
+ * Entries over the new limits are evicted right away.
+ * The defaults are 256MB each.
+ *
+ * @param c Cache instance
+ * @param memory_limit Maximum total size of the pixel data held in memory in bytes
+ * @param file_limit Maximum total size of the files in the temporary directory in bytes
+ */
+void ptk_cache_set_limits(struct ptk_cache *c, size_t memory_limit, size_t file_limit);
+
+/**
+ * Select the eviction policy of the memory and file tiers.
+ *
+ * Existing entries are kept. The default is ptk_cache_policy_lru.
+ *
+ * @param c Cache instance
+ * @param policy Eviction policy
+ */
+void ptk_cache_set_policy(struct ptk_cache *c, enum ptk_cache_policy policy);
+
+/**
+ * Wait until the writer thread has written all queued cache files.
+ *
+ * Afterwards the memory tier is within its limit unless entries are borrowed.
+ *
+ * @param c Cache instance
+ */
+void ptk_cache_flush(struct ptk_cache *c);
+
+/**
+ * Cache counters.
+ *
+ * Counters accumulate from ptk_cache_create and are not reset by ptk_cache_clear.
+ * The used and limit fields are the current sizes in bytes.
+ */
+struct ptk_cache_stats {
+  uint64_t memory_hits;          // borrows served from memory
+  uint64_t file_hits;            // borrows read back from the file tier
+  uint64_t persistent_hits;      // borrows loaded from the persistent tier
+  uint64_t misses;               // borrows of missing keys
+  uint64_t contains_hits;        // ptk_cache_contains calls that found the key
+  uint64_t contains_misses;      // ptk_cache_contains calls that did not
+  uint64_t bytes_in;             // pixel bytes of new entries
+  uint64_t bytes_out;            // pixel bytes handed out by borrows
+  uint64_t memory_evictions;     // entries moved out of memory
+  uint64_t file_evictions;       // entries deleted from the file tier
+  uint64_t persistent_evictions; // entries deleted from the persistent tier
+  uint64_t file_reads;           // cache files read back from either tier
+  uint64_t file_read_usec;       // total time spent reading and decoding them
+  uint64_t file_read_max_usec;   // slowest read
+  uint64_t memory_used;
+  uint64_t memory_limit;
+  uint64_t file_used;
+  uint64_t file_limit;
+  uint64_t persistent_used;
+  uint64_t persistent_limit; // 0 when the persistent tier is disabled
+};
+
+/**
+ * Get a snapshot of the cache counters.
+ *
+ * @param c Cache instance
+ * @param stats Output: counters and current sizes
+ */
+void ptk_cache_get_stats(struct ptk_cache const *c, struct ptk_cache_stats *stats);
+
+/**
+ * Enable the persistent tier.
+ *
+ * Every new entry is also written to dir in the background, which outlives the cache instance.
+ * Later instances that enable the same directory find those entries again,
+ * so keys must only depend on the rendered content.
+ * An index of the entries is saved when the tier is disabled or the cache is destroyed.
+ * When the files in dir exceed size_limit, the least recently used ones are deleted.
+ * Only one process can use a directory at a time.
+ *
+ * Calling this again with the same directory only updates the size limit.
+ *
+ * @param c Cache instance
+ * @param dir Directory path, NULL selects TEMP/PSDToolKitCache/
+ * @param size_limit Maximum total size of the files in bytes
+ * @param err Error details on failure
+ * @return true on success, false on failure (the tier is left disabled)
+ */
+NODISCARD bool
+ptk_cache_enable_persistent(struct ptk_cache *c, wchar_t const *dir, uint64_t size_limit, struct ov_error *err);
+
+/**
+ * Disable the persistent tier.
+ *
+ * Saves the index and keeps the files for the next instance.
+ *
+ * @param c Cache instance
+ */
+void ptk_cache_disable_persistent(struct ptk_cache *c);
+
 /**
  * Store rendered image data in the cache.
  *
  * The data is first stored in memory. When memory usage exceeds the limit,
- * older entries are moved to file storage. When file storage also exceeds
- * its limit, the oldest entries are deleted.
+ * older entries are moved to file storage by a background writer thread and
+ * stay readable from memory until their file is written. When file storage
+ * also exceeds its limit, entries are deleted in the order of the eviction policy.
  *
  * @param c Cache instance
  * @param ckey 64-bit cache key
@@ -44,6 +177,61 @@ void ptk_cache_destroy(struct ptk_cache **c);
 NODISCARD bool ptk_cache_put(
     struct ptk_cache *c, uint64_t ckey, void const *data, int32_t width, int32_t height, struct ov_error *err);
 
+/**
+ * Create a writable slot for a rendered image.
+ *
+ * A slot is a named shared memory block of width * height * 4 bytes that another
+ * process can open by name and fill with the final bottom-up BGRA pixels.
+ * Committing the slot with ptk_cache_put_slot adopts the block as the entry data
+ * without copying.
+ *
+ * @param c Cache instance
+ * @param width Image width in pixels
+ * @param height Image height in pixels
+ * @param err Error details on failure
+ * @return Pointer to created slot, or NULL on failure
+ */
+NODISCARD struct ptk_cache_slot *
+ptk_cache_slot_create(struct ptk_cache *c, int32_t width, int32_t height, struct ov_error *err);
+
+/**
+ * Destroy a slot that has not been committed.
+ *
+ * @param slot Pointer to slot pointer (will be set to NULL)
+ */
+void ptk_cache_slot_destroy(struct ptk_cache_slot **slot);
+
+/**
+ * Get the shared memory name of a slot.
+ *
+ * @param slot Slot instance
+ * @return Null-terminated ASCII name usable with OpenFileMapping
+ */
+char const *ptk_cache_slot_get_name(struct ptk_cache_slot const *slot);
+
+/**
+ * Get the writable pixel buffer of a slot.
+ *
+ * @param slot Slot instance
+ * @return Pointer to width * height * 4 bytes of BGRA pixel data
+ */
+void *ptk_cache_slot_get_data(struct ptk_cache_slot *slot);
+
+/**
+ * Store a filled slot in the cache.
+ *
+ * The slot memory becomes the memory tier storage of the entry.
+ * If the key already exists, the existing data is kept and the slot is discarded.
+ * On success, *slot is set to NULL.
+ *
+ * @param c Cache instance
+ * @param ckey 64-bit cache key
+ * @param slot Pointer to slot pointer (ownership is taken on success)
+ * @param err Error details on failure
+ * @return true on success, false on failure
+ */
+NODISCARD bool ptk_cache_put_slot(struct ptk_cache *c, uint64_t ckey, struct ptk_cache_slot **slot, struct ov_error *err);
+
 /**
  * Retrieve cached image data.
  *
@@ -62,10 +250,56 @@ NODISCARD bool ptk_cache_put(
 NODISCARD bool
 ptk_cache_get(struct ptk_cache *c, uint64_t ckey, void **data, int32_t *width, int32_t *height, struct ov_error *err);
 
+/**
+ * Check whether an entry exists in any tier.
+ *
+ * Marks the entry as recently used so it is not the next eviction candidate.
+ * Does not read file or persistent tier entries back into memory.
+ *
+ * @param c Cache instance
+ * @param ckey 64-bit cache key
+ * @return true if the entry exists
+ */
+bool ptk_cache_contains(struct ptk_cache *c, uint64_t ckey);
+
+/**
+ * Borrow cached image data without copying.
+ *
+ * On cache hit, returns a pointer to the cached pixels and a reference that pins
+ * the entry in the memory tier until it is released. On cache miss, sets *ref and
+ * *data to NULL (not an error).
+ * Entries removed by ptk_cache_clear while borrowed stay valid until released.
+ *
+ * @param c Cache instance
+ * @param ckey 64-bit cache key
+ * @param ref Output: reference to pass to ptk_cache_release, or NULL on miss
+ * @param data Output: read-only BGRA pixel data, valid until the reference is released
+ * @param width Output: image width in pixels
+ * @param height Output: image height in pixels
+ * @param err Error details on failure
+ * @return true on success (including cache miss), false on error
+ */
+NODISCARD bool ptk_cache_borrow(struct ptk_cache *c,
+                                uint64_t ckey,
+                                struct ptk_cache_ref **ref,
+                                void const **data,
+                                int32_t *width,
+                                int32_t *height,
+                                struct ov_error *err);
+
+/**
+ * Release a reference obtained by ptk_cache_borrow.
+ *
+ * @param c Cache instance
+ * @param ref Pointer to reference pointer (will be set to NULL)
+ */
+void ptk_cache_release(struct ptk_cache *c, struct ptk_cache_ref **ref);
+
 /**
  * Clear all cached entries.
  *
  * Removes all entries from both memory and file tiers.
+ * The persistent tier is kept.
  * The cache instance remains valid for continued use.
  *
  * @param c Cache instance
@@ -0,0 +1,134 @@
+// Lossless codecs for the ptk_cache file tier
+#include "cache_codec.h"
+
+#include <string.h>
+
+#define FOURCC(c0, c1, c2, c3)                                                                                         \
+  ((uint32_t)(((uint32_t)(uint8_t)(c0)) | (((uint32_t)(uint8_t)(c1)) << 8) | (((uint32_t)(uint8_t)(c2)) << 16) |       \
+              (((uint32_t)(uint8_t)(c3)) << 24)))
+
+static size_t raw_bound(size_t const src_size) { return src_size; }
+
+static size_t raw_encode(uint8_t const *const src, size_t const src_size, uint8_t *const dst) {
+  memcpy(dst, src, src_size);
+  return src_size;
+}
+
+static bool raw_decode(uint8_t const *const src, size_t const src_size, uint8_t *const dst, size_t const dst_size) {
+  if (src_size != dst_size) {
+    return false;
+  }
+  memcpy(dst, src, src_size);
+  return true;
+}
+
+struct ptk_cache_codec const ptk_cache_codec_raw = {
+    .id = FOURCC('R', 'A', 'W', ' '),
+    .name = "raw",
+    .bound = raw_bound,
+    .encode = raw_encode,
+    .decode = raw_decode,
+};
+
+// Zero run-length format: a sequence of little-endian uint32 tokens.
+// If the top bit is set, the low 31 bits are a count of zero pixels.
+// Otherwise the token is a count of literal pixels that follow it.
+enum {
+  ZERO_RUN_FLAG = 0x80000000,
+  ZERO_RUN_MAX = 0x7fffffff,
+};
+
+static inline uint32_t load_u32(uint8_t const *const p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline void store_u32(uint8_t *const p, uint32_t const v) { memcpy(p, &v, sizeof(v)); }
+
+static size_t zero_rle_bound(size_t const src_size) {
+  // A literal followed by a single trailing zero pixel costs two tokens,
+  // every other token pays for itself.
+  return src_size + 16;
+}
+
+static size_t zero_rle_encode(uint8_t const *const src, size_t const src_size, uint8_t *const dst) {
+  size_t const n = src_size / 4;
+  size_t pos = 0;
+  size_t i = 0;
+  while (i < n) {
+    size_t z = i;
+    while (z < n && z - i < ZERO_RUN_MAX && load_u32(src + z * 4) == 0) {
+      ++z;
+    }
+    if (z - i >= 2 || (z > i && z == n)) {
+      store_u32(dst + pos, ZERO_RUN_FLAG | (uint32_t)(z - i));
+      pos += 4;
+      i = z;
+      continue;
+    }
+    // Literal until a run of at least two zero pixels starts
+    size_t j = i;
+    while (j < n && j - i < ZERO_RUN_MAX) {
+      if (load_u32(src + j * 4) == 0 && (j + 1 >= n || load_u32(src + (j + 1) * 4) == 0)) {
+        break;
+      }
+      ++j;
+    }
+    store_u32(dst + pos, (uint32_t)(j - i));
+    pos += 4;
+    memcpy(dst + pos, src + i * 4, (j - i) * 4);
+    pos += (j - i) * 4;
+    i = j;
+  }
+  return pos;
+}
+
+static bool
+zero_rle_decode(uint8_t const *const src, size_t const src_size, uint8_t *const dst, size_t const dst_size) {
+  size_t spos = 0;
+  size_t dpos = 0;
+  while (spos < src_size) {
+    if (src_size - spos < 4) {
+      return false;
+    }
+    uint32_t const token = load_u32(src + spos);
+    spos += 4;
+    size_t const len = (size_t)(token & ZERO_RUN_MAX) * 4;
+    if (len > dst_size - dpos) {
+      return false;
+    }
+    if (token & ZERO_RUN_FLAG) {
+      memset(dst + dpos, 0, len);
+    } else {
+      if (len > src_size - spos) {
+        return false;
+      }
+      memcpy(dst + dpos, src + spos, len);
+      spos += len;
+    }
+    dpos += len;
+  }
+  return dpos == dst_size;
+}
+
+struct ptk_cache_codec const ptk_cache_codec_zero_rle = {
+    .id = FOURCC('Z', 'R', 'L', 'E'),
+    .name = "zero-rle",
+    .bound = zero_rle_bound,
+    .encode = zero_rle_encode,
+    .decode = zero_rle_decode,
+};
+
+struct ptk_cache_codec const *ptk_cache_codec_find(uint32_t const id) {
+  static struct ptk_cache_codec const *const codecs[] = {
+      &ptk_cache_codec_raw,
+      &ptk_cache_codec_zero_rle,
+  };
+  for (size_t i = 0; i < sizeof(codecs) / sizeof(codecs[0]); ++i) {
+    if (codecs[i]->id == id) {
+      return codecs[i];
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <ovbase.h>
+
+#include <stdint.h>
+
+/**
+ * Lossless codec used by the file tier of ptk_cache.
+ *
+ * The codec id is stored in each cache file so files written with any
+ * registered codec can be read back regardless of the current setting.
+ */
+struct ptk_cache_codec {
+  uint32_t id;      // FOURCC stored in the file header
+  char const *name; // for logs and benchmarks
+
+  /**
+   * Maximum encoded size for src_size bytes of input.
+   */
+  size_t (*bound)(size_t src_size);
+
+  /**
+   * Encode BGRA pixel data.
+   *
+   * @param src Pixel data
+   * @param src_size Size of src in bytes, a multiple of 4
+   * @param dst Output buffer of at least bound(src_size) bytes
+   * @return Number of bytes written to dst
+   */
+  size_t (*encode)(uint8_t const *src, size_t src_size, uint8_t *dst);
+
+  /**
+   * Decode data written by encode.
+   *
+   * @param src Encoded data
+   * @param src_size Size of src in bytes
+   * @param dst Output buffer
+   * @param dst_size Exact decoded size expected
+   * @return true on success, false if the data is malformed
+   */
+  bool (*decode)(uint8_t const *src, size_t src_size, uint8_t *dst, size_t dst_size);
+};
+
+/**
+ * Stores pixels as-is.
+ */
+extern struct ptk_cache_codec const ptk_cache_codec_raw;
+
+/**
+ * Run-length encodes fully zero pixels and stores other pixels as-is.
+ *
+ * Rendered characters are mostly transparent and the renderer leaves
+ * transparent pixels as zero, so this removes most of the data at
+ * close to memcpy speed.
+ */
+extern struct ptk_cache_codec const ptk_cache_codec_zero_rle;
+
+/**
+ * Find a codec by its id.
+ *
+ * @param id Codec id read from a cache file
+ * @return Codec, or NULL if unknown
+ */
+struct ptk_cache_codec const *ptk_cache_codec_find(uint32_t id);
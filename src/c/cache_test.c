@@ -1,8 +1,14 @@
 #include "cache.h"
+#include "cache_codec.h"
 #include "logf.h"
 
 #include <ovtest.h>
 
+#ifndef WIN32_LEAN_AND_MEAN
+#  define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+
 #include <stdarg.h>
 #include <string.h>
 
@@ -494,6 +500,473 @@ static void test_cache_multiple_instances(void) {
   ptk_cache_destroy(&c2);
 }
 
+static void test_cache_put_slot(void) {
+  struct ov_error err = {0};
+  struct ptk_cache *c = NULL;
+  struct ptk_cache_slot *slot = NULL;
+  void *output_data = NULL;
+  int32_t width = 0;
+  int32_t height = 0;
+  uint8_t const input_data[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+
+  c = ptk_cache_create(&err);
+  if (!TEST_SUCCEEDED(c != NULL, &err)) {
+    return;
+  }
+
+  TEST_FAILED_WITH(ptk_cache_slot_create(c, 0, 2, &err) != NULL,
+                   &err,
+                   ov_error_type_generic,
+                   ov_error_generic_invalid_argument);
+  TEST_FAILED_WITH(ptk_cache_put_slot(c, 0x0123456789abcdefULL, &slot, &err),
+                   &err,
+                   ov_error_type_generic,
+                   ov_error_generic_invalid_argument);
+
+  slot = ptk_cache_slot_create(c, 2, 2, &err);
+  if (!TEST_SUCCEEDED(slot != NULL, &err)) {
+    goto cleanup;
+  }
+  TEST_CHECK(ptk_cache_slot_get_name(slot) != NULL);
+  memcpy(ptk_cache_slot_get_data(slot), input_data, sizeof(input_data));
+
+  TEST_CHECK(!ptk_cache_contains(c, 0x0123456789abcdefULL));
+  if (!TEST_SUCCEEDED(ptk_cache_put_slot(c, 0x0123456789abcdefULL, &slot, &err), &err)) {
+    goto cleanup;
+  }
+  TEST_CHECK(slot == NULL);
+  TEST_CHECK(ptk_cache_contains(c, 0x0123456789abcdefULL));
+
+  // A second slot for the same key is discarded and the first data is kept
+  slot = ptk_cache_slot_create(c, 2, 2, &err);
+  if (!TEST_SUCCEEDED(slot != NULL, &err)) {
+    goto cleanup;
+  }
+  if (!TEST_SUCCEEDED(ptk_cache_put_slot(c, 0x0123456789abcdefULL, &slot, &err), &err)) {
+    goto cleanup;
+  }
+  TEST_CHECK(slot == NULL);
+
+  if (!TEST_SUCCEEDED(ptk_cache_get(c, 0x0123456789abcdefULL, &output_data, &width, &height, &err), &err)) {
+    goto cleanup;
+  }
+  if (TEST_CHECK(output_data != NULL)) {
+    TEST_CHECK(width == 2);
+    TEST_CHECK(height == 2);
+    TEST_CHECK(memcmp(output_data, input_data, sizeof(input_data)) == 0);
+    TEST_DUMP("want:", input_data, sizeof(input_data));
+    TEST_DUMP("got:", output_data, sizeof(input_data));
+  }
+
+cleanup:
+  if (output_data) {
+    OV_FREE(&output_data);
+  }
+  ptk_cache_slot_destroy(&slot);
+  ptk_cache_destroy(&c);
+}
+
+static void test_cache_borrow_and_release(void) {
+  struct ov_error err = {0};
+  struct ptk_cache *c = NULL;
+  struct ptk_cache_ref *ref = NULL;
+  void const *data = NULL;
+  int32_t width = 0;
+  int32_t height = 0;
+  uint8_t const input_data[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+
+  c = ptk_cache_create(&err);
+  if (!TEST_SUCCEEDED(c != NULL, &err)) {
+    return;
+  }
+
+  // Miss
+  if (!TEST_SUCCEEDED(ptk_cache_borrow(c, 0x0123456789abcdefULL, &ref, &data, &width, &height, &err), &err)) {
+    goto cleanup;
+  }
+  TEST_CHECK(ref == NULL);
+  TEST_CHECK(data == NULL);
+
+  if (!TEST_SUCCEEDED(ptk_cache_put(c, 0x0123456789abcdefULL, input_data, 2, 2, &err), &err)) {
+    goto cleanup;
+  }
+
+  // Hit
+  if (!TEST_SUCCEEDED(ptk_cache_borrow(c, 0x0123456789abcdefULL, &ref, &data, &width, &height, &err), &err)) {
+    goto cleanup;
+  }
+  if (!TEST_CHECK(ref != NULL && data != NULL)) {
+    goto cleanup;
+  }
+  TEST_CHECK(width == 2);
+  TEST_CHECK(height == 2);
+  TEST_CHECK(memcmp(data, input_data, sizeof(input_data)) == 0);
+
+  // Borrowed data must survive clear until released
+  ptk_cache_clear(c);
+  TEST_CHECK(memcmp(data, input_data, sizeof(input_data)) == 0);
+  TEST_DUMP("want:", input_data, sizeof(input_data));
+  TEST_DUMP("got:", data, sizeof(input_data));
+  ptk_cache_release(c, &ref);
+  TEST_CHECK(ref == NULL);
+
+  // Entry is gone after clear
+  if (!TEST_SUCCEEDED(ptk_cache_borrow(c, 0x0123456789abcdefULL, &ref, &data, &width, &height, &err), &err)) {
+    goto cleanup;
+  }
+  TEST_CHECK(ref == NULL);
+
+cleanup:
+  ptk_cache_release(c, &ref);
+  ptk_cache_destroy(&c);
+}
+
+static void test_cache_codec_roundtrip(void) {
+  // Pixel patterns as uint32 values: 0 is a fully transparent zero pixel
+  static uint32_t const patterns[][8] = {
+      {0, 0, 0, 0, 0, 0, 0, 0},
+      {1, 2, 3, 4, 5, 6, 7, 8},
+      {0, 1, 0, 0, 2, 3, 0, 0},
+      {1, 0, 2, 0, 3, 0, 4, 0},
+      {0, 0, 0, 1, 1, 0, 0, 0},
+  };
+  struct ptk_cache_codec const *const codecs[] = {&ptk_cache_codec_raw, &ptk_cache_codec_zero_rle};
+  uint8_t encoded[64];
+  uint8_t decoded[32];
+
+  for (size_t ci = 0; ci < sizeof(codecs) / sizeof(codecs[0]); ++ci) {
+    struct ptk_cache_codec const *const codec = codecs[ci];
+    TEST_CHECK(ptk_cache_codec_find(codec->id) == codec);
+    for (size_t pi = 0; pi < sizeof(patterns) / sizeof(patterns[0]); ++pi) {
+      TEST_CASE_("%s pattern %zu", codec->name, pi);
+      uint8_t const *const src = (uint8_t const *)patterns[pi];
+      if (!TEST_CHECK(codec->bound(sizeof(patterns[pi])) <= sizeof(encoded))) {
+        continue;
+      }
+      size_t const encoded_size = codec->encode(src, sizeof(patterns[pi]), encoded);
+      TEST_CHECK(encoded_size <= codec->bound(sizeof(patterns[pi])));
+      memset(decoded, 0xcc, sizeof(decoded));
+      TEST_CHECK(codec->decode(encoded, encoded_size, decoded, sizeof(decoded)));
+      TEST_CHECK(memcmp(decoded, src, sizeof(decoded)) == 0);
+      // Output size must match exactly
+      TEST_CHECK(!codec->decode(encoded, encoded_size, decoded, sizeof(decoded) - 4));
+    }
+  }
+
+  // All-zero data collapses into a single token
+  TEST_CHECK(ptk_cache_codec_zero_rle.encode((uint8_t const *)patterns[0], sizeof(patterns[0]), encoded) == 4);
+  // Truncated input is rejected
+  size_t const n = ptk_cache_codec_zero_rle.encode((uint8_t const *)patterns[1], sizeof(patterns[1]), encoded);
+  TEST_CHECK(!ptk_cache_codec_zero_rle.decode(encoded, n - 1, decoded, sizeof(decoded)));
+  TEST_CHECK(ptk_cache_codec_find(0) == NULL);
+}
+
+static void test_cache_eviction_write_behind(void) {
+  // 72 frames of 4MB overflow the 256MB memory tier, the oldest are written to files in the background
+  enum { frame_w = 1024, frame_h = 1024, frame_count = 72 };
+  size_t const frame_size = (size_t)frame_w * frame_h * 4;
+  struct ov_error err = {0};
+  struct ptk_cache *c = NULL;
+  struct ptk_cache_ref *ref = NULL;
+  uint8_t *frame = NULL;
+  void const *data = NULL;
+  int32_t width = 0;
+  int32_t height = 0;
+
+  if (!TEST_CHECK(OV_REALLOC(&frame, frame_size, 1))) {
+    return;
+  }
+  c = ptk_cache_create(&err);
+  if (!TEST_SUCCEEDED(c != NULL, &err)) {
+    goto cleanup;
+  }
+
+  for (int i = 0; i < frame_count; ++i) {
+    memset(frame, i + 1, frame_size);
+    if (!TEST_SUCCEEDED(ptk_cache_put(c, 0xfeed000000000000ULL + (uint64_t)i, frame, frame_w, frame_h, &err), &err)) {
+      goto cleanup;
+    }
+  }
+
+  for (int i = 0; i < frame_count; ++i) {
+    TEST_CASE_("frame %d", i);
+    if (!TEST_SUCCEEDED(
+            ptk_cache_borrow(c, 0xfeed000000000000ULL + (uint64_t)i, &ref, &data, &width, &height, &err), &err)) {
+      goto cleanup;
+    }
+    if (TEST_CHECK(ref != NULL)) {
+      memset(frame, i + 1, frame_size);
+      TEST_CHECK(width == frame_w && height == frame_h);
+      TEST_CHECK(memcmp(data, frame, frame_size) == 0);
+    }
+    ptk_cache_release(c, &ref);
+  }
+  TEST_CASE_(NULL);
+
+cleanup:
+  ptk_cache_release(c, &ref);
+  ptk_cache_destroy(&c);
+  if (frame) {
+    OV_FREE(&frame);
+  }
+}
+
+// Build TEMP/PSDToolKitCacheTest/ and remove files left by a previous run
+static bool prepare_persistent_dir(wchar_t *const dir, size_t const dir_len) {
+  DWORD const len = GetTempPathW((DWORD)dir_len, dir);
+  if (len == 0 || len + 32 > dir_len) {
+    return false;
+  }
+  wcscpy(dir + len, L"PSDToolKitCacheTest\\");
+  wchar_t pattern[MAX_PATH + 64];
+  wchar_t path[MAX_PATH + 64];
+  wcscpy(pattern, dir);
+  wcscat(pattern, L"*");
+  WIN32_FIND_DATAW find_data = {0};
+  HANDLE const h = FindFirstFileW(pattern, &find_data);
+  if (h != INVALID_HANDLE_VALUE) {
+    do {
+      if (!(find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+        wcscpy(path, dir);
+        wcscat(path, find_data.cFileName);
+        DeleteFileW(path);
+      }
+    } while (FindNextFileW(h, &find_data));
+    FindClose(h);
+  }
+  return true;
+}
+
+// Store a 2x2 frame and borrow it once, as a render followed by display does
+static bool put_and_show(struct ptk_cache *const c, uint64_t const ckey, struct ov_error *const err) {
+  uint8_t frame[2 * 2 * 4];
+  memset(frame, (int)(ckey & 0xff) | 1, sizeof(frame));
+  struct ptk_cache_ref *ref = NULL;
+  void const *data = NULL;
+  int32_t width = 0;
+  int32_t height = 0;
+  if (!ptk_cache_put(c, ckey, frame, 2, 2, err) || !ptk_cache_borrow(c, ckey, &ref, &data, &width, &height, err)) {
+    return false;
+  }
+  ptk_cache_release(c, &ref);
+  return true;
+}
+
+static void test_cache_policy(void) {
+  // Room for 4 frames in memory and 2 files
+  static size_t const memory_limit = 2 * 2 * 4 * 4;
+  static size_t const file_limit = (16 + 2 * 2 * 4) * 2;
+  static struct {
+    enum ptk_cache_policy policy;
+    bool hot_kept;
+  } const tests[] = {
+      {ptk_cache_policy_lru, false},
+      {ptk_cache_policy_2q, true},
+  };
+  struct ov_error err = {0};
+  struct ptk_cache *c = NULL;
+  struct ptk_cache_ref *ref = NULL;
+  void const *data = NULL;
+  int32_t width = 0;
+  int32_t height = 0;
+
+  for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); ++i) {
+    TEST_CASE_("policy %d", (int)tests[i].policy);
+    c = ptk_cache_create(&err);
+    if (!TEST_SUCCEEDED(c != NULL, &err)) {
+      goto cleanup;
+    }
+    ptk_cache_set_policy(c, tests[i].policy);
+    ptk_cache_set_limits(c, memory_limit, file_limit);
+
+    // A frame shown twice, then a scan over frames shown once
+    if (!TEST_SUCCEEDED(put_and_show(c, 0x1000, &err), &err) ||
+        !TEST_SUCCEEDED(ptk_cache_borrow(c, 0x1000, &ref, &data, &width, &height, &err), &err)) {
+      goto cleanup;
+    }
+    ptk_cache_release(c, &ref);
+    for (uint64_t key = 0x2000; key < 0x2010; ++key) {
+      if (!TEST_SUCCEEDED(put_and_show(c, key, &err), &err)) {
+        goto cleanup;
+      }
+    }
+    ptk_cache_flush(c);
+
+    TEST_CHECK(ptk_cache_contains(c, 0x1000) == tests[i].hot_kept);
+    TEST_CHECK(!ptk_cache_contains(c, 0x2000));
+    TEST_CHECK(ptk_cache_contains(c, 0x200f));
+
+    // Lowering the limits evicts right away
+    ptk_cache_set_limits(c, 0, 0);
+    ptk_cache_flush(c);
+    TEST_CHECK(!ptk_cache_contains(c, 0x200f));
+    ptk_cache_destroy(&c);
+  }
+  TEST_CASE_(NULL);
+
+cleanup:
+  ptk_cache_release(c, &ref);
+  ptk_cache_destroy(&c);
+}
+
+static void test_cache_stats(void) {
+  struct ov_error err = {0};
+  struct ptk_cache *c = NULL;
+  struct ptk_cache_ref *ref = NULL;
+  struct ptk_cache_stats stats = {0};
+  uint8_t frame[2 * 2 * 4];
+  void const *data = NULL;
+  int32_t width = 0;
+  int32_t height = 0;
+
+  memset(frame, 0x55, sizeof(frame));
+  c = ptk_cache_create(&err);
+  if (!TEST_SUCCEEDED(c != NULL, &err)) {
+    goto cleanup;
+  }
+  if (!TEST_SUCCEEDED(ptk_cache_put(c, 0x1000, frame, 2, 2, &err), &err)) {
+    goto cleanup;
+  }
+  TEST_CHECK(ptk_cache_contains(c, 0x1000));
+  TEST_CHECK(!ptk_cache_contains(c, 0x2000));
+  if (!TEST_SUCCEEDED(ptk_cache_borrow(c, 0x1000, &ref, &data, &width, &height, &err), &err)) {
+    goto cleanup;
+  }
+  ptk_cache_release(c, &ref);
+  if (!TEST_SUCCEEDED(ptk_cache_borrow(c, 0x2000, &ref, &data, &width, &height, &err), &err)) {
+    goto cleanup;
+  }
+  TEST_CHECK(ref == NULL);
+
+  // Move the entry to the file tier and read it back
+  ptk_cache_set_limits(c, 0, 1024 * 1024);
+  ptk_cache_flush(c);
+  if (!TEST_SUCCEEDED(ptk_cache_borrow(c, 0x1000, &ref, &data, &width, &height, &err), &err)) {
+    goto cleanup;
+  }
+  TEST_CHECK(ref != NULL);
+
+  ptk_cache_get_stats(c, &stats);
+  TEST_CHECK(stats.contains_hits == 1 && stats.contains_misses == 1);
+  TEST_CHECK(stats.memory_hits == 1 && stats.file_hits == 1 && stats.persistent_hits == 0 && stats.misses == 1);
+  TEST_CHECK(stats.bytes_in == sizeof(frame) && stats.bytes_out == sizeof(frame) * 2);
+  TEST_CHECK(stats.memory_evictions == 1 && stats.file_evictions == 0);
+  TEST_CHECK(stats.file_reads == 1 && stats.file_read_max_usec <= stats.file_read_usec);
+  TEST_CHECK(stats.memory_used == sizeof(frame) && stats.memory_limit == 0 && stats.file_used == 0);
+  TEST_CHECK(stats.persistent_limit == 0);
+
+cleanup:
+  ptk_cache_release(c, &ref);
+  ptk_cache_destroy(&c);
+}
+
+static void test_cache_persistent(void) {
+  static uint64_t const key_a = 0x1111222233334444ULL;
+  static uint64_t const key_b = 0x5555666677778888ULL;
+  uint8_t const data_a[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16};
+  uint8_t const data_b[16] = {16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1};
+  // 2x2 pixels without zero pixels are stored raw: 16 bytes of header and 16 bytes of data
+  uint64_t const one_entry_limit = 40;
+  struct ov_error err = {0};
+  struct ptk_cache *c = NULL;
+  struct ptk_cache *c2 = NULL;
+  void *output_data = NULL;
+  int32_t width = 0;
+  int32_t height = 0;
+  wchar_t dir[MAX_PATH + 64];
+
+  if (!TEST_CHECK(prepare_persistent_dir(dir, sizeof(dir) / sizeof(dir[0])))) {
+    return;
+  }
+
+  TEST_FAILED_WITH(ptk_cache_enable_persistent(NULL, dir, 1024, &err),
+                   &err,
+                   ov_error_type_generic,
+                   ov_error_generic_invalid_argument);
+
+  // First session stores an entry
+  c = ptk_cache_create(&err);
+  if (!TEST_SUCCEEDED(c != NULL, &err)) {
+    goto cleanup;
+  }
+  if (!TEST_SUCCEEDED(ptk_cache_enable_persistent(c, dir, 1024 * 1024, &err), &err)) {
+    goto cleanup;
+  }
+  if (!TEST_SUCCEEDED(ptk_cache_put(c, key_a, data_a, 2, 2, &err), &err)) {
+    goto cleanup;
+  }
+  ptk_cache_destroy(&c);
+
+  // Second session finds it, and the directory is locked against other instances
+  c = ptk_cache_create(&err);
+  if (!TEST_SUCCEEDED(c != NULL, &err)) {
+    goto cleanup;
+  }
+  TEST_CHECK(!ptk_cache_contains(c, key_a));
+  if (!TEST_SUCCEEDED(ptk_cache_enable_persistent(c, dir, 1024 * 1024, &err), &err)) {
+    goto cleanup;
+  }
+  c2 = ptk_cache_create(&err);
+  if (!TEST_SUCCEEDED(c2 != NULL, &err)) {
+    goto cleanup;
+  }
+  TEST_FAILED_WITH(ptk_cache_enable_persistent(c2, dir, 1024 * 1024, &err),
+                   &err,
+                   ov_error_type_hresult,
+                   HRESULT_FROM_WIN32(ERROR_SHARING_VIOLATION));
+  ptk_cache_destroy(&c2);
+
+  TEST_CHECK(ptk_cache_contains(c, key_a));
+  if (!TEST_SUCCEEDED(ptk_cache_get(c, key_a, &output_data, &width, &height, &err), &err)) {
+    goto cleanup;
+  }
+  if (TEST_CHECK(output_data != NULL)) {
+    TEST_CHECK(width == 2);
+    TEST_CHECK(height == 2);
+    TEST_CHECK(memcmp(output_data, data_a, sizeof(data_a)) == 0);
+    OV_FREE(&output_data);
+  }
+
+  // Shrinking the limit keeps only the most recently used entry on disk
+  if (!TEST_SUCCEEDED(ptk_cache_enable_persistent(c, dir, one_entry_limit, &err), &err)) {
+    goto cleanup;
+  }
+  if (!TEST_SUCCEEDED(ptk_cache_put(c, key_b, data_b, 2, 2, &err), &err)) {
+    goto cleanup;
+  }
+  TEST_CHECK(ptk_cache_contains(c, key_a)); // still in the memory tier
+  ptk_cache_destroy(&c);
+
+  c = ptk_cache_create(&err);
+  if (!TEST_SUCCEEDED(c != NULL, &err)) {
+    goto cleanup;
+  }
+  if (!TEST_SUCCEEDED(ptk_cache_enable_persistent(c, dir, one_entry_limit, &err), &err)) {
+    goto cleanup;
+  }
+  TEST_CHECK(!ptk_cache_contains(c, key_a));
+  TEST_CHECK(ptk_cache_contains(c, key_b));
+
+  // Clearing only drops the memory and file tiers
+  ptk_cache_clear(c);
+  if (!TEST_SUCCEEDED(ptk_cache_get(c, key_b, &output_data, &width, &height, &err), &err)) {
+    goto cleanup;
+  }
+  if (TEST_CHECK(output_data != NULL)) {
+    TEST_CHECK(memcmp(output_data, data_b, sizeof(data_b)) == 0);
+    OV_FREE(&output_data);
+  }
+
+cleanup:
+  if (output_data) {
+    OV_FREE(&output_data);
+  }
+  ptk_cache_destroy(&c2);
+  ptk_cache_destroy(&c);
+  prepare_persistent_dir(dir, sizeof(dir) / sizeof(dir[0]));
+  RemoveDirectoryW(dir);
+}
+
 TEST_LIST = {
     {"test_cache_create_and_destroy", test_cache_create_and_destroy},
     {"test_cache_put_invalid_args", test_cache_put_invalid_args},
@@ -505,5 +978,12 @@ TEST_LIST = {
     {"test_cache_large_image", test_cache_large_image},
     {"test_cache_recreate_clears_data", test_cache_recreate_clears_data},
     {"test_cache_multiple_instances", test_cache_multiple_instances},
+    {"test_cache_put_slot", test_cache_put_slot},
+    {"test_cache_borrow_and_release", test_cache_borrow_and_release},
+    {"test_cache_codec_roundtrip", test_cache_codec_roundtrip},
+    {"test_cache_eviction_write_behind", test_cache_eviction_write_behind},
+    {"test_cache_policy", test_cache_policy},
+    {"test_cache_stats", test_cache_stats},
+    {"test_cache_persistent", test_cache_persistent},
     {NULL, NULL},
 };
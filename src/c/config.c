@@ -26,6 +26,15 @@ struct ptk_config {
   bool debug_mode;
   // Resize quality (ptk_resize_quality)
   int resize_quality;
+  // Persistent render cache
+  bool persistent_cache;
+  int persistent_cache_size; // in MiB
+  // Render cache budgets and eviction policy (ptk_cache_policy)
+  int memory_cache_size; // in MiB
+  int file_cache_size;   // in MiB
+  int cache_policy;
+  // Size of the rendered frame cache in PSDToolKit.exe, 0 leaves caching to the tiers above
+  int draw_cache_size; // in MiB
 };
 
 static bool get_dll_directory(NATIVE_CHAR **const dir, struct ov_error *const err) {
@@ -90,6 +99,12 @@ struct ptk_config *ptk_config_create(struct ov_error *const err) {
       .external_object_audio_text = false,
       .debug_mode = false,
       .resize_quality = ptk_resize_quality_beautiful,
+      .persistent_cache = false,
+      .persistent_cache_size = 1024,
+      .memory_cache_size = 256,
+      .file_cache_size = 256,
+      .cache_policy = 0,
+      .draw_cache_size = 0,
   };
 
   result = cfg;
@@ -153,6 +168,12 @@ static char const g_json_key_external_wav_txt_pair[] = "external_wav_txt_pair";
 static char const g_json_key_external_object_audio_text[] = "external_object_audio_text";
 static char const g_json_key_debug_mode[] = "debug_mode";
 static char const g_json_key_resize_quality[] = "resize_quality";
+static char const g_json_key_persistent_cache[] = "persistent_cache";
+static char const g_json_key_persistent_cache_size[] = "persistent_cache_size";
+static char const g_json_key_memory_cache_size[] = "memory_cache_size";
+static char const g_json_key_file_cache_size[] = "file_cache_size";
+static char const g_json_key_cache_policy[] = "cache_policy";
+static char const g_json_key_draw_cache_size[] = "draw_cache_size";
 
 bool ptk_config_load(struct ptk_config *const config, struct ov_error *const err) {
   if (!config) {
@@ -259,6 +280,36 @@ bool ptk_config_load(struct ptk_config *const config, struct ov_error *const err
     if (val && yyjson_is_int(val)) {
       config->resize_quality = (int)yyjson_get_int(val);
     }
+
+    val = yyjson_obj_get(root, g_json_key_persistent_cache);
+    if (val && yyjson_is_bool(val)) {
+      config->persistent_cache = yyjson_get_bool(val);
+    }
+
+    val = yyjson_obj_get(root, g_json_key_persistent_cache_size);
+    if (val && yyjson_is_int(val) && yyjson_get_int(val) > 0) {
+      config->persistent_cache_size = (int)yyjson_get_int(val);
+    }
+
+    val = yyjson_obj_get(root, g_json_key_memory_cache_size);
+    if (val && yyjson_is_int(val) && yyjson_get_int(val) > 0) {
+      config->memory_cache_size = (int)yyjson_get_int(val);
+    }
+
+    val = yyjson_obj_get(root, g_json_key_file_cache_size);
+    if (val && yyjson_is_int(val) && yyjson_get_int(val) >= 0) {
+      config->file_cache_size = (int)yyjson_get_int(val);
+    }
+
+    val = yyjson_obj_get(root, g_json_key_cache_policy);
+    if (val && yyjson_is_int(val)) {
+      config->cache_policy = (int)yyjson_get_int(val);
+    }
+
+    val = yyjson_obj_get(root, g_json_key_draw_cache_size);
+    if (val && yyjson_is_int(val) && yyjson_get_int(val) >= 0) {
+      config->draw_cache_size = (int)yyjson_get_int(val);
+    }
   }
 
   result = true;
@@ -315,6 +366,12 @@ bool ptk_config_save(struct ptk_config const *const config, struct ov_error *con
     yyjson_mut_obj_add_bool(doc, root, g_json_key_external_object_audio_text, config->external_object_audio_text);
     yyjson_mut_obj_add_bool(doc, root, g_json_key_debug_mode, config->debug_mode);
     yyjson_mut_obj_add_int(doc, root, g_json_key_resize_quality, config->resize_quality);
+    yyjson_mut_obj_add_bool(doc, root, g_json_key_persistent_cache, config->persistent_cache);
+    yyjson_mut_obj_add_int(doc, root, g_json_key_persistent_cache_size, config->persistent_cache_size);
+    yyjson_mut_obj_add_int(doc, root, g_json_key_memory_cache_size, config->memory_cache_size);
+    yyjson_mut_obj_add_int(doc, root, g_json_key_file_cache_size, config->file_cache_size);
+    yyjson_mut_obj_add_int(doc, root, g_json_key_cache_policy, config->cache_policy);
+    yyjson_mut_obj_add_int(doc, root, g_json_key_draw_cache_size, config->draw_cache_size);
 
     json_str = yyjson_mut_write_opts(doc, YYJSON_WRITE_PRETTY, ptk_json_get_alc(), NULL, NULL);
     if (!json_str) {
@@ -522,3 +579,123 @@ bool ptk_config_set_resize_quality(struct ptk_config *const config, int const va
   config->resize_quality = value;
   return true;
 }
+
+bool ptk_config_get_persistent_cache(struct ptk_config const *const config,
+                                     bool *const value,
+                                     struct ov_error *const err) {
+  if (!config || !value) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_invalid_argument);
+    return false;
+  }
+  *value = config->persistent_cache;
+  return true;
+}
+
+bool ptk_config_set_persistent_cache(struct ptk_config *const config, bool const value, struct ov_error *const err) {
+  if (!config) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_invalid_argument);
+    return false;
+  }
+  config->persistent_cache = value;
+  return true;
+}
+
+bool ptk_config_get_persistent_cache_size(struct ptk_config const *const config,
+                                          int *const value,
+                                          struct ov_error *const err) {
+  if (!config || !value) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_invalid_argument);
+    return false;
+  }
+  *value = config->persistent_cache_size;
+  return true;
+}
+
+bool ptk_config_set_persistent_cache_size(struct ptk_config *const config,
+                                          int const value,
+                                          struct ov_error *const err) {
+  if (!config || value <= 0) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_invalid_argument);
+    return false;
+  }
+  config->persistent_cache_size = value;
+  return true;
+}
+
+bool ptk_config_get_memory_cache_size(struct ptk_config const *const config,
+                                      int *const value,
+                                      struct ov_error *const err) {
+  if (!config || !value) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_invalid_argument);
+    return false;
+  }
+  *value = config->memory_cache_size;
+  return true;
+}
+
+bool ptk_config_set_memory_cache_size(struct ptk_config *const config, int const value, struct ov_error *const err) {
+  if (!config || value <= 0) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_invalid_argument);
+    return false;
+  }
+  config->memory_cache_size = value;
+  return true;
+}
+
+bool ptk_config_get_file_cache_size(struct ptk_config const *const config,
+                                    int *const value,
+                                    struct ov_error *const err) {
+  if (!config || !value) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_invalid_argument);
+    return false;
+  }
+  *value = config->file_cache_size;
+  return true;
+}
+
+bool ptk_config_set_file_cache_size(struct ptk_config *const config, int const value, struct ov_error *const err) {
+  if (!config || value < 0) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_invalid_argument);
+    return false;
+  }
+  config->file_cache_size = value;
+  return true;
+}
+
+bool ptk_config_get_cache_policy(struct ptk_config const *const config, int *const value, struct ov_error *const err) {
+  if (!config || !value) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_invalid_argument);
+    return false;
+  }
+  *value = config->cache_policy;
+  return true;
+}
+
+bool ptk_config_set_cache_policy(struct ptk_config *const config, int const value, struct ov_error *const err) {
+  if (!config) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_invalid_argument);
+    return false;
+  }
+  config->cache_policy = value;
+  return true;
+}
+
+bool ptk_config_get_draw_cache_size(struct ptk_config const *const config,
+                                    int *const value,
+                                    struct ov_error *const err) {
+  if (!config || !value) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_invalid_argument);
+    return false;
+  }
+  *value = config->draw_cache_size;
+  return true;
+}
+
+bool ptk_config_set_draw_cache_size(struct ptk_config *const config, int const value, struct ov_error *const err) {
+  if (!config || value < 0) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_invalid_argument);
+    return false;
+  }
+  config->draw_cache_size = value;
+  return true;
+}
@@ -91,3 +91,38 @@ enum ptk_resize_quality {
 
 bool ptk_config_get_resize_quality(struct ptk_config const *const config, int *const value, struct ov_error *const err);
 bool ptk_config_set_resize_quality(struct ptk_config *const config, int const value, struct ov_error *const err);
+
+// Persistent render cache settings
+
+bool ptk_config_get_persistent_cache(struct ptk_config const *const config,
+                                     bool *const value,
+                                     struct ov_error *const err);
+bool ptk_config_set_persistent_cache(struct ptk_config *const config, bool const value, struct ov_error *const err);
+
+// Size limit of the persistent render cache in MiB
+bool ptk_config_get_persistent_cache_size(struct ptk_config const *const config,
+                                          int *const value,
+                                          struct ov_error *const err);
+bool ptk_config_set_persistent_cache_size(struct ptk_config *const config, int const value, struct ov_error *const err);
+
+// Render cache budgets in MiB, file_cache_size may be 0 to keep nothing on disk
+bool ptk_config_get_memory_cache_size(struct ptk_config const *const config,
+                                      int *const value,
+                                      struct ov_error *const err);
+bool ptk_config_set_memory_cache_size(struct ptk_config *const config, int const value, struct ov_error *const err);
+bool ptk_config_get_file_cache_size(struct ptk_config const *const config,
+                                    int *const value,
+                                    struct ov_error *const err);
+bool ptk_config_set_file_cache_size(struct ptk_config *const config, int const value, struct ov_error *const err);
+
+// Render cache eviction policy - must match enum ptk_cache_policy in cache.h
+
+bool ptk_config_get_cache_policy(struct ptk_config const *const config, int *const value, struct ov_error *const err);
+bool ptk_config_set_cache_policy(struct ptk_config *const config, int const value, struct ov_error *const err);
+
+// Size of the rendered frame cache in PSDToolKit.exe in MiB, 0 disables it.
+// Takes effect when PSDToolKit.exe is started.
+bool ptk_config_get_draw_cache_size(struct ptk_config const *const config,
+                                    int *const value,
+                                    struct ov_error *const err);
+bool ptk_config_set_draw_cache_size(struct ptk_config *const config, int const value, struct ov_error *const err);
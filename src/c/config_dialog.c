@@ -30,6 +30,7 @@ enum {
 
   id_group_psd_file = 140,
   id_check_manual_shift_psd = 141,
+  id_check_persistent_cache = 142,
   id_label_resize_quality = 150,
   id_combo_resize_quality = 151,
 
@@ -308,6 +309,10 @@ static INT_PTR init_dialog(HWND dialog, struct dialog_data *data) {
       pgettext("config", "Only create PSD file object when dropping *.&psd/*.psb file while holding Shift key"));
   SetWindowTextW(GetDlgItem(dialog, id_check_manual_shift_psd), buf);
 
+  ov_snprintf_wchar(
+      buf, sizeof(buf) / sizeof(WCHAR), ph, ph, pgettext("config", "&Keep rendered images between sessions"));
+  SetWindowTextW(GetDlgItem(dialog, id_check_persistent_cache), buf);
+
   ov_snprintf_wchar(buf, sizeof(buf) / sizeof(WCHAR), ph, ph, pgettext("config", "Resize Quality:"));
   SetWindowTextW(GetDlgItem(dialog, id_label_resize_quality), buf);
 
@@ -375,6 +380,13 @@ static INT_PTR init_dialog(HWND dialog, struct dialog_data *data) {
       OV_ERROR_REPORT(&err, NULL);
     }
 
+    value = false;
+    if (ptk_config_get_persistent_cache(data->config, &value, &err)) {
+      SendMessageW(GetDlgItem(dialog, id_check_persistent_cache), BM_SETCHECK, value ? BST_CHECKED : BST_UNCHECKED, 0);
+    } else {
+      OV_ERROR_REPORT(&err, NULL);
+    }
+
     int quality = ptk_resize_quality_beautiful;
     if (ptk_config_get_resize_quality(data->config, &quality, &err)) {
       SendMessageW(GetDlgItem(dialog, id_combo_resize_quality), CB_SETCURSEL, (WPARAM)quality, 0);
@@ -454,6 +466,15 @@ static bool click_ok(HWND dialog, struct dialog_data *data) {
     }
   }
 
+  {
+    // Save persistent_cache
+    LRESULT const checked = SendMessageW(GetDlgItem(dialog, id_check_persistent_cache), BM_GETCHECK, 0, 0);
+    if (!ptk_config_set_persistent_cache(data->config, checked == BST_CHECKED, &err)) {
+      OV_ERROR_ADD_TRACE(&err);
+      goto cleanup;
+    }
+  }
+
   {
     // Save resize_quality from combo box
     LRESULT const sel = SendMessageW(GetDlgItem(dialog, id_combo_resize_quality), CB_GETCURSEL, 0, 0);
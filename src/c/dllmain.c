@@ -419,6 +419,18 @@ static void script_module_draw(struct aviutl2_script_module_param *param) {
   ptk_script_module_draw(g_script_module, param);
 }
 
+static void script_module_draw_batch(struct aviutl2_script_module_param *param) {
+  ptk_script_module_draw_batch(g_script_module, param);
+}
+
+static void script_module_get_cache_stats(struct aviutl2_script_module_param *param) {
+  ptk_script_module_get_cache_stats(g_script_module, param);
+}
+
+static void script_module_log_cache_stats(struct aviutl2_script_module_param *param) {
+  ptk_script_module_log_cache_stats(g_script_module, param);
+}
+
 static void script_module_get_preferred_languages(struct aviutl2_script_module_param *param) {
   ptk_script_module_get_preferred_languages(g_script_module, param);
 }
@@ -571,6 +583,9 @@ void __declspec(dllexport) RegisterPlugin(struct aviutl2_host_app_table *host) {
       {L"add_psd_file", script_module_add_psd_file},
       {L"set_props", script_module_set_props},
       {L"draw", script_module_draw},
+      {L"draw_batch", script_module_draw_batch},
+      {L"get_cache_stats", script_module_get_cache_stats},
+      {L"log_cache_stats", script_module_log_cache_stats},
       {L"read_text_file", script_module_read_text_file},
       {NULL, NULL},
   };
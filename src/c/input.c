@@ -27,8 +27,9 @@ struct ptk_input {
 // Input file handle structure
 struct ptk_input_handle {
   BITMAPINFOHEADER bih;
-  uint8_t *data;    // Cached pixel data (BGRA)
-  size_t data_size; // Size of pixel data
+  struct ptk_cache_ref *ref; // Borrowed cache entry, pinned until close
+  uint8_t const *data;       // Cached pixel data (BGRA), owned by the cache
+  size_t data_size;          // Size of pixel data
 };
 
 /**
@@ -112,7 +113,8 @@ aviutl2_input_handle ptk_input_open(struct ptk_input *const inp, wchar_t const *
   struct ov_error err = {0};
   struct ptk_input_handle *h = NULL;
   uint64_t ckey = 0;
-  void *data = NULL;
+  struct ptk_cache_ref *ref = NULL;
+  void const *data = NULL;
   int32_t width = 0;
   int32_t height = 0;
   aviutl2_input_handle result = NULL;
@@ -126,8 +128,8 @@ aviutl2_input_handle ptk_input_open(struct ptk_input *const inp, wchar_t const *
     goto cleanup;
   }
 
-  // Try to get from cache
-  if (!ptk_cache_get(inp->cache, ckey, &data, &width, &height, &err)) {
+  // Try to borrow from cache
+  if (!ptk_cache_borrow(inp->cache, ckey, &ref, &data, &width, &height, &err)) {
     // Error occurred
     OV_ERROR_REPORT(&err, NULL);
     goto cleanup;
@@ -139,11 +141,12 @@ aviutl2_input_handle ptk_input_open(struct ptk_input *const inp, wchar_t const *
   }
   *h = (struct ptk_input_handle){0};
 
-  if (data) {
+  if (ref) {
     // Cache hit
-    h->data = (uint8_t *)data;
+    h->ref = ref;
+    h->data = (uint8_t const *)data;
     h->data_size = (size_t)width * (size_t)height * 4;
-    data = NULL; // Transfer ownership
+    ref = NULL; // Transfer ownership
   } else {
     // Cache miss - return error
     goto cleanup;
@@ -167,25 +170,20 @@ aviutl2_input_handle ptk_input_open(struct ptk_input *const inp, wchar_t const *
   h = NULL;
 
 cleanup:
-  if (data) {
-    OV_FREE(&data);
+  if (ref) {
+    ptk_cache_release(inp->cache, &ref);
   }
   if (h) {
-    if (h->data) {
-      OV_FREE(&h->data);
-    }
+    ptk_cache_release(inp->cache, &h->ref);
     OV_FREE(&h);
   }
   return result;
 }
 
 bool ptk_input_close(struct ptk_input *const inp, aviutl2_input_handle const ih) {
-  (void)inp;
   struct ptk_input_handle *h = (struct ptk_input_handle *)ih;
   if (h) {
-    if (h->data) {
-      OV_FREE(&h->data);
-    }
+    ptk_cache_release(inp ? inp->cache : NULL, &h->ref);
     OV_FREE(&h);
   }
   return true;
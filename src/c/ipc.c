@@ -3,6 +3,7 @@
 #include "logf.h"
 #include "ovarray.h"
 #include "ovthreads.h"
+#include "ovprintf.h"
 
 #include <windows.h>
 
@@ -10,6 +11,18 @@
   ((uint32_t)(((uint32_t)(uint8_t)(c0)) | (((uint32_t)(uint8_t)(c1)) << 8) | (((uint32_t)(uint8_t)(c2)) << 16) |       \
               (((uint32_t)(uint8_t)(c3)) << 24)))
 
+// A request waiting for its reply.
+// Replies may arrive in any order and are matched by id.
+struct ipc_call {
+  uint32_t id;
+  bool done;
+  char *error;   // error message from the renderer (OV_ARRAY)
+  char *payload; // reply payload (OV_ARRAY)
+  size_t pos;    // read position in payload
+  uint64_t start_usec;
+  struct ipc_call *next;
+};
+
 struct ipc {
   HANDLE process;
   HANDLE h_stdin;
@@ -19,21 +32,26 @@ struct ipc {
   mtx_t mtx_stdin;
   mtx_t mtx_reply;
   cnd_t cnd_reply;
-  cnd_t cnd_reply_consumed;
-  bool reply_received;
-  bool reply_consumed;
-  uint32_t reply_value;
-  char *reply_error;
-
-  // Shared memory for pixel data transfer
-  HANDLE shm_handle;
-  void *shm_view;
-  size_t shm_size;
+  struct ipc_call *calls; // in-flight requests waiting for their replies
+  uint32_t next_call_id;
+  struct ipc_stats stats; // guarded by mtx_reply
 
   struct ipc_options opt;
   bool exit_requested;
 };
 
+// Monotonic time in microseconds
+static uint64_t now_usec(void) {
+  static LARGE_INTEGER freq;
+  if (freq.QuadPart == 0) {
+    QueryPerformanceFrequency(&freq);
+  }
+  LARGE_INTEGER t;
+  QueryPerformanceCounter(&t);
+  return (uint64_t)(t.QuadPart / freq.QuadPart) * 1000000 +
+         (uint64_t)(t.QuadPart % freq.QuadPart) * 1000000 / (uint64_t)freq.QuadPart;
+}
+
 static bool write_all(HANDLE h, void const *const buf, size_t const len, struct ov_error *const err) {
   DWORD written = 0;
   if (!WriteFile(h, buf, (DWORD)len, &written, NULL)) {
@@ -93,10 +111,6 @@ static bool read_uint32(HANDLE h, uint32_t *const v, struct ov_error *const err)
   return read_all(h, v, sizeof(*v), err);
 }
 
-static bool read_uint64(HANDLE h, uint64_t *const v, struct ov_error *const err) {
-  return read_all(h, v, sizeof(*v), err);
-}
-
 static bool read_string(HANDLE h, char **const s, struct ov_error *const err) {
   int32_t len = 0;
   bool result = false;
@@ -123,29 +137,68 @@ cleanup:
   return result;
 }
 
-static void ipc_reply_consumed(struct ipc *const self) {
+static bool write_call_header(struct ipc *const self,
+                              uint32_t const cmd,
+                              struct ipc_call const *const call,
+                              struct ov_error *const err) {
+  return write_uint32(self->h_stdin, cmd, err) && write_uint32(self->h_stdin, call->id, err);
+}
+
+// Register a call so that its reply can be routed back by ID.
+// Must be paired with call_end.
+static void call_begin(struct ipc *const self, struct ipc_call *const call) {
+  *call = (struct ipc_call){0};
+  mtx_lock(&self->mtx_reply);
+  do {
+    call->id = ++self->next_call_id;
+  } while (call->id == 0); // 0 is reserved for broadcast replies
+  call->next = self->calls;
+  self->calls = call;
+  mtx_unlock(&self->mtx_reply);
+  call->start_usec = now_usec();
+}
+
+// Add the round trip time of a call that has received its reply to l
+static void call_record(struct ipc *const self, struct ipc_call const *const call, struct ipc_latency *const l) {
+  uint64_t const elapsed = now_usec() - call->start_usec;
   mtx_lock(&self->mtx_reply);
-  self->reply_consumed = true;
-  cnd_signal(&self->cnd_reply_consumed);
+  ++l->count;
+  l->total_usec += elapsed;
+  if (elapsed > l->max_usec) {
+    l->max_usec = elapsed;
+  }
   mtx_unlock(&self->mtx_reply);
 }
 
-static bool wait_for_reply(struct ipc *const self, uint32_t *const reply, struct ov_error *const err) {
+static void call_end(struct ipc *const self, struct ipc_call *const call) {
+  mtx_lock(&self->mtx_reply);
+  for (struct ipc_call **p = &self->calls; *p; p = &(*p)->next) {
+    if (*p == call) {
+      *p = call->next;
+      break;
+    }
+  }
+  mtx_unlock(&self->mtx_reply);
+  if (call->error) {
+    OV_ARRAY_DESTROY(&call->error);
+  }
+  if (call->payload) {
+    OV_ARRAY_DESTROY(&call->payload);
+  }
+}
+
+static bool call_wait(struct ipc *const self, struct ipc_call *const call, struct ov_error *const err) {
   bool result = false;
   mtx_lock(&self->mtx_reply);
-  while (!self->reply_received && !self->exit_requested) {
+  while (!call->done && !self->exit_requested) {
     cnd_wait(&self->cnd_reply, &self->mtx_reply);
   }
-  if (self->exit_requested) {
+  if (!call->done) {
     OV_ERROR_SET_GENERIC(err, ov_error_generic_abort);
     goto cleanup;
   }
-  *reply = self->reply_value;
-  self->reply_received = false;
-  if (self->reply_error) {
-    OV_ERROR_SET(err, ov_error_type_generic, ov_error_generic_fail, self->reply_error);
-    OV_ARRAY_DESTROY(&self->reply_error);
-    self->reply_error = NULL;
+  if (call->error) {
+    OV_ERROR_SET(err, ov_error_type_generic, ov_error_generic_fail, call->error);
     goto cleanup;
   }
   result = true;
@@ -154,6 +207,146 @@ cleanup:
   return result;
 }
 
+static bool call_read(struct ipc_call *const call, void *const buf, size_t const len, struct ov_error *const err) {
+  size_t const total = call->payload ? OV_ARRAY_LENGTH(call->payload) : 0;
+  if (call->pos + len > total) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_fail);
+    return false;
+  }
+  memcpy(buf, call->payload + call->pos, len);
+  call->pos += len;
+  return true;
+}
+
+static bool call_read_int32(struct ipc_call *const call, int32_t *const v, struct ov_error *const err) {
+  return call_read(call, v, sizeof(*v), err);
+}
+
+static bool call_read_uint32(struct ipc_call *const call, uint32_t *const v, struct ov_error *const err) {
+  return call_read(call, v, sizeof(*v), err);
+}
+
+static bool call_read_uint64(struct ipc_call *const call, uint64_t *const v, struct ov_error *const err) {
+  return call_read(call, v, sizeof(*v), err);
+}
+
+static bool call_read_string(struct ipc_call *const call, char **const s, struct ov_error *const err) {
+  int32_t len = 0;
+  bool result = false;
+  if (!call_read_int32(call, &len, err)) {
+    goto cleanup;
+  }
+  if (len < 0) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_fail);
+    goto cleanup;
+  }
+  if (!OV_ARRAY_GROW(s, (size_t)len + 1)) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
+    goto cleanup;
+  }
+  if (len > 0) {
+    if (!call_read(call, *s, (size_t)len, err)) {
+      goto cleanup;
+    }
+  }
+  (*s)[len] = '\0';
+  OV_ARRAY_SET_LENGTH(*s, (size_t)len + 1);
+  result = true;
+cleanup:
+  return result;
+}
+
+static bool dup_array_string(char **const dest, char const *const src) {
+  size_t const len = OV_ARRAY_LENGTH(src);
+  if (!OV_ARRAY_GROW(dest, len)) {
+    return false;
+  }
+  memcpy(*dest, src, len);
+  OV_ARRAY_SET_LENGTH(*dest, len);
+  return true;
+}
+
+// Read the rest of a reply frame and hand it to the waiting call.
+//
+// Success: 0x80000000, id, uint32 payload length, payload
+// Failure: 0x80000000 | message length, id, message
+// A reply with id 0 fails every pending call.
+static bool read_reply(struct ipc *const self, uint32_t const header, struct ov_error *const err) {
+  uint32_t const len = header & 0x7fffffff;
+  uint32_t id = 0;
+  char *error_msg = NULL;
+  char *payload = NULL;
+  bool result = false;
+
+  if (!read_uint32(self->h_stdout, &id, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
+  if (len > 0) {
+    if (!OV_ARRAY_GROW(&error_msg, (size_t)len + 1)) {
+      OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
+      goto cleanup;
+    }
+    if (!read_all(self->h_stdout, error_msg, len, err)) {
+      OV_ERROR_ADD_TRACE(err);
+      goto cleanup;
+    }
+    error_msg[len] = '\0';
+    OV_ARRAY_SET_LENGTH(error_msg, (size_t)len + 1);
+  } else {
+    uint32_t payload_len = 0;
+    if (!read_uint32(self->h_stdout, &payload_len, err)) {
+      OV_ERROR_ADD_TRACE(err);
+      goto cleanup;
+    }
+    if (payload_len > 0) {
+      if (!OV_ARRAY_GROW(&payload, payload_len)) {
+        OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
+        goto cleanup;
+      }
+      if (!read_all(self->h_stdout, payload, payload_len, err)) {
+        OV_ERROR_ADD_TRACE(err);
+        goto cleanup;
+      }
+      OV_ARRAY_SET_LENGTH(payload, payload_len);
+    }
+  }
+
+  mtx_lock(&self->mtx_reply);
+  for (struct ipc_call *call = self->calls; call; call = call->next) {
+    if (call->done) {
+      continue;
+    }
+    if (id == 0) {
+      if (error_msg && !dup_array_string(&call->error, error_msg)) {
+        continue;
+      }
+      call->done = true;
+      continue;
+    }
+    if (call->id == id) {
+      call->error = error_msg;
+      call->payload = payload;
+      call->done = true;
+      error_msg = NULL;
+      payload = NULL;
+      break;
+    }
+  }
+  cnd_broadcast(&self->cnd_reply);
+  mtx_unlock(&self->mtx_reply);
+  result = true;
+
+cleanup:
+  if (error_msg) {
+    OV_ARRAY_DESTROY(&error_msg);
+  }
+  if (payload) {
+    OV_ARRAY_DESTROY(&payload);
+  }
+  return result;
+}
+
 static bool handle_request(struct ipc *const self, uint32_t cmd, struct ov_error *const err) {
   char *path = NULL;
   char *state = NULL;
@@ -280,31 +473,9 @@ static int read_thread(void *userdata) {
     }
 
     if (cmd & 0x80000000) {
-      uint32_t len = cmd & 0x7fffffff;
-      char *error_msg = NULL;
-      if (len > 0) {
-        if (!OV_ARRAY_GROW(&error_msg, (size_t)len + 1)) {
-          break;
-        }
-        if (!read_all(self->h_stdout, error_msg, len, &err)) {
-          if (error_msg) {
-            OV_ARRAY_DESTROY(&error_msg);
-          }
-          break;
-        }
-        error_msg[len] = '\0';
-        OV_ARRAY_SET_LENGTH(error_msg, (size_t)len + 1);
-      }
-      mtx_lock(&self->mtx_reply);
-      self->reply_received = true;
-      self->reply_value = cmd;
-      self->reply_error = error_msg;
-      self->reply_consumed = false;
-      cnd_signal(&self->cnd_reply);
-      while (!self->reply_consumed && !self->exit_requested) {
-        cnd_wait(&self->cnd_reply_consumed, &self->mtx_reply);
+      if (!read_reply(self, cmd, &err)) {
+        break;
       }
-      mtx_unlock(&self->mtx_reply);
     } else {
       if (!handle_request(self, cmd, &err)) {
         break;
@@ -326,27 +497,24 @@ static int read_thread(void *userdata) {
 
 static bool ipc_helo(struct ipc *const self, struct ov_error *const err) {
   uint32_t const cmd = FOURCC('H', 'E', 'L', 'O');
-  uint32_t reply = 0;
+  struct ipc_call call;
   bool result = false;
+  call_begin(self, &call);
   mtx_lock(&self->mtx_stdin);
-  if (!write_uint32(self->h_stdin, cmd, err)) {
+  if (!write_call_header(self, cmd, &call, err)) {
     mtx_unlock(&self->mtx_stdin);
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
   mtx_unlock(&self->mtx_stdin);
 
-  if (!wait_for_reply(self, &reply, err)) {
+  if (!call_wait(self, &call, err)) {
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
-  if (reply != 0x80000000) {
-    OV_ERROR_SET_GENERIC(err, ov_error_generic_fail);
-    goto cleanup;
-  }
   result = true;
 cleanup:
-  ipc_reply_consumed(self);
+  call_end(self, &call);
   return result;
 }
 
@@ -408,16 +576,24 @@ bool ipc_init(struct ipc **const ipc, struct ipc_options const *const opt, struc
     };
     PROCESS_INFORMATION pi = {0};
 
+    wchar_t args[32];
+    ov_snprintf_wchar(args,
+                      sizeof(args) / sizeof(args[0]),
+                      L"%1$d",
+                      L" -drawcache=%1$d",
+                      opt->draw_cache_size_mb > 0 ? opt->draw_cache_size_mb : 0);
+    size_t const args_len = wcslen(args);
     size_t const exe_path_len = wcslen(opt->exe_path);
-    if (!OV_ARRAY_GROW(&cmdline, exe_path_len + 3)) {
+    size_t const cmdline_len = exe_path_len + 2 + args_len;
+    if (!OV_ARRAY_GROW(&cmdline, cmdline_len + 1)) {
       OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
       goto cleanup;
     }
     cmdline[0] = L'\"';
     wcscpy(cmdline + 1, opt->exe_path);
     cmdline[exe_path_len + 1] = L'\"';
-    cmdline[exe_path_len + 2] = L'\0';
-    OV_ARRAY_SET_LENGTH(cmdline, exe_path_len + 3);
+    wcscpy(cmdline + exe_path_len + 2, args);
+    OV_ARRAY_SET_LENGTH(cmdline, cmdline_len);
 
     if (!CreateProcessW(opt->exe_path, cmdline, NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL, opt->working_dir, &si, &pi)) {
       HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
@@ -448,7 +624,6 @@ bool ipc_init(struct ipc **const ipc, struct ipc_options const *const opt, struc
   mtx_init(&self->mtx_stdin, mtx_plain);
   mtx_init(&self->mtx_reply, mtx_plain);
   cnd_init(&self->cnd_reply);
-  cnd_init(&self->cnd_reply_consumed);
 
   if (thrd_create(&self->thread, read_thread, self) != thrd_success) {
     OV_ERROR_SET_GENERIC(err, ov_error_generic_fail);
@@ -461,8 +636,6 @@ bool ipc_init(struct ipc **const ipc, struct ipc_options const *const opt, struc
     goto cleanup;
   }
 
-  // Shared memory will be opened on first DRAW when Go side creates it
-
   *ipc = self;
   result = true;
 
@@ -504,14 +677,6 @@ void ipc_exit(struct ipc **const ipc) {
   if (self->h_stdout != INVALID_HANDLE_VALUE) {
     CloseHandle(self->h_stdout);
   }
-  if (self->shm_view) {
-    UnmapViewOfFile(self->shm_view);
-    self->shm_view = NULL;
-  }
-  if (self->shm_handle) {
-    CloseHandle(self->shm_handle);
-    self->shm_handle = NULL;
-  }
   if (self->process != INVALID_HANDLE_VALUE) {
     WaitForSingleObject(self->process, 5000);
     TerminateProcess(self->process, 0);
@@ -520,19 +685,16 @@ void ipc_exit(struct ipc **const ipc) {
   mtx_destroy(&self->mtx_stdin);
   mtx_destroy(&self->mtx_reply);
   cnd_destroy(&self->cnd_reply);
-  cnd_destroy(&self->cnd_reply_consumed);
-  if (self->reply_error) {
-    OV_ARRAY_DESTROY(&self->reply_error);
-  }
   OV_FREE(ipc);
 }
 
 bool ipc_add_file(struct ipc *const self, char const *const path_utf8, uint32_t const tag, struct ov_error *const err) {
   uint32_t const cmd = FOURCC('A', 'D', 'D', 'F');
-  uint32_t reply = 0;
+  struct ipc_call call;
   bool result = false;
+  call_begin(self, &call);
   mtx_lock(&self->mtx_stdin);
-  if (!write_uint32(self->h_stdin, cmd, err) || !write_string(self->h_stdin, path_utf8, err) ||
+  if (!write_call_header(self, cmd, &call, err) || !write_string(self->h_stdin, path_utf8, err) ||
       !write_uint32(self->h_stdin, tag, err)) {
     mtx_unlock(&self->mtx_stdin);
     OV_ERROR_ADD_TRACE(err);
@@ -540,168 +702,183 @@ bool ipc_add_file(struct ipc *const self, char const *const path_utf8, uint32_t
   }
   mtx_unlock(&self->mtx_stdin);
 
-  if (!wait_for_reply(self, &reply, err)) {
+  if (!call_wait(self, &call, err)) {
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
   result = true;
 cleanup:
-  ipc_reply_consumed(self);
+  call_end(self, &call);
   return result;
 }
 
 bool ipc_update_current_project_path(struct ipc *const self, char const *const path_utf8, struct ov_error *const err) {
   uint32_t const cmd = FOURCC('U', 'P', 'D', 'P');
-  uint32_t reply = 0;
+  struct ipc_call call;
   bool result = false;
+  call_begin(self, &call);
   mtx_lock(&self->mtx_stdin);
-  if (!write_uint32(self->h_stdin, cmd, err) || !write_string(self->h_stdin, path_utf8, err)) {
+  if (!write_call_header(self, cmd, &call, err) || !write_string(self->h_stdin, path_utf8, err)) {
     mtx_unlock(&self->mtx_stdin);
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
   mtx_unlock(&self->mtx_stdin);
 
-  if (!wait_for_reply(self, &reply, err)) {
+  if (!call_wait(self, &call, err)) {
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
   result = true;
 cleanup:
-  ipc_reply_consumed(self);
+  call_end(self, &call);
   return result;
 }
 
 bool ipc_clear_files(struct ipc *const self, struct ov_error *const err) {
   uint32_t const cmd = FOURCC('C', 'L', 'R', 'F');
-  uint32_t reply = 0;
+  struct ipc_call call;
   bool result = false;
+  call_begin(self, &call);
   mtx_lock(&self->mtx_stdin);
-  if (!write_uint32(self->h_stdin, cmd, err)) {
+  if (!write_call_header(self, cmd, &call, err)) {
     mtx_unlock(&self->mtx_stdin);
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
   mtx_unlock(&self->mtx_stdin);
 
-  if (!wait_for_reply(self, &reply, err)) {
+  if (!call_wait(self, &call, err)) {
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
   result = true;
 cleanup:
-  ipc_reply_consumed(self);
+  call_end(self, &call);
   return result;
 }
 
 bool ipc_deserialize(struct ipc *const self, char const *const src_utf8, struct ov_error *const err) {
   uint32_t const cmd = FOURCC('D', 'S', 'L', 'Z');
-  uint32_t reply = 0;
+  struct ipc_call call;
   int32_t success = 0;
   bool result = false;
+  call_begin(self, &call);
   mtx_lock(&self->mtx_stdin);
-  if (!write_uint32(self->h_stdin, cmd, err) || !write_string(self->h_stdin, src_utf8, err)) {
+  if (!write_call_header(self, cmd, &call, err) || !write_string(self->h_stdin, src_utf8, err)) {
     mtx_unlock(&self->mtx_stdin);
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
   mtx_unlock(&self->mtx_stdin);
 
-  if (!wait_for_reply(self, &reply, err)) {
+  if (!call_wait(self, &call, err)) {
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
 
-  if (!read_int32(self->h_stdout, &success, err)) {
+  if (!call_read_int32(&call, &success, err)) {
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
   result = success != 0;
 cleanup:
-  ipc_reply_consumed(self);
+  call_end(self, &call);
   return result;
 }
 
 bool ipc_draw(struct ipc *const self,
               int32_t const id,
               char const *const path_utf8,
-              void *const p,
+              char const *const shm_name,
               int32_t const width,
               int32_t const height,
               struct ov_error *const err) {
   uint32_t const cmd = FOURCC('D', 'R', 'A', 'W');
-  uint32_t reply = 0;
+  struct ipc_call call;
   int32_t len = 0;
   bool result = false;
-  size_t const required_size = (size_t)width * (size_t)height * 4;
-  int32_t shm_resized = 0;
-
-  // Ensure shared memory is large enough
-  if (self->shm_size < required_size) {
-    // Close existing mapping if any
-    if (self->shm_view) {
-      UnmapViewOfFile(self->shm_view);
-      self->shm_view = NULL;
-    }
-    if (self->shm_handle) {
-      CloseHandle(self->shm_handle);
-      self->shm_handle = NULL;
-    }
-
-    // Create new shared memory with required size (round up to next MB)
-    size_t const new_size = ((required_size + 1024 * 1024 - 1) / (1024 * 1024)) * (1024 * 1024);
-    DWORD const pid = GetCurrentProcessId();
-    wchar_t shm_name[64];
-    wsprintfW(shm_name, L"Local\\PSDTKit_Pixel_%lu", pid);
-
-    self->shm_handle = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)new_size, shm_name);
-    if (!self->shm_handle) {
-      OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
-      goto cleanup;
-    }
-    self->shm_view = MapViewOfFile(self->shm_handle, FILE_MAP_ALL_ACCESS, 0, 0, new_size);
-    if (!self->shm_view) {
-      CloseHandle(self->shm_handle);
-      self->shm_handle = NULL;
-      OV_ERROR_SET_HRESULT(err, HRESULT_FROM_WIN32(GetLastError()));
-      goto cleanup;
-    }
-    self->shm_size = new_size;
-    shm_resized = 1;
-  }
 
+  call_begin(self, &call);
   mtx_lock(&self->mtx_stdin);
-  if (!write_uint32(self->h_stdin, cmd, err) || !write_int32(self->h_stdin, id, err) ||
+  if (!write_call_header(self, cmd, &call, err) || !write_int32(self->h_stdin, id, err) ||
       !write_string(self->h_stdin, path_utf8, err) || !write_int32(self->h_stdin, width, err) ||
-      !write_int32(self->h_stdin, height, err) || !write_int32(self->h_stdin, shm_resized, err)) {
+      !write_int32(self->h_stdin, height, err) || !write_string(self->h_stdin, shm_name, err)) {
     mtx_unlock(&self->mtx_stdin);
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
   mtx_unlock(&self->mtx_stdin);
 
-  if (!wait_for_reply(self, &reply, err)) {
+  if (!call_wait(self, &call, err)) {
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
+  call_record(self, &call, &self->stats.draw);
 
-  if (!read_int32(self->h_stdout, &len, err)) {
+  // Pixels were written directly into the shared memory; only the length is returned
+  if (!call_read_int32(&call, &len, err)) {
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
-  if (len > width * height * 4) {
+  if (len != width * height * 4) {
     OV_ERROR_SET_GENERIC(err, ov_error_generic_fail);
     goto cleanup;
   }
 
-  if (len > 0) {
-    // Copy from shared memory
-    memcpy(p, self->shm_view, (size_t)len);
+  result = true;
+cleanup:
+  call_end(self, &call);
+  return result;
+}
+
+bool ipc_draw_batch(struct ipc *const self,
+                    struct ipc_draw_batch_item const *const items,
+                    size_t const n,
+                    struct ov_error *const err) {
+  uint32_t const cmd = FOURCC('D', 'R', 'W', 'B');
+  struct ipc_call call;
+  bool result = false;
+
+  call_begin(self, &call);
+  mtx_lock(&self->mtx_stdin);
+  if (!write_call_header(self, cmd, &call, err) || !write_int32(self->h_stdin, (int32_t)n, err)) {
+    mtx_unlock(&self->mtx_stdin);
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    if (!write_int32(self->h_stdin, items[i].id, err) || !write_string(self->h_stdin, items[i].path_utf8, err) ||
+        !write_int32(self->h_stdin, items[i].width, err) || !write_int32(self->h_stdin, items[i].height, err) ||
+        !write_string(self->h_stdin, items[i].shm_name, err)) {
+      mtx_unlock(&self->mtx_stdin);
+      OV_ERROR_ADD_TRACE(err);
+      goto cleanup;
+    }
+  }
+  mtx_unlock(&self->mtx_stdin);
+
+  if (!call_wait(self, &call, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
+  call_record(self, &call, &self->stats.draw_batch);
+
+  for (size_t i = 0; i < n; ++i) {
+    int32_t len = 0;
+    if (!call_read_int32(&call, &len, err)) {
+      OV_ERROR_ADD_TRACE(err);
+      goto cleanup;
+    }
+    if (len != items[i].width * items[i].height * 4) {
+      OV_ERROR_SET_GENERIC(err, ov_error_generic_fail);
+      goto cleanup;
+    }
   }
 
   result = true;
 cleanup:
-  ipc_reply_consumed(self);
+  call_end(self, &call);
   return result;
 }
 
@@ -711,10 +888,11 @@ bool ipc_get_layer_names(struct ipc *const self,
                          char **const dest_utf8,
                          struct ov_error *const err) {
   uint32_t const cmd = FOURCC('L', 'N', 'A', 'M');
-  uint32_t reply = 0;
+  struct ipc_call call;
   bool result = false;
+  call_begin(self, &call);
   mtx_lock(&self->mtx_stdin);
-  if (!write_uint32(self->h_stdin, cmd, err) || !write_int32(self->h_stdin, id, err) ||
+  if (!write_call_header(self, cmd, &call, err) || !write_int32(self->h_stdin, id, err) ||
       !write_string(self->h_stdin, path_utf8, err)) {
     mtx_unlock(&self->mtx_stdin);
     OV_ERROR_ADD_TRACE(err);
@@ -722,180 +900,258 @@ bool ipc_get_layer_names(struct ipc *const self,
   }
   mtx_unlock(&self->mtx_stdin);
 
-  if (!wait_for_reply(self, &reply, err)) {
+  if (!call_wait(self, &call, err)) {
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
+  call_record(self, &call, &self->stats.layer_names);
 
-  if (!read_string(self->h_stdout, dest_utf8, err)) {
+  if (!call_read_string(&call, dest_utf8, err)) {
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
   result = true;
 cleanup:
-  ipc_reply_consumed(self);
+  call_end(self, &call);
   return result;
 }
 
 bool ipc_serialize(struct ipc *const self, char **const dest_utf8, struct ov_error *const err) {
   uint32_t const cmd = FOURCC('S', 'R', 'L', 'Z');
-  uint32_t reply = 0;
+  struct ipc_call call;
   bool result = false;
+  call_begin(self, &call);
   mtx_lock(&self->mtx_stdin);
-  if (!write_uint32(self->h_stdin, cmd, err)) {
+  if (!write_call_header(self, cmd, &call, err)) {
     mtx_unlock(&self->mtx_stdin);
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
   mtx_unlock(&self->mtx_stdin);
 
-  if (!wait_for_reply(self, &reply, err)) {
+  if (!call_wait(self, &call, err)) {
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
 
-  if (!read_string(self->h_stdout, dest_utf8, err)) {
+  if (!call_read_string(&call, dest_utf8, err)) {
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
   result = true;
 cleanup:
-  ipc_reply_consumed(self);
+  call_end(self, &call);
   return result;
 }
 
-bool ipc_set_props(struct ipc *const self,
-                   int32_t const id,
-                   char const *const path_utf8,
-                   struct ipc_prop_params const *const params,
-                   struct ipc_prop_result *const result,
-                   struct ov_error *const err) {
-  uint32_t const cmd = FOURCC('P', 'R', 'O', 'P');
-  uint32_t reply = 0;
-  int32_t modified = 0;
-  bool res = false;
-  mtx_lock(&self->mtx_stdin);
-  if (!write_uint32(self->h_stdin, cmd, err) || !write_int32(self->h_stdin, id, err) ||
-      !write_string(self->h_stdin, path_utf8, err)) {
-    mtx_unlock(&self->mtx_stdin);
-    OV_ERROR_ADD_TRACE(err);
-    goto cleanup;
-  }
-
+// Writes tagged property fields followed by propEnd. Caller must hold mtx_stdin.
+static bool write_props(struct ipc *const self, struct ipc_prop_params const *const params, struct ov_error *const err) {
   if (params->layer) {
     if (!write_int32(self->h_stdin, 1, err) || !write_string(self->h_stdin, params->layer, err)) {
-      mtx_unlock(&self->mtx_stdin);
       OV_ERROR_ADD_TRACE(err);
-      goto cleanup;
+      return false;
     }
   }
   if (params->scale) {
     if (!write_int32(self->h_stdin, 2, err) || !write_float32(self->h_stdin, *params->scale, err)) {
-      mtx_unlock(&self->mtx_stdin);
       OV_ERROR_ADD_TRACE(err);
-      goto cleanup;
+      return false;
     }
   }
   if (params->offset_x) {
     if (!write_int32(self->h_stdin, 3, err) || !write_int32(self->h_stdin, *params->offset_x, err)) {
-      mtx_unlock(&self->mtx_stdin);
       OV_ERROR_ADD_TRACE(err);
-      goto cleanup;
+      return false;
     }
   }
   if (params->offset_y) {
     if (!write_int32(self->h_stdin, 4, err) || !write_int32(self->h_stdin, *params->offset_y, err)) {
-      mtx_unlock(&self->mtx_stdin);
       OV_ERROR_ADD_TRACE(err);
-      goto cleanup;
+      return false;
     }
   }
   if (params->tag) {
     if (!write_int32(self->h_stdin, 5, err) || !write_uint32(self->h_stdin, *params->tag, err)) {
-      mtx_unlock(&self->mtx_stdin);
       OV_ERROR_ADD_TRACE(err);
-      goto cleanup;
+      return false;
     }
   }
   if (params->quality) {
     if (!write_int32(self->h_stdin, 6, err) || !write_int32(self->h_stdin, *params->quality, err)) {
-      mtx_unlock(&self->mtx_stdin);
       OV_ERROR_ADD_TRACE(err);
-      goto cleanup;
+      return false;
     }
   }
   if (!write_int32(self->h_stdin, 0, err)) { // propEnd
-    mtx_unlock(&self->mtx_stdin);
     OV_ERROR_ADD_TRACE(err);
-    goto cleanup;
+    return false;
   }
-  mtx_unlock(&self->mtx_stdin);
+  return true;
+}
 
-  if (!wait_for_reply(self, &reply, err)) {
+static bool
+call_read_prop_result(struct ipc_call *const call, struct ipc_prop_result *const result, struct ov_error *const err) {
+  int32_t modified = 0, flip_x = 0, flip_y = 0;
+  if (!call_read_int32(call, &modified, err) || !call_read_uint64(call, &result->ckey, err) ||
+      !call_read_uint32(call, (uint32_t *)&result->width, err) ||
+      !call_read_uint32(call, (uint32_t *)&result->height, err) || !call_read_int32(call, &flip_x, err) ||
+      !call_read_int32(call, &flip_y, err)) {
     OV_ERROR_ADD_TRACE(err);
-    goto cleanup;
+    return false;
   }
+  result->modified = modified != 0;
+  result->flip_x = flip_x != 0;
+  result->flip_y = flip_y != 0;
+  return true;
+}
 
-  if (!read_int32(self->h_stdout, &modified, err)) {
+bool ipc_set_props(struct ipc *const self,
+                   int32_t const id,
+                   char const *const path_utf8,
+                   struct ipc_prop_params const *const params,
+                   struct ipc_prop_result *const result,
+                   struct ov_error *const err) {
+  uint32_t const cmd = FOURCC('P', 'R', 'O', 'P');
+  struct ipc_call call;
+  bool res = false;
+  call_begin(self, &call);
+  mtx_lock(&self->mtx_stdin);
+  if (!write_call_header(self, cmd, &call, err) || !write_int32(self->h_stdin, id, err) ||
+      !write_string(self->h_stdin, path_utf8, err) || !write_props(self, params, err)) {
+    mtx_unlock(&self->mtx_stdin);
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
-  result->modified = modified != 0;
-  if (!read_uint64(self->h_stdout, &result->ckey, err)) {
+  mtx_unlock(&self->mtx_stdin);
+
+  if (!call_wait(self, &call, err)) {
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
-  if (!read_uint32(self->h_stdout, (uint32_t *)&result->width, err)) {
+  call_record(self, &call, &self->stats.prop);
+
+  if (!call_read_prop_result(&call, result, err)) {
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
-  if (!read_uint32(self->h_stdout, (uint32_t *)&result->height, err)) {
+  res = true;
+cleanup:
+  call_end(self, &call);
+  return res;
+}
+
+bool ipc_set_props_batch(struct ipc *const self,
+                         struct ipc_prop_batch_item *const items,
+                         size_t const n,
+                         struct ov_error *const err) {
+  uint32_t const cmd = FOURCC('P', 'R', 'P', 'B');
+  struct ipc_call call;
+  bool res = false;
+  call_begin(self, &call);
+  mtx_lock(&self->mtx_stdin);
+  if (!write_call_header(self, cmd, &call, err) || !write_int32(self->h_stdin, (int32_t)n, err)) {
+    mtx_unlock(&self->mtx_stdin);
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
-  {
-    int32_t flip_x = 0, flip_y = 0;
-    if (!read_int32(self->h_stdout, &flip_x, err)) {
+  for (size_t i = 0; i < n; ++i) {
+    if (!write_int32(self->h_stdin, items[i].id, err) || !write_string(self->h_stdin, items[i].path_utf8, err) ||
+        !write_props(self, &items[i].params, err)) {
+      mtx_unlock(&self->mtx_stdin);
       OV_ERROR_ADD_TRACE(err);
       goto cleanup;
     }
-    if (!read_int32(self->h_stdout, &flip_y, err)) {
+  }
+  mtx_unlock(&self->mtx_stdin);
+
+  if (!call_wait(self, &call, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
+  call_record(self, &call, &self->stats.prop_batch);
+
+  for (size_t i = 0; i < n; ++i) {
+    if (!call_read_prop_result(&call, &items[i].result, err)) {
       OV_ERROR_ADD_TRACE(err);
       goto cleanup;
     }
-    result->flip_x = flip_x != 0;
-    result->flip_y = flip_y != 0;
   }
   res = true;
 cleanup:
-  ipc_reply_consumed(self);
+  call_end(self, &call);
   return res;
 }
 
 HWND ipc_get_window_handle(struct ipc *const self, struct ov_error *const err) {
   uint32_t const cmd = FOURCC('G', 'W', 'N', 'D');
-  uint32_t reply = 0;
+  struct ipc_call call;
   uint64_t h = 0;
   bool success = false;
+  call_begin(self, &call);
   mtx_lock(&self->mtx_stdin);
-  if (!write_uint32(self->h_stdin, cmd, err)) {
+  if (!write_call_header(self, cmd, &call, err)) {
     mtx_unlock(&self->mtx_stdin);
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
   mtx_unlock(&self->mtx_stdin);
 
-  if (!wait_for_reply(self, &reply, err)) {
+  if (!call_wait(self, &call, err)) {
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
 
-  if (!read_uint64(self->h_stdout, &h, err)) {
+  if (!call_read_uint64(&call, &h, err)) {
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
   }
   success = true;
 cleanup:
-  ipc_reply_consumed(self);
+  call_end(self, &call);
   return success ? (HWND)(uintptr_t)h : NULL;
 }
+
+void ipc_get_stats(struct ipc *const self, struct ipc_stats *const stats) {
+  if (!stats) {
+    return;
+  }
+  if (!self) {
+    *stats = (struct ipc_stats){0};
+    return;
+  }
+  mtx_lock(&self->mtx_reply);
+  *stats = self->stats;
+  mtx_unlock(&self->mtx_reply);
+}
+
+bool ipc_get_draw_cache_stats(struct ipc *const self,
+                              struct ipc_draw_cache_stats *const stats,
+                              struct ov_error *const err) {
+  uint32_t const cmd = FOURCC('S', 'T', 'A', 'T');
+  struct ipc_call call;
+  bool result = false;
+  call_begin(self, &call);
+  mtx_lock(&self->mtx_stdin);
+  if (!write_call_header(self, cmd, &call, err)) {
+    mtx_unlock(&self->mtx_stdin);
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
+  mtx_unlock(&self->mtx_stdin);
+
+  if (!call_wait(self, &call, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
+
+  if (!call_read_uint64(&call, &stats->hits, err) || !call_read_uint64(&call, &stats->misses, err) ||
+      !call_read_uint64(&call, &stats->evictions, err) || !call_read_uint64(&call, &stats->entries, err) ||
+      !call_read_uint64(&call, &stats->bytes, err) || !call_read_uint64(&call, &stats->limit, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
+  result = true;
+cleanup:
+  call_end(self, &call);
+  return result;
+}
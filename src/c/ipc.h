@@ -56,6 +56,7 @@ struct ipc_export_layer_names_params {
 struct ipc_options {
   wchar_t const *exe_path;
   wchar_t const *working_dir;
+  int draw_cache_size_mb; // passed to PSDToolKit.exe as -drawcache
   void *userdata;
   void (*on_update_editing_image_state)(void *const userdata,
                                         struct ipc_update_editing_image_state_params *const params);
@@ -72,13 +73,38 @@ NODISCARD bool
 ipc_update_current_project_path(struct ipc *const ipc, char const *const path_utf8, struct ov_error *const err);
 NODISCARD bool ipc_clear_files(struct ipc *const ipc, struct ov_error *const err);
 NODISCARD bool ipc_deserialize(struct ipc *const ipc, char const *const src_utf8, struct ov_error *const err);
+/**
+ * @brief Render an image into a named shared memory block
+ *
+ * The renderer opens the shared memory by name and writes width * height * 4 bytes
+ * of bottom-up BGRA pixels, ready to be used as a DIB without further conversion.
+ */
 NODISCARD bool ipc_draw(struct ipc *const ipc,
                         int32_t const id,
                         char const *const path_utf8,
-                        void *const p,
+                        char const *const shm_name,
                         int32_t const width,
                         int32_t const height,
                         struct ov_error *const err);
+
+struct ipc_draw_batch_item {
+  int32_t id;
+  char const *path_utf8;
+  char const *shm_name;
+  int32_t width;
+  int32_t height;
+};
+
+/**
+ * @brief Render several images in one round trip
+ *
+ * Same as ipc_draw for each item, but the renderer processes the items in parallel
+ * and replies once all of them have been written.
+ */
+NODISCARD bool ipc_draw_batch(struct ipc *const ipc,
+                              struct ipc_draw_batch_item const *const items,
+                              size_t const n,
+                              struct ov_error *const err);
 NODISCARD bool ipc_get_layer_names(struct ipc *const ipc,
                                    int32_t const id,
                                    char const *const path_utf8,
@@ -111,3 +137,62 @@ NODISCARD bool ipc_set_props(struct ipc *const ipc,
                              struct ipc_prop_params const *const params,
                              struct ipc_prop_result *const result,
                              struct ov_error *const err);
+
+struct ipc_prop_batch_item {
+  int32_t id;
+  char const *path_utf8;
+  struct ipc_prop_params params;
+  struct ipc_prop_result result;
+};
+
+/**
+ * @brief Set properties for several objects in one round trip
+ *
+ * Each item's result is filled in on success.
+ */
+NODISCARD bool ipc_set_props_batch(struct ipc *const ipc,
+                                   struct ipc_prop_batch_item *const items,
+                                   size_t const n,
+                                   struct ov_error *const err);
+
+/**
+ * @brief Round trip latency of one request type
+ */
+struct ipc_latency {
+  uint64_t count;
+  uint64_t total_usec;
+  uint64_t max_usec;
+};
+
+/**
+ * @brief Round trip latencies from sending a request to reading its reply
+ *
+ * Batched requests are counted once per round trip.
+ */
+struct ipc_stats {
+  struct ipc_latency prop;        // PROP
+  struct ipc_latency prop_batch;  // PRPB
+  struct ipc_latency draw;        // DRAW
+  struct ipc_latency draw_batch;  // DRWB
+  struct ipc_latency layer_names; // LNAM
+};
+
+/**
+ * @brief Get a snapshot of the round trip latencies measured so far
+ */
+void ipc_get_stats(struct ipc *const ipc, struct ipc_stats *const stats);
+
+/**
+ * @brief Counters of the rendered frame cache in the renderer process
+ */
+struct ipc_draw_cache_stats {
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  uint64_t entries;
+  uint64_t bytes;
+  uint64_t limit; // 0 when the cache is disabled
+};
+
+NODISCARD bool
+ipc_get_draw_cache_stats(struct ipc *const ipc, struct ipc_draw_cache_stats *const stats, struct ov_error *const err);
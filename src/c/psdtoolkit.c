@@ -162,51 +162,235 @@ static bool sm_draw(void *const userdata,
     return false;
   }
 
-  uint8_t *pixels = NULL;
+  struct ptk_cache_slot *slot = NULL;
   bool success = false;
 
-  {
-    // Allocate buffer for pixel data
-    size_t const data_size = (size_t)width * (size_t)height * 4;
-    if (!OV_REALLOC(&pixels, data_size, 1)) {
-      OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
-      goto cleanup;
-    }
+  // Render straight into a cache slot; the renderer writes bottom-up BGRA
+  // so the slot can be adopted by the cache as-is.
+  slot = ptk_cache_slot_create(ptk->cache, width, height, err);
+  if (!slot) {
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
 
-    // Call IPC to render
-    if (!ipc_draw(ptk->ipc, id, path_utf8, pixels, width, height, err)) {
-      OV_ERROR_ADD_TRACE(err);
-      goto cleanup;
-    }
+  if (!ipc_draw(ptk->ipc, id, path_utf8, ptk_cache_slot_get_name(slot), width, height, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
+
+  if (!ptk_cache_put_slot(ptk->cache, ckey, &slot, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
+
+  success = true;
+
+cleanup:
+  ptk_cache_slot_destroy(&slot);
+  return success;
+}
 
-    // Flip vertically (top-down to bottom-up for BITMAP)
-    size_t const stride = (size_t)width * 4;
-    for (int y = 0; y < height / 2; y++) {
-      uint8_t *top = pixels + (size_t)y * stride;
-      uint8_t *bottom = pixels + (size_t)(height - 1 - y) * stride;
-      for (size_t x = 0; x < stride; x++) {
-        uint8_t tmp = top[x];
-        top[x] = bottom[x];
-        bottom[x] = tmp;
+// Backing storage for the optional fields referenced by ipc_prop_params
+struct prop_values {
+  float scale;
+  int32_t offset_x;
+  int32_t offset_y;
+  uint32_t tag;
+  int32_t quality;
+};
+
+static bool sm_draw_batch(void *const userdata,
+                          struct ptk_script_module_draw_batch_item *const items,
+                          size_t const n,
+                          int32_t const max_width,
+                          int32_t const max_height,
+                          struct ov_error *const err) {
+  struct psdtoolkit *const ptk = (struct psdtoolkit *)userdata;
+  if (!ptk || !ptk->ipc || !ptk->cache || !items) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_invalid_argument);
+    return false;
+  }
+
+  struct ipc_prop_batch_item *prop_items = NULL;
+  struct prop_values *values = NULL;
+  struct ipc_draw_batch_item *draw_items = NULL;
+  struct ptk_cache_slot **slots = NULL;
+  uint64_t *draw_ckeys = NULL;
+  size_t num_draws = 0;
+  bool success = false;
+
+  if (!OV_ARRAY_GROW(&prop_items, n) || !OV_ARRAY_GROW(&values, n) || !OV_ARRAY_GROW(&draw_items, n) ||
+      !OV_ARRAY_GROW(&slots, n) || !OV_ARRAY_GROW(&draw_ckeys, n)) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_out_of_memory);
+    goto cleanup;
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    struct ptk_script_module_set_props_params const *const params = &items[i].params;
+    slots[i] = NULL;
+    values[i] = (struct prop_values){
+        .scale = (float)params->scale,
+        .offset_x = params->offset_x,
+        .offset_y = params->offset_y,
+        .tag = (uint32_t)params->tag,
+        .quality = params->quality,
+    };
+    prop_items[i] = (struct ipc_prop_batch_item){
+        .id = params->id,
+        .path_utf8 = params->path_utf8,
+        .params =
+            {
+                .layer = params->layer,
+                .scale = &values[i].scale,
+                .offset_x = &values[i].offset_x,
+                .offset_y = &values[i].offset_y,
+                .tag = &values[i].tag,
+                .quality = &values[i].quality,
+            },
+    };
+  }
+
+  if (!ipc_set_props_batch(ptk->ipc, prop_items, n, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
+
+  for (size_t i = 0; i < n; ++i) {
+    struct ipc_prop_result const *const r = &prop_items[i].result;
+    struct ptk_script_module_set_props_result *const result = &items[i].result;
+    result->modified = r->modified;
+    result->ckey = r->ckey;
+    result->width = r->width < max_width ? r->width : max_width;
+    result->height = r->height < max_height ? r->height : max_height;
+    result->flip_x = r->flip_x;
+    result->flip_y = r->flip_y;
+    if (result->width <= 0 || result->height <= 0 || ptk_cache_contains(ptk->cache, result->ckey)) {
+      continue;
+    }
+    // Several objects may share the same image, render it only once
+    bool queued = false;
+    for (size_t j = 0; j < num_draws; ++j) {
+      if (draw_ckeys[j] == result->ckey) {
+        queued = true;
+        break;
       }
     }
-
-    // Store in cache
-    if (!ptk_cache_put(ptk->cache, ckey, pixels, width, height, err)) {
+    if (queued) {
+      continue;
+    }
+    slots[num_draws] = ptk_cache_slot_create(ptk->cache, result->width, result->height, err);
+    if (!slots[num_draws]) {
       OV_ERROR_ADD_TRACE(err);
       goto cleanup;
     }
+    draw_items[num_draws] = (struct ipc_draw_batch_item){
+        .id = items[i].params.id,
+        .path_utf8 = items[i].params.path_utf8,
+        .shm_name = ptk_cache_slot_get_name(slots[num_draws]),
+        .width = result->width,
+        .height = result->height,
+    };
+    draw_ckeys[num_draws] = result->ckey;
+    ++num_draws;
+  }
+
+  if (num_draws > 0) {
+    if (!ipc_draw_batch(ptk->ipc, draw_items, num_draws, err)) {
+      OV_ERROR_ADD_TRACE(err);
+      goto cleanup;
+    }
+    for (size_t i = 0; i < num_draws; ++i) {
+      if (!ptk_cache_put_slot(ptk->cache, draw_ckeys[i], &slots[i], err)) {
+        OV_ERROR_ADD_TRACE(err);
+        goto cleanup;
+      }
+    }
   }
 
   success = true;
 
 cleanup:
-  if (pixels) {
-    OV_FREE(&pixels);
+  if (slots) {
+    for (size_t i = 0; i < num_draws; ++i) {
+      ptk_cache_slot_destroy(&slots[i]);
+    }
+    OV_ARRAY_DESTROY(&slots);
+  }
+  if (draw_ckeys) {
+    OV_ARRAY_DESTROY(&draw_ckeys);
+  }
+  if (draw_items) {
+    OV_ARRAY_DESTROY(&draw_items);
+  }
+  if (values) {
+    OV_ARRAY_DESTROY(&values);
+  }
+  if (prop_items) {
+    OV_ARRAY_DESTROY(&prop_items);
   }
   return success;
 }
 
+static void copy_latency(struct ptk_script_module_latency *const dst, struct ipc_latency const *const src) {
+  dst->count = src->count;
+  dst->total_usec = src->total_usec;
+  dst->max_usec = src->max_usec;
+}
+
+static bool sm_get_cache_stats(void *const userdata,
+                               struct ptk_script_module_cache_stats *const stats,
+                               struct ov_error *const err) {
+  struct psdtoolkit *const ptk = (struct psdtoolkit *)userdata;
+  if (!ptk || !ptk->ipc || !ptk->cache || !stats) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_invalid_argument);
+    return false;
+  }
+
+  struct ptk_cache_stats cs = {0};
+  ptk_cache_get_stats(ptk->cache, &cs);
+  stats->memory_hits = cs.memory_hits;
+  stats->file_hits = cs.file_hits;
+  stats->persistent_hits = cs.persistent_hits;
+  stats->misses = cs.misses;
+  stats->contains_hits = cs.contains_hits;
+  stats->contains_misses = cs.contains_misses;
+  stats->bytes_in = cs.bytes_in;
+  stats->bytes_out = cs.bytes_out;
+  stats->memory_evictions = cs.memory_evictions;
+  stats->file_evictions = cs.file_evictions;
+  stats->persistent_evictions = cs.persistent_evictions;
+  stats->file_reads = cs.file_reads;
+  stats->file_read_usec = cs.file_read_usec;
+  stats->file_read_max_usec = cs.file_read_max_usec;
+  stats->memory_used = cs.memory_used;
+  stats->memory_limit = cs.memory_limit;
+  stats->file_used = cs.file_used;
+  stats->file_limit = cs.file_limit;
+  stats->persistent_used = cs.persistent_used;
+  stats->persistent_limit = cs.persistent_limit;
+
+  struct ipc_draw_cache_stats ds = {0};
+  if (!ipc_get_draw_cache_stats(ptk->ipc, &ds, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    return false;
+  }
+  stats->draw_cache_hits = ds.hits;
+  stats->draw_cache_misses = ds.misses;
+  stats->draw_cache_evictions = ds.evictions;
+  stats->draw_cache_entries = ds.entries;
+  stats->draw_cache_bytes = ds.bytes;
+  stats->draw_cache_limit = ds.limit;
+
+  struct ipc_stats is = {0};
+  ipc_get_stats(ptk->ipc, &is);
+  copy_latency(&stats->prop, &is.prop);
+  copy_latency(&stats->prop_batch, &is.prop_batch);
+  copy_latency(&stats->draw, &is.draw);
+  copy_latency(&stats->draw_batch, &is.draw_batch);
+  copy_latency(&stats->layer_names, &is.layer_names);
+  return true;
+}
+
 struct ptk_script_module *psdtoolkit_get_script_module(struct psdtoolkit *const ptk) {
   return ptk ? ptk->script_module : NULL;
 }
@@ -427,6 +611,50 @@ cleanup:
   OV_ERROR_REPORT(&err, NULL);
 }
 
+// Apply the render cache budgets, policy and persistent tier from the config, failures are only logged
+static void apply_cache_config(struct psdtoolkit *const ptk) {
+  struct ov_error err = {0};
+  bool enabled = false;
+  int size_mb = 0;
+  int memory_mb = 0;
+  int file_mb = 0;
+  int policy = 0;
+  bool success = false;
+
+  if (!ptk_config_get_memory_cache_size(ptk->config, &memory_mb, &err) ||
+      !ptk_config_get_file_cache_size(ptk->config, &file_mb, &err) ||
+      !ptk_config_get_cache_policy(ptk->config, &policy, &err)) {
+    OV_ERROR_ADD_TRACE(&err);
+    ptk_logf_warn(&err, "%s", "%s", gettext("failed to read the cache settings."));
+    OV_ERROR_REPORT(&err, NULL);
+  } else {
+    ptk_cache_set_policy(ptk->cache, policy == ptk_cache_policy_2q ? ptk_cache_policy_2q : ptk_cache_policy_lru);
+    ptk_cache_set_limits(ptk->cache, (size_t)memory_mb * 1024 * 1024, (size_t)file_mb * 1024 * 1024);
+  }
+
+  if (!ptk_config_get_persistent_cache(ptk->config, &enabled, &err) ||
+      !ptk_config_get_persistent_cache_size(ptk->config, &size_mb, &err)) {
+    OV_ERROR_ADD_TRACE(&err);
+    goto cleanup;
+  }
+  if (!enabled) {
+    ptk_cache_disable_persistent(ptk->cache);
+    success = true;
+    goto cleanup;
+  }
+  if (!ptk_cache_enable_persistent(ptk->cache, NULL, (uint64_t)size_mb * 1024 * 1024, &err)) {
+    OV_ERROR_ADD_TRACE(&err);
+    goto cleanup;
+  }
+  success = true;
+
+cleanup:
+  if (!success) {
+    ptk_logf_warn(&err, "%s", "%s", gettext("failed to enable the persistent cache, continuing without it."));
+    OV_ERROR_REPORT(&err, NULL);
+  }
+}
+
 void psdtoolkit_show_config_dialog(struct psdtoolkit *const ptk, void *const hwnd) {
   if (!ptk) {
     return;
@@ -437,6 +665,7 @@ void psdtoolkit_show_config_dialog(struct psdtoolkit *const ptk, void *const hwn
     OV_ERROR_ADD_TRACE(&err);
     goto cleanup;
   }
+  apply_cache_config(ptk);
   success = true;
 cleanup:
   if (!success) {
@@ -1024,8 +1253,13 @@ cleanup:
 static bool initialize_ipc(HINSTANCE const hinst, struct psdtoolkit *const ptk, struct ov_error *const err) {
   wchar_t *exe_path = NULL;
   wchar_t *working_dir = NULL;
+  int draw_cache_mb = 0;
   bool result = false;
 
+  if (!ptk_config_get_draw_cache_size(ptk->config, &draw_cache_mb, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    goto cleanup;
+  }
   if (!ovl_path_get_module_name(&exe_path, hinst, err)) {
     OV_ERROR_ADD_TRACE(err);
     goto cleanup;
@@ -1071,6 +1305,7 @@ static bool initialize_ipc(HINSTANCE const hinst, struct psdtoolkit *const ptk,
                 &(struct ipc_options){
                     .exe_path = exe_path,
                     .working_dir = working_dir,
+                    .draw_cache_size_mb = draw_cache_mb,
                     .userdata = ptk,
                     .on_update_editing_image_state = ipc_on_update_editing_image_state,
                     .on_export_faview_slider = ipc_on_export_faview_slider,
@@ -1195,6 +1430,7 @@ NODISCARD struct psdtoolkit *psdtoolkit_create(struct ptk_cache *const cache, st
       ptk_logf_warn(err, "%s", "%s", gettext("failed to load config, continuing with default settings."));
       OV_ERROR_DESTROY(err);
     }
+    apply_cache_config(ptk);
 
     void *dll_hinst = NULL;
     if (!ovl_os_get_hinstance_from_fnptr((void *)psdtoolkit_create, &dll_hinst, NULL)) {
@@ -1214,6 +1450,8 @@ NODISCARD struct psdtoolkit *psdtoolkit_create(struct ptk_cache *const cache, st
             .set_props = sm_set_props,
             .get_drop_config = sm_get_drop_config,
             .draw = sm_draw,
+            .draw_batch = sm_draw_batch,
+            .get_cache_stats = sm_get_cache_stats,
         },
         err);
     if (!ptk->script_module) {
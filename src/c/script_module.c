@@ -12,6 +12,8 @@
 
 #include <aviutl2_module2.h>
 
+#include <limits.h>
+
 #include "error.h"
 #include "logf.h"
 
@@ -282,6 +284,232 @@ cleanup:
   }
 }
 
+static int clamp_int(uint64_t const v) { return v > INT_MAX ? INT_MAX : (int)v; }
+
+static uint64_t average(uint64_t const total, uint64_t const count) { return count ? total / count : 0; }
+
+static bool get_cache_stats(struct ptk_script_module *const sm,
+                            struct ptk_script_module_cache_stats *const stats,
+                            struct ov_error *const err) {
+  if (!sm->callbacks.get_cache_stats) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_not_implemented_yet);
+    return false;
+  }
+  *stats = (struct ptk_script_module_cache_stats){0};
+  if (!sm->callbacks.get_cache_stats(sm->callbacks.userdata, stats, err)) {
+    OV_ERROR_ADD_TRACE(err);
+    return false;
+  }
+  return true;
+}
+
+void ptk_script_module_get_cache_stats(struct ptk_script_module *const sm,
+                                       struct aviutl2_script_module_param *const param) {
+  struct ov_error err = {0};
+  bool success = false;
+
+  if (!sm || !param) {
+    OV_ERROR_SET_GENERIC(&err, ov_error_generic_invalid_argument);
+    goto cleanup;
+  }
+
+  {
+    struct ptk_script_module_cache_stats st;
+    if (!get_cache_stats(sm, &st, &err)) {
+      OV_ERROR_ADD_TRACE(&err);
+      goto cleanup;
+    }
+
+    char const *keys[] = {
+        "memory_hits",
+        "file_hits",
+        "persistent_hits",
+        "misses",
+        "contains_hits",
+        "contains_misses",
+        "bytes_in_kib",
+        "bytes_out_kib",
+        "memory_evictions",
+        "file_evictions",
+        "persistent_evictions",
+        "file_reads",
+        "file_read_avg_usec",
+        "file_read_max_usec",
+        "memory_used_kib",
+        "memory_limit_kib",
+        "file_used_kib",
+        "file_limit_kib",
+        "persistent_used_kib",
+        "persistent_limit_kib",
+        "draw_cache_hits",
+        "draw_cache_misses",
+        "draw_cache_evictions",
+        "draw_cache_entries",
+        "draw_cache_kib",
+        "draw_cache_limit_kib",
+        "ipc_prop_count",
+        "ipc_prop_avg_usec",
+        "ipc_prop_max_usec",
+        "ipc_prop_batch_count",
+        "ipc_prop_batch_avg_usec",
+        "ipc_prop_batch_max_usec",
+        "ipc_draw_count",
+        "ipc_draw_avg_usec",
+        "ipc_draw_max_usec",
+        "ipc_draw_batch_count",
+        "ipc_draw_batch_avg_usec",
+        "ipc_draw_batch_max_usec",
+        "ipc_layer_names_count",
+        "ipc_layer_names_avg_usec",
+        "ipc_layer_names_max_usec",
+    };
+    int values[] = {
+        clamp_int(st.memory_hits),
+        clamp_int(st.file_hits),
+        clamp_int(st.persistent_hits),
+        clamp_int(st.misses),
+        clamp_int(st.contains_hits),
+        clamp_int(st.contains_misses),
+        clamp_int(st.bytes_in / 1024),
+        clamp_int(st.bytes_out / 1024),
+        clamp_int(st.memory_evictions),
+        clamp_int(st.file_evictions),
+        clamp_int(st.persistent_evictions),
+        clamp_int(st.file_reads),
+        clamp_int(average(st.file_read_usec, st.file_reads)),
+        clamp_int(st.file_read_max_usec),
+        clamp_int(st.memory_used / 1024),
+        clamp_int(st.memory_limit / 1024),
+        clamp_int(st.file_used / 1024),
+        clamp_int(st.file_limit / 1024),
+        clamp_int(st.persistent_used / 1024),
+        clamp_int(st.persistent_limit / 1024),
+        clamp_int(st.draw_cache_hits),
+        clamp_int(st.draw_cache_misses),
+        clamp_int(st.draw_cache_evictions),
+        clamp_int(st.draw_cache_entries),
+        clamp_int(st.draw_cache_bytes / 1024),
+        clamp_int(st.draw_cache_limit / 1024),
+        clamp_int(st.prop.count),
+        clamp_int(average(st.prop.total_usec, st.prop.count)),
+        clamp_int(st.prop.max_usec),
+        clamp_int(st.prop_batch.count),
+        clamp_int(average(st.prop_batch.total_usec, st.prop_batch.count)),
+        clamp_int(st.prop_batch.max_usec),
+        clamp_int(st.draw.count),
+        clamp_int(average(st.draw.total_usec, st.draw.count)),
+        clamp_int(st.draw.max_usec),
+        clamp_int(st.draw_batch.count),
+        clamp_int(average(st.draw_batch.total_usec, st.draw_batch.count)),
+        clamp_int(st.draw_batch.max_usec),
+        clamp_int(st.layer_names.count),
+        clamp_int(average(st.layer_names.total_usec, st.layer_names.count)),
+        clamp_int(st.layer_names.max_usec),
+    };
+    static_assert(sizeof(keys) / sizeof(keys[0]) == sizeof(values) / sizeof(values[0]),
+                  "keys and values array size mismatch");
+    param->push_result_table_int(keys, values, sizeof(keys) / sizeof(keys[0]));
+  }
+
+  success = true;
+
+cleanup:
+  if (!success) {
+    param->push_result_boolean(false);
+    ptk_logf_error(&err, "%1$hs", "%1$hs", gettext("failed to get cache statistics."));
+    OV_ERROR_DESTROY(&err);
+  }
+}
+
+static void log_latency(char const *const name, struct ptk_script_module_latency const *const l) {
+  ptk_logf_verbose(NULL,
+                   "%1$hs%2$llu%3$llu%4$llu",
+                   "ipc %1$hs: %2$llu calls / avg %3$llu us / max %4$llu us",
+                   name,
+                   (unsigned long long)l->count,
+                   (unsigned long long)average(l->total_usec, l->count),
+                   (unsigned long long)l->max_usec);
+}
+
+void ptk_script_module_log_cache_stats(struct ptk_script_module *const sm,
+                                       struct aviutl2_script_module_param *const param) {
+  struct ov_error err = {0};
+  bool success = false;
+
+  if (!sm || !param) {
+    OV_ERROR_SET_GENERIC(&err, ov_error_generic_invalid_argument);
+    goto cleanup;
+  }
+
+  {
+    struct ptk_script_module_cache_stats st;
+    if (!get_cache_stats(sm, &st, &err)) {
+      OV_ERROR_ADD_TRACE(&err);
+      goto cleanup;
+    }
+    ptk_logf_verbose(NULL,
+                     "%1$llu%2$llu%3$llu%4$llu%5$llu%6$llu",
+                     "cache hits: memory %1$llu / file %2$llu / persistent %3$llu / misses %4$llu / "
+                     "contains %5$llu hit %6$llu miss",
+                     (unsigned long long)st.memory_hits,
+                     (unsigned long long)st.file_hits,
+                     (unsigned long long)st.persistent_hits,
+                     (unsigned long long)st.misses,
+                     (unsigned long long)st.contains_hits,
+                     (unsigned long long)st.contains_misses);
+    ptk_logf_verbose(NULL,
+                     "%1$llu%2$llu%3$llu%4$llu%5$llu",
+                     "cache traffic: in %1$llu bytes / out %2$llu bytes / evictions memory %3$llu / file %4$llu / "
+                     "persistent %5$llu",
+                     (unsigned long long)st.bytes_in,
+                     (unsigned long long)st.bytes_out,
+                     (unsigned long long)st.memory_evictions,
+                     (unsigned long long)st.file_evictions,
+                     (unsigned long long)st.persistent_evictions);
+    ptk_logf_verbose(NULL,
+                     "%1$llu%2$llu%3$llu",
+                     "cache file reads: %1$llu / avg %2$llu us / max %3$llu us",
+                     (unsigned long long)st.file_reads,
+                     (unsigned long long)average(st.file_read_usec, st.file_reads),
+                     (unsigned long long)st.file_read_max_usec);
+    ptk_logf_verbose(NULL,
+                     "%1$llu%2$llu%3$llu%4$llu%5$llu%6$llu",
+                     "cache size: memory %1$llu of %2$llu bytes / file %3$llu of %4$llu bytes / "
+                     "persistent %5$llu of %6$llu bytes",
+                     (unsigned long long)st.memory_used,
+                     (unsigned long long)st.memory_limit,
+                     (unsigned long long)st.file_used,
+                     (unsigned long long)st.file_limit,
+                     (unsigned long long)st.persistent_used,
+                     (unsigned long long)st.persistent_limit);
+    ptk_logf_verbose(NULL,
+                     "%1$llu%2$llu%3$llu%4$llu%5$llu%6$llu",
+                     "draw cache: hits %1$llu / misses %2$llu / evictions %3$llu / %4$llu entries / "
+                     "%5$llu of %6$llu bytes",
+                     (unsigned long long)st.draw_cache_hits,
+                     (unsigned long long)st.draw_cache_misses,
+                     (unsigned long long)st.draw_cache_evictions,
+                     (unsigned long long)st.draw_cache_entries,
+                     (unsigned long long)st.draw_cache_bytes,
+                     (unsigned long long)st.draw_cache_limit);
+    log_latency("PROP", &st.prop);
+    log_latency("PRPB", &st.prop_batch);
+    log_latency("DRAW", &st.draw);
+    log_latency("DRWB", &st.draw_batch);
+    log_latency("LNAM", &st.layer_names);
+  }
+
+  param->push_result_boolean(true);
+  success = true;
+
+cleanup:
+  if (!success) {
+    param->push_result_boolean(false);
+    ptk_logf_error(&err, "%1$hs", "%1$hs", gettext("failed to get cache statistics."));
+    OV_ERROR_DESTROY(&err);
+  }
+}
+
 void ptk_script_module_draw(struct ptk_script_module *const sm, struct aviutl2_script_module_param *const param) {
   struct ov_error err = {0};
   bool success = false;
@@ -332,6 +560,126 @@ cleanup:
   }
 }
 
+void ptk_script_module_draw_batch(struct ptk_script_module *const sm,
+                                  struct aviutl2_script_module_param *const param) {
+  struct ov_error err = {0};
+  struct ptk_script_module_draw_batch_item *items = NULL;
+  char *hex_buf = NULL;
+  char const **hex_ptrs = NULL;
+  int *int_buf = NULL;
+  bool success = false;
+
+  if (!sm || !param) {
+    OV_ERROR_SET_GENERIC(&err, ov_error_generic_invalid_argument);
+    goto cleanup;
+  }
+
+  if (!sm->callbacks.draw_batch) {
+    OV_ERROR_SET_GENERIC(&err, ov_error_generic_not_implemented_yet);
+    goto cleanup;
+  }
+
+  {
+    int const num_params = param->get_param_num();
+    int const max_width = param->get_param_int(0);
+    int const max_height = param->get_param_int(1);
+    if (num_params < 2 || max_width <= 0 || max_height <= 0) {
+      OV_ERROR_SET_GENERIC(&err, ov_error_generic_invalid_argument);
+      goto cleanup;
+    }
+
+    size_t const n = (size_t)(num_params - 2);
+    if (n == 0) {
+      param->push_result_array_string(NULL, 0);
+      param->push_result_array_int(NULL, 0);
+      param->push_result_array_int(NULL, 0);
+      param->push_result_array_int(NULL, 0);
+      param->push_result_array_int(NULL, 0);
+      success = true;
+      goto cleanup;
+    }
+
+    if (!OV_ARRAY_GROW(&items, n) || !OV_ARRAY_GROW(&hex_buf, n * 17) || !OV_ARRAY_GROW(&hex_ptrs, n) ||
+        !OV_ARRAY_GROW(&int_buf, n * 4)) {
+      OV_ERROR_SET_GENERIC(&err, ov_error_generic_out_of_memory);
+      goto cleanup;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+      int const index = (int)i + 2;
+      char const *const path_utf8 = param->get_param_table_string(index, "file");
+      if (!path_utf8) {
+        OV_ERROR_SET_GENERIC(&err, ov_error_generic_invalid_argument);
+        goto cleanup;
+      }
+      items[i] = (struct ptk_script_module_draw_batch_item){
+          .params =
+              {
+                  .id = param->get_param_table_int(index, "id"),
+                  .path_utf8 = path_utf8,
+                  // NULL if key not present, "" for empty string (both are valid and have different meanings)
+                  .layer = param->get_param_table_string(index, "layer"),
+                  .scale = param->get_param_table_double(index, "scale"),
+                  .offset_x = param->get_param_table_int(index, "offsetx"),
+                  .offset_y = param->get_param_table_int(index, "offsety"),
+                  .tag = param->get_param_table_int(index, "tag"),
+                  .quality = param->get_param_table_int(index, "quality"),
+              },
+      };
+    }
+
+    if (!sm->callbacks.draw_batch(sm->callbacks.userdata, items, n, max_width, max_height, &err)) {
+      OV_ERROR_ADD_TRACE(&err);
+      goto cleanup;
+    }
+
+    int *const widths = int_buf;
+    int *const heights = int_buf + n;
+    int *const flip_xs = int_buf + n * 2;
+    int *const flip_ys = int_buf + n * 3;
+    for (size_t i = 0; i < n; ++i) {
+      ckey_to_hex(items[i].result.ckey, hex_buf + i * 17);
+      hex_ptrs[i] = hex_buf + i * 17;
+      widths[i] = items[i].result.width;
+      heights[i] = items[i].result.height;
+      flip_xs[i] = items[i].result.flip_x ? 1 : 0;
+      flip_ys[i] = items[i].result.flip_y ? 1 : 0;
+    }
+    param->push_result_array_string((LPCSTR *)hex_ptrs, (int)n);
+    param->push_result_array_int(widths, (int)n);
+    param->push_result_array_int(heights, (int)n);
+    param->push_result_array_int(flip_xs, (int)n);
+    param->push_result_array_int(flip_ys, (int)n);
+  }
+
+  success = true;
+
+cleanup:
+  if (int_buf) {
+    OV_ARRAY_DESTROY(&int_buf);
+  }
+  if (hex_ptrs) {
+    OV_ARRAY_DESTROY(&hex_ptrs);
+  }
+  if (hex_buf) {
+    OV_ARRAY_DESTROY(&hex_buf);
+  }
+  if (items) {
+    OV_ARRAY_DESTROY(&items);
+  }
+  if (!success) {
+    if (param) {
+      param->push_result_array_string(NULL, 0);
+      param->push_result_array_int(NULL, 0);
+      param->push_result_array_int(NULL, 0);
+      param->push_result_array_int(NULL, 0);
+      param->push_result_array_int(NULL, 0);
+    }
+    ptk_logf_error(&err, "%1$hs", "%1$hs", gettext("failed to draw PSD images."));
+    OV_ERROR_DESTROY(&err);
+  }
+}
+
 void ptk_script_module_get_preferred_languages(struct ptk_script_module *const sm,
                                                struct aviutl2_script_module_param *const param) {
   (void)sm;
@@ -33,6 +33,16 @@ struct ptk_script_module_set_props_result {
   bool flip_y;
 };
 
+/**
+ * @brief Item for draw_batch operation
+ *
+ * params is the input, result is filled in by the callback.
+ */
+struct ptk_script_module_draw_batch_item {
+  struct ptk_script_module_set_props_params params;
+  struct ptk_script_module_set_props_result result;
+};
+
 /**
  * @brief Result structure for get_drop_config operation
  */
@@ -46,6 +56,57 @@ struct ptk_script_module_drop_config {
   bool external_object_audio_text;
 };
 
+/**
+ * @brief Round trip latency of one IPC request type
+ */
+struct ptk_script_module_latency {
+  uint64_t count;
+  uint64_t total_usec;
+  uint64_t max_usec;
+};
+
+/**
+ * @brief Result structure for get_cache_stats operation
+ *
+ * Sizes are in bytes.
+ */
+struct ptk_script_module_cache_stats {
+  // Render cache
+  uint64_t memory_hits;
+  uint64_t file_hits;
+  uint64_t persistent_hits;
+  uint64_t misses;
+  uint64_t contains_hits;
+  uint64_t contains_misses;
+  uint64_t bytes_in;
+  uint64_t bytes_out;
+  uint64_t memory_evictions;
+  uint64_t file_evictions;
+  uint64_t persistent_evictions;
+  uint64_t file_reads;
+  uint64_t file_read_usec;
+  uint64_t file_read_max_usec;
+  uint64_t memory_used;
+  uint64_t memory_limit;
+  uint64_t file_used;
+  uint64_t file_limit;
+  uint64_t persistent_used;
+  uint64_t persistent_limit;
+  // Frame cache in the renderer process
+  uint64_t draw_cache_hits;
+  uint64_t draw_cache_misses;
+  uint64_t draw_cache_evictions;
+  uint64_t draw_cache_entries;
+  uint64_t draw_cache_bytes;
+  uint64_t draw_cache_limit;
+  // IPC round trips
+  struct ptk_script_module_latency prop;
+  struct ptk_script_module_latency prop_batch;
+  struct ptk_script_module_latency draw;
+  struct ptk_script_module_latency draw_batch;
+  struct ptk_script_module_latency layer_names;
+};
+
 /**
  * @brief Callback function table for script module dependencies
  *
@@ -119,6 +180,36 @@ struct ptk_script_module_callbacks {
                int32_t height,
                uint64_t ckey,
                struct ov_error *err);
+
+  /**
+   * @brief Set properties for several PSD objects and draw the ones not in the cache
+   *
+   * Sizes in the results are clamped to max_width and max_height, and images are
+   * rendered at the clamped size. Only entries missing from the cache are rendered.
+   *
+   * @param userdata Context pointer
+   * @param items [in,out] Items to process, results are filled in on success
+   * @param n Number of items
+   * @param max_width Maximum image width
+   * @param max_height Maximum image height
+   * @param err [out] Error information on failure
+   * @return true on success, false on failure
+   */
+  bool (*draw_batch)(void *userdata,
+                     struct ptk_script_module_draw_batch_item *items,
+                     size_t n,
+                     int32_t max_width,
+                     int32_t max_height,
+                     struct ov_error *err);
+
+  /**
+   * @brief Get cache and IPC statistics
+   * @param userdata Context pointer
+   * @param stats [out] Statistics
+   * @param err [out] Error information on failure
+   * @return true on success, false on failure
+   */
+  bool (*get_cache_stats)(void *userdata, struct ptk_script_module_cache_stats *stats, struct ov_error *err);
 };
 
 /**
@@ -203,6 +294,28 @@ void ptk_script_module_set_props(struct ptk_script_module *sm, struct aviutl2_sc
  */
 void ptk_script_module_get_drop_config(struct ptk_script_module *sm, struct aviutl2_script_module_param *param);
 
+/**
+ * @brief Script function: Get cache statistics
+ *
+ * Pushes a table result with cache hit counts, eviction counts, sizes in KiB
+ * and IPC round trip latencies in microseconds. Values larger than INT_MAX are clamped.
+ *
+ * @param sm Script module instance
+ * @param param Script module parameter interface
+ */
+void ptk_script_module_get_cache_stats(struct ptk_script_module *sm, struct aviutl2_script_module_param *param);
+
+/**
+ * @brief Script function: Write cache statistics to the log
+ *
+ * Writes the same statistics as get_cache_stats at the verbose level.
+ * Pushes a boolean result indicating success.
+ *
+ * @param sm Script module instance
+ * @param param Script module parameter interface
+ */
+void ptk_script_module_log_cache_stats(struct ptk_script_module *sm, struct aviutl2_script_module_param *param);
+
 /**
  * @brief Script function: Draw PSD image
  *
@@ -220,6 +333,23 @@ void ptk_script_module_get_drop_config(struct ptk_script_module *sm, struct aviu
  */
 void ptk_script_module_draw(struct ptk_script_module *sm, struct aviutl2_script_module_param *param);
 
+/**
+ * @brief Script function: Set properties and draw several PSD images at once
+ *
+ * Parameters from script:
+ *   [0] int: max_width - Maximum image width
+ *   [1] int: max_height - Maximum image height
+ *   [2...] table: item - Keys: id, file, layer, scale, offsetx, offsety, tag, quality
+ *
+ * Pushes 5 arrays with one element per item: cachekey_hex (string), width (int),
+ * height (int), flip_x (int, 0 or 1), flip_y (int, 0 or 1).
+ * All arrays are empty on failure.
+ *
+ * @param sm Script module instance
+ * @param param Script module parameter interface
+ */
+void ptk_script_module_draw_batch(struct ptk_script_module *sm, struct aviutl2_script_module_param *param);
+
 /**
  * @brief Script function: Get preferred UI languages
  *
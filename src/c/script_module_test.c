@@ -6,6 +6,7 @@
 
 #include <aviutl2_module2.h>
 
+#include <limits.h>
 #include <stdarg.h>
 #include <string.h>
 
@@ -24,6 +25,15 @@ void ptk_logf_error(struct ov_error const *const err, char const *const referenc
   (void)format;
 }
 
+static int g_logf_verbose_count = 0;
+
+void ptk_logf_verbose(struct ov_error const *const err, char const *const reference, char const *const format, ...) {
+  (void)err;
+  (void)reference;
+  (void)format;
+  ++g_logf_verbose_count;
+}
+
 // Stub for error message function
 bool ptk_error_get_main_message(struct ov_error *const err, wchar_t **const dest) {
   (void)err;
@@ -76,6 +86,11 @@ struct mock_context {
   bool get_drop_config_should_succeed;
   struct ptk_script_module_drop_config drop_config_result;
 
+  // For get_cache_stats test
+  bool get_cache_stats_called;
+  bool get_cache_stats_should_succeed;
+  struct ptk_script_module_cache_stats cache_stats_result;
+
   // For draw test
   bool draw_called;
   bool draw_should_succeed;
@@ -88,6 +103,19 @@ struct mock_context {
   // For get_preferred_languages test
   char const *pushed_array_strings[8];
   int pushed_array_string_count;
+
+  // For draw_batch test
+  int param_num;
+  char pushed_array_string_copies[8][17];
+  int pushed_array_ints[4][8];
+  int pushed_array_int_counts[4];
+  int pushed_array_int_calls;
+  bool draw_batch_called;
+  bool draw_batch_should_succeed;
+  size_t draw_batch_received_n;
+  int32_t draw_batch_received_max_width;
+  int32_t draw_batch_received_max_height;
+  struct ptk_script_module_set_props_params draw_batch_received_params[4];
 };
 
 static struct mock_context *g_ctx = NULL;
@@ -150,6 +178,58 @@ static char const *mock_get_param_table_string(int index, char const *key) {
   return g_ctx->param_table_strings[0];
 }
 
+static int mock_get_param_num(void) { return g_ctx->param_num; }
+
+static void mock_push_result_array_string_copy(char const **values, int num) {
+  g_ctx->pushed_array_string_count = num;
+  for (int i = 0; i < num && i < 8; ++i) {
+    strncpy(g_ctx->pushed_array_string_copies[i], values[i], 16);
+    g_ctx->pushed_array_string_copies[i][16] = '\0';
+  }
+}
+
+static void mock_push_result_array_int(int *values, int num) {
+  int const call = g_ctx->pushed_array_int_calls++;
+  if (call >= 4) {
+    return;
+  }
+  g_ctx->pushed_array_int_counts[call] = num;
+  for (int i = 0; i < num && i < 8; ++i) {
+    g_ctx->pushed_array_ints[call][i] = values[i];
+  }
+}
+
+// Table parameters for draw_batch start at index 2, one table per item
+static int mock_batch_get_param_table_int(int index, char const *key) {
+  int const item = index - 2;
+  if (strcmp(key, "id") == 0) {
+    return 100 + item;
+  } else if (strcmp(key, "offsetx") == 0) {
+    return item * 10;
+  } else if (strcmp(key, "offsety") == 0) {
+    return -item * 10;
+  } else if (strcmp(key, "tag") == 0) {
+    return 7;
+  } else if (strcmp(key, "quality") == 0) {
+    return 1;
+  }
+  return 0;
+}
+
+static double mock_batch_get_param_table_double(int index, char const *key) {
+  (void)key;
+  return 0.5 * (index - 1);
+}
+
+static char const *mock_batch_get_param_table_string(int index, char const *key) {
+  if (strcmp(key, "file") == 0) {
+    return g_ctx->param_table_strings[index - 2];
+  } else if (strcmp(key, "layer") == 0) {
+    return index == 2 ? "L.0" : NULL;
+  }
+  return NULL;
+}
+
 static bool
 mock_get_render_config_callback(void *userdata, bool *debug_mode, int *resize_quality, struct ov_error *err) {
   (void)userdata;
@@ -204,6 +284,18 @@ mock_get_drop_config_callback(void *userdata, struct ptk_script_module_drop_conf
   return true;
 }
 
+static bool
+mock_get_cache_stats_callback(void *userdata, struct ptk_script_module_cache_stats *stats, struct ov_error *err) {
+  (void)userdata;
+  g_ctx->get_cache_stats_called = true;
+  if (!g_ctx->get_cache_stats_should_succeed) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_fail);
+    return false;
+  }
+  *stats = g_ctx->cache_stats_result;
+  return true;
+}
+
 static bool mock_draw_callback(
     void *userdata, int id, char const *path_utf8, int32_t width, int32_t height, uint64_t ckey, struct ov_error *err) {
   (void)userdata;
@@ -220,6 +312,36 @@ static bool mock_draw_callback(
   return true;
 }
 
+static bool mock_draw_batch_callback(void *userdata,
+                                     struct ptk_script_module_draw_batch_item *items,
+                                     size_t n,
+                                     int32_t max_width,
+                                     int32_t max_height,
+                                     struct ov_error *err) {
+  (void)userdata;
+  g_ctx->draw_batch_called = true;
+  g_ctx->draw_batch_received_n = n;
+  g_ctx->draw_batch_received_max_width = max_width;
+  g_ctx->draw_batch_received_max_height = max_height;
+  for (size_t i = 0; i < n && i < 4; ++i) {
+    g_ctx->draw_batch_received_params[i] = items[i].params;
+  }
+  if (!g_ctx->draw_batch_should_succeed) {
+    OV_ERROR_SET_GENERIC(err, ov_error_generic_fail);
+    return false;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    items[i].result = (struct ptk_script_module_set_props_result){
+        .ckey = 0xabcdef0123456780ULL + i,
+        .width = 100 * (int32_t)(i + 1),
+        .height = 50,
+        .flip_x = i == 1,
+        .flip_y = i == 0,
+    };
+  }
+  return true;
+}
+
 static void test_script_module_get_render_config(void) {
   struct mock_context ctx = {0};
   g_ctx = &ctx;
@@ -571,6 +693,69 @@ static void test_script_module_get_drop_config(void) {
   g_ctx = NULL;
 }
 
+static void test_script_module_get_cache_stats(void) {
+  struct mock_context ctx = {0};
+  g_ctx = &ctx;
+
+  struct ov_error err = {0};
+  struct ptk_script_module_callbacks callbacks = {.get_cache_stats = mock_get_cache_stats_callback};
+  struct ptk_script_module *sm = ptk_script_module_create(&callbacks, &err);
+  if (!TEST_SUCCEEDED(sm != NULL, &err)) {
+    return;
+  }
+
+  struct aviutl2_script_module_param param = {
+      .push_result_boolean = mock_push_result_boolean,
+      .push_result_table_int = mock_push_result_table_int,
+  };
+
+  // Test: counters are pushed as-is, sizes in KiB, overflowing values are clamped
+  ctx.get_cache_stats_should_succeed = true;
+  ctx.cache_stats_result = (struct ptk_script_module_cache_stats){
+      .memory_hits = 10,
+      .file_hits = 3,
+      .persistent_hits = 2,
+      .misses = 5,
+      .contains_hits = 0x100000000ULL,
+      .contains_misses = 7,
+      .bytes_in = 4096,
+      .bytes_out = 1023,
+  };
+
+  ptk_script_module_get_cache_stats(sm, &param);
+
+  TEST_CHECK(ctx.get_cache_stats_called);
+  TEST_CHECK(ctx.pushed_table_num == 41);
+  TEST_CHECK(strcmp(ctx.pushed_table_keys[0], "memory_hits") == 0);
+  TEST_CHECK(ctx.pushed_table_values[0] == 10);
+  TEST_CHECK(ctx.pushed_table_values[1] == 3);
+  TEST_CHECK(ctx.pushed_table_values[2] == 2);
+  TEST_CHECK(ctx.pushed_table_values[3] == 5);
+  TEST_CHECK(ctx.pushed_table_values[4] == INT_MAX);
+  TEST_CHECK(ctx.pushed_table_values[5] == 7);
+  TEST_CHECK(strcmp(ctx.pushed_table_keys[6], "bytes_in_kib") == 0);
+  TEST_CHECK(ctx.pushed_table_values[6] == 4);
+  TEST_CHECK(ctx.pushed_table_values[7] == 0);
+
+  // Test: log_cache_stats writes to the verbose log
+  g_logf_verbose_count = 0;
+  ctx.pushed_boolean_count = 0;
+  ptk_script_module_log_cache_stats(sm, &param);
+  TEST_CHECK(g_logf_verbose_count > 0);
+  TEST_CHECK(ctx.pushed_boolean_count == 1 && ctx.pushed_boolean_values[0] == true);
+
+  // Test: callback failure
+  ctx.get_cache_stats_should_succeed = false;
+  ctx.pushed_boolean_count = 0;
+
+  ptk_script_module_get_cache_stats(sm, &param);
+
+  TEST_CHECK(ctx.pushed_boolean_count == 1 && ctx.pushed_boolean_values[0] == false);
+
+  ptk_script_module_destroy(&sm);
+  g_ctx = NULL;
+}
+
 static void test_script_module_draw(void) {
   struct mock_context ctx = {0};
   g_ctx = &ctx;
@@ -689,6 +874,99 @@ static void test_script_module_draw(void) {
   g_ctx = NULL;
 }
 
+static void test_script_module_draw_batch(void) {
+  struct mock_context ctx = {0};
+  g_ctx = &ctx;
+
+  struct ov_error err = {0};
+  struct ptk_script_module_callbacks callbacks = {.draw_batch = mock_draw_batch_callback};
+  struct ptk_script_module *sm = ptk_script_module_create(&callbacks, &err);
+  if (!TEST_SUCCEEDED(sm != NULL, &err)) {
+    return;
+  }
+
+  struct aviutl2_script_module_param param = {
+      .get_param_num = mock_get_param_num,
+      .get_param_int = mock_get_param_int,
+      .get_param_table_int = mock_batch_get_param_table_int,
+      .get_param_table_double = mock_batch_get_param_table_double,
+      .get_param_table_string = mock_batch_get_param_table_string,
+      .push_result_array_string = mock_push_result_array_string_copy,
+      .push_result_array_int = mock_push_result_array_int,
+  };
+
+  // Test: two items
+  ctx.param_num = 4;
+  ctx.param_ints[0] = 1920; // max_width
+  ctx.param_ints[1] = 1080; // max_height
+  ctx.param_table_strings[0] = "C:/test/a.psd";
+  ctx.param_table_strings[1] = "C:/test/b.psd";
+  ctx.draw_batch_should_succeed = true;
+
+  ptk_script_module_draw_batch(sm, &param);
+
+  TEST_CHECK(ctx.draw_batch_called);
+  TEST_CHECK(ctx.draw_batch_received_n == 2);
+  TEST_CHECK(ctx.draw_batch_received_max_width == 1920);
+  TEST_CHECK(ctx.draw_batch_received_max_height == 1080);
+  TEST_CHECK(ctx.draw_batch_received_params[0].id == 100);
+  TEST_CHECK(strcmp(ctx.draw_batch_received_params[0].path_utf8, "C:/test/a.psd") == 0);
+  TEST_CHECK(strcmp(ctx.draw_batch_received_params[0].layer, "L.0") == 0);
+  TEST_CHECK(ctx.draw_batch_received_params[0].scale == 0.5);
+  TEST_CHECK(ctx.draw_batch_received_params[1].id == 101);
+  TEST_CHECK(strcmp(ctx.draw_batch_received_params[1].path_utf8, "C:/test/b.psd") == 0);
+  TEST_CHECK(ctx.draw_batch_received_params[1].layer == NULL);
+  TEST_CHECK(ctx.draw_batch_received_params[1].offset_x == 10);
+  TEST_CHECK(ctx.draw_batch_received_params[1].offset_y == -10);
+  TEST_CHECK(ctx.draw_batch_received_params[1].tag == 7);
+  TEST_CHECK(ctx.draw_batch_received_params[1].quality == 1);
+
+  TEST_CHECK(ctx.pushed_array_string_count == 2);
+  TEST_CHECK(strcmp(ctx.pushed_array_string_copies[0], "abcdef0123456780") == 0);
+  TEST_CHECK(strcmp(ctx.pushed_array_string_copies[1], "abcdef0123456781") == 0);
+  TEST_CHECK(ctx.pushed_array_int_calls == 4);
+  TEST_CHECK(ctx.pushed_array_ints[0][0] == 100 && ctx.pushed_array_ints[0][1] == 200); // width
+  TEST_CHECK(ctx.pushed_array_ints[1][0] == 50 && ctx.pushed_array_ints[1][1] == 50);   // height
+  TEST_CHECK(ctx.pushed_array_ints[2][0] == 0 && ctx.pushed_array_ints[2][1] == 1);     // flip_x
+  TEST_CHECK(ctx.pushed_array_ints[3][0] == 1 && ctx.pushed_array_ints[3][1] == 0);     // flip_y
+
+  // Test: callback failure -> empty arrays
+  ctx.draw_batch_should_succeed = false;
+  ctx.draw_batch_called = false;
+  ctx.pushed_array_int_calls = 0;
+
+  ptk_script_module_draw_batch(sm, &param);
+
+  TEST_CHECK(ctx.draw_batch_called);
+  TEST_CHECK(ctx.pushed_array_string_count == 0);
+  TEST_CHECK(ctx.pushed_array_int_calls == 4);
+  TEST_CHECK(ctx.pushed_array_int_counts[0] == 0);
+
+  // Test: missing file -> callback not called
+  ctx.param_table_strings[1] = NULL;
+  ctx.draw_batch_should_succeed = true;
+  ctx.draw_batch_called = false;
+  ctx.pushed_array_int_calls = 0;
+
+  ptk_script_module_draw_batch(sm, &param);
+
+  TEST_CHECK(!ctx.draw_batch_called);
+  TEST_CHECK(ctx.pushed_array_string_count == 0);
+
+  // Test: invalid max size -> callback not called
+  ctx.param_table_strings[1] = "C:/test/b.psd";
+  ctx.param_ints[0] = 0;
+  ctx.draw_batch_called = false;
+
+  ptk_script_module_draw_batch(sm, &param);
+
+  TEST_CHECK(!ctx.draw_batch_called);
+  TEST_CHECK(ctx.pushed_array_string_count == 0);
+
+  ptk_script_module_destroy(&sm);
+  g_ctx = NULL;
+}
+
 static void test_script_module_read_text_file(void) {
   struct mock_context ctx = {0};
   g_ctx = &ctx;
@@ -768,7 +1046,9 @@ TEST_LIST = {
     {"test_script_module_add_psd_file", test_script_module_add_psd_file},
     {"test_script_module_set_props", test_script_module_set_props},
     {"test_script_module_get_drop_config", test_script_module_get_drop_config},
+    {"test_script_module_get_cache_stats", test_script_module_get_cache_stats},
     {"test_script_module_draw", test_script_module_draw},
+    {"test_script_module_draw_batch", test_script_module_draw_batch},
     {"test_script_module_read_text_file", test_script_module_read_text_file},
     {"test_script_module_get_preferred_languages", test_script_module_get_preferred_languages},
     {NULL, NULL},
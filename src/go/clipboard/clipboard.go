@@ -169,10 +169,14 @@ func setFormatData(uFormat uintptr, data []byte) error {
 	return nil
 }
 
+// nrgbaToNBGRA swaps R and B in place.
+// Fully transparent pixels are cleared to zero instead of keeping their hidden color.
 func nrgbaToNBGRA(p []byte) {
 	for i := 0; i < len(p); i += 4 {
 		if p[i+3] > 0 {
 			p[i+2], p[i+0] = p[i+0], p[i+2]
+		} else {
+			p[i+0], p[i+1], p[i+2] = 0, 0, 0
 		}
 	}
 }
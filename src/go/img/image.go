@@ -53,7 +53,7 @@ type Toucher interface {
 
 type Image struct {
 	FilePath *string
-	FileHash uint32
+	FileHash uint64
 	Toucher  Toucher
 
 	PSD    *composite.Tree
@@ -75,6 +75,8 @@ type Image struct {
 	scaledScale  float32 // The scale value when scaledImages was generated
 	// pendingDirtyTiles tracks dirty tiles per quality for differential downscale
 	pendingDirtyTiles map[ScaleQuality][]image.Point
+	// mips holds the downscale sources for scales below 1/2
+	mips map[ScaleQuality]*mipPyramid
 
 	PFV *PFV
 }
@@ -112,7 +114,7 @@ func (img *Image) SetFlipX(v bool) bool {
 		f &= ^FlipX
 	}
 	img.Layers.SetFlip(f)
-	img.Layers.Flip = f
+	img.Layers.setFlip(f)
 	return true
 }
 
@@ -150,6 +152,9 @@ func (img *Image) Render(ctx context.Context) (*image.NRGBA, error) {
 // RenderWithScale renders the image at a specific scale with the given quality.
 // When applyFlip is false, the returned image does not have flip applied, which is useful
 // when the caller wants to apply flip together with other transformations (e.g., offset) in a single pass.
+//
+// Below 1/2 the result is downscaled from the mip level chosen by mipLevel(scale), so the
+// same state and scale always give the same pixels no matter which scales were used before.
 func (img *Image) RenderWithScale(ctx context.Context, scale float64, quality ScaleQuality, applyFlip bool) (*image.NRGBA, error) {
 	var err error
 	tileSize := img.PSD.Renderer.TileSize()
@@ -160,6 +165,7 @@ func (img *Image) RenderWithScale(ctx context.Context, scale float64, quality Sc
 		// Clear scaled cache on initial render
 		img.scaledImages = nil
 		img.pendingDirtyTiles = nil
+		img.mips = nil
 	} else {
 		dirtyTiles, err2 := img.PSD.Renderer.RenderDiffWithDirtyTiles(ctx, img.image)
 		if err2 != nil {
@@ -172,6 +178,9 @@ func (img *Image) RenderWithScale(ctx context.Context, scale float64, quality Sc
 			}
 			img.pendingDirtyTiles[ScaleQualityFast] = append(img.pendingDirtyTiles[ScaleQualityFast], dirtyTiles...)
 			img.pendingDirtyTiles[ScaleQualityBeautiful] = append(img.pendingDirtyTiles[ScaleQualityBeautiful], dirtyTiles...)
+			for _, p := range img.mips {
+				p.invalidate(dirtyTiles)
+			}
 		}
 	}
 	if err != nil {
@@ -183,16 +192,7 @@ func (img *Image) RenderWithScale(ctx context.Context, scale float64, quality Sc
 
 	// Handle downscaling if scale < 1
 	if scale < 1 {
-		// Calculate scaled rect
-		r := img.PSD.CanvasRect
-		r.Max.X = r.Min.X + int(float64(r.Dx())*scale+0.5)
-		r.Max.Y = r.Min.Y + int(float64(r.Dy())*scale+0.5)
-		if r.Dx() < 1 {
-			r.Max.X = r.Min.X + 1
-		}
-		if r.Dy() < 1 {
-			r.Max.Y = r.Min.Y + 1
-		}
+		r := scaleRect(img.PSD.CanvasRect, scale)
 
 		// Check if we need to reset cache (scale changed)
 		if img.scaledScale != float32(scale) {
@@ -209,36 +209,29 @@ func (img *Image) RenderWithScale(ctx context.Context, scale float64, quality Sc
 		cached, hasCached := img.scaledImages[quality]
 		pendingTiles := img.pendingDirtyTiles[quality]
 
-		// Use differential downscale if we have pending dirty tiles and a cached image
-		if hasCached && len(pendingTiles) > 0 {
-			switch quality {
-			case ScaleQualityFast:
-				if err = downscale.NRGBAFastPartial(ctx, cached, img.image, tileSize, tileSize, pendingTiles); err != nil {
-					return nil, errors.Wrap(err, "img: partial downscale failed")
-				}
-			case ScaleQualityBeautiful:
-				if err = downscale.NRGBAGammaPartialWithTable(ctx, cached, img.image, getGammaTable22(), tileSize, tileSize, pendingTiles); err != nil {
-					return nil, errors.Wrap(err, "img: partial downscale failed")
-				}
+		if hasCached && len(pendingTiles) == 0 {
+			// No changes, use cached
+			nrgba = cached
+		} else if hasCached && mipLevel(scale) < 0 {
+			// Downscaled from the canvas, so only the dirty tiles need to be redone
+			if err = downscaleTiles(ctx, cached, img.image, quality, tileSize, scale, pendingTiles); err != nil {
+				return nil, errors.Wrap(err, "img: partial downscale failed")
 			}
-			// Clear pending dirty tiles for this quality
 			img.pendingDirtyTiles[quality] = nil
 			nrgba = cached
-		} else if hasCached && len(pendingTiles) == 0 {
-			// No changes, use cached
-			nrgba = cached
 		} else {
-			// Full downscale (initial or cache miss)
+			// Full downscale from the mip level, which applies its own dirty tiles first.
+			// A level is at most a quarter of the canvas, so this stays cheap when the
+			// scale changes every frame.
+			src, err := img.mipSource(ctx, scale, quality, tileSize)
+			if err != nil {
+				return nil, errors.Wrap(err, "img: downscale failed")
+			}
 			tmp := image.NewNRGBA(r)
-			switch quality {
-			case ScaleQualityFast:
-				if err = downscale.NRGBAFast(ctx, tmp, img.image); err != nil {
-					return nil, errors.Wrap(err, "img: downscale failed")
-				}
-			case ScaleQualityBeautiful:
-				if err = downscale.NRGBAGammaWithTable(ctx, tmp, img.image, getGammaTable22()); err != nil {
-					return nil, errors.Wrap(err, "img: downscale failed")
-				}
+			if src.Rect.Size() == r.Size() {
+				copy(tmp.Pix, src.Pix)
+			} else if err = downscaleFull(ctx, tmp, src, quality); err != nil {
+				return nil, errors.Wrap(err, "img: downscale failed")
 			}
 			img.scaledImages[quality] = tmp
 			// Clear pending dirty tiles since we did full downscale
@@ -266,12 +259,90 @@ func (img *Image) RenderWithScale(ctx context.Context, scale float64, quality Sc
 	return nrgba, nil
 }
 
+// mipSource returns the smallest mip level that is still at least as large as scale,
+// building it from the canvas or applying its pending dirty tiles first.
+// It returns the canvas itself when scale is above the first level.
+func (img *Image) mipSource(ctx context.Context, scale float64, quality ScaleQuality, tileSize int) (*image.NRGBA, error) {
+	n := mipLevel(scale)
+	if n < 0 {
+		return img.image, nil
+	}
+	if img.mips == nil {
+		img.mips = make(map[ScaleQuality]*mipPyramid)
+	}
+	p := img.mips[quality]
+	if p == nil {
+		p = &mipPyramid{}
+		img.mips[quality] = p
+	}
+	levelScale := mipLevelScale(n)
+	if l := p.levels[n]; l != nil {
+		if tiles := p.takePending(n); len(tiles) > 0 {
+			if err := downscaleTiles(ctx, l, img.image, quality, tileSize, levelScale, tiles); err != nil {
+				// The level may be half updated, build it again next time
+				p.levels[n] = nil
+				return nil, err
+			}
+		}
+		return l, nil
+	}
+	l := image.NewNRGBA(scaleRect(img.PSD.CanvasRect, levelScale))
+	if err := downscaleFull(ctx, l, img.image, quality); err != nil {
+		return nil, err
+	}
+	p.levels[n] = l
+	return l, nil
+}
+
+// downscaleFull downscales the whole src into dst.
+func downscaleFull(ctx context.Context, dst, src *image.NRGBA, quality ScaleQuality) error {
+	switch quality {
+	case ScaleQualityFast:
+		return downscale.NRGBAFast(ctx, dst, src)
+	case ScaleQualityBeautiful:
+		return downscale.NRGBAGammaWithTable(ctx, dst, src, getGammaTable22())
+	}
+	return nil
+}
+
+// downscaleTiles downscales only the given tiles of src into dst, which is src at scale.
+func downscaleTiles(ctx context.Context, dst, src *image.NRGBA, quality ScaleQuality, tileSize int, scale float64, tiles []image.Point) error {
+	var partial func(ctx context.Context, tiles []image.Point) error
+	switch quality {
+	case ScaleQualityFast:
+		partial = func(ctx context.Context, tiles []image.Point) error {
+			return downscale.NRGBAFastPartial(ctx, dst, src, tileSize, tileSize, tiles)
+		}
+	case ScaleQualityBeautiful:
+		partial = func(ctx context.Context, tiles []image.Point) error {
+			return downscale.NRGBAGammaPartialWithTable(ctx, dst, src, getGammaTable22(), tileSize, tileSize, tiles)
+		}
+	default:
+		return nil
+	}
+	return downscalePartial(ctx, tiles, tileSize, scale, partial)
+}
+
+// scaleRect returns r scaled by scale, at least 1x1.
+func scaleRect(r image.Rectangle, scale float64) image.Rectangle {
+	r.Max.X = r.Min.X + int(float64(r.Dx())*scale+0.5)
+	r.Max.Y = r.Min.Y + int(float64(r.Dy())*scale+0.5)
+	if r.Dx() < 1 {
+		r.Max.X = r.Min.X + 1
+	}
+	if r.Dy() < 1 {
+		r.Max.Y = r.Min.Y + 1
+	}
+	return r
+}
+
+// Serialize returns the flip and layer visibility as a state string.
 func (img *Image) Serialize() (string, error) {
-	s, err := img.Layers.Serialize()
+	s, err := img.Layers.SerializeWithFlip()
 	if err != nil {
 		return "", errors.Wrap(err, "Image.Serialize: failed to serialize")
 	}
-	return "L." + itoa(int(img.Layers.Flip)) + " " + s, nil
+	return s, nil
 }
 
 func (img *Image) Deserialize(s string) (bool, error) {
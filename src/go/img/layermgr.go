@@ -1,14 +1,12 @@
 package img
 
 import (
-	"fmt"
+	"sort"
 	"strings"
 
 	"github.com/oov/psd/composite"
 	"github.com/pkg/errors"
 
-	"psdtoolkit/img/prop"
-	"psdtoolkit/ods"
 	"psdtoolkit/warn"
 )
 
@@ -18,6 +16,9 @@ type flipPair struct {
 	Original SeqID
 	Mirror   SeqID
 	Children []*group
+
+	// syncs holds Children as {original side, mirror side} flat indices.
+	syncs [][2]flatIndex
 }
 
 type flipPairMap map[SeqID]*flipPair
@@ -51,11 +52,9 @@ type Layer struct {
 	FullPath  string
 }
 
-type LayerManager struct {
-	Renderer *composite.Renderer
-	Flip     Flip
-
-	Layers   []Layer
+// LayerTopology is the part of a LayerManager that only depends on the structure of the layer tree.
+// It is not modified once built, so the managers of every clone of a tree can share one.
+type LayerTopology struct {
 	Mapped   map[SeqID]flatIndex
 	FullPath map[string]flatIndex
 
@@ -65,45 +64,167 @@ type LayerManager struct {
 	FlipXMap     flipPairMap
 	FlipYMap     flipPairMap
 	FlipXYMap    flipPairMap
+
+	// fullPaths is the full path of each layer in flat index order.
+	fullPaths []string
+
+	// Relationships resolved to flat indices once in NewLayerManager, so that
+	// visibility propagation is array walks instead of map lookups and path building.
+	// Each per-layer slice has one entry per layer and uses -1 for "none".
+	parent      []flatIndex
+	firstChild  []flatIndex
+	nextSibling []flatIndex
+	firstRoot   flatIndex
+	// groupOf is the index in groups of the exclusive group the layer belongs to.
+	groupOf []int32
+	groups  [][]flatIndex
+	// syncOf is the index in syncGroups of the layer's synced pair.
+	syncOf       []int32
+	syncGroups   [][2]flatIndex
+	forceVisible []flatIndex
+	// flips holds each flip pair once, for FlipX, FlipY and FlipXY in that order.
+	flips [3][]*flipPair
+
+	// StatePrograms memoizes Deserialize.
+	StatePrograms *StatePrograms
+}
+
+type LayerManager struct {
+	*LayerTopology
+
+	Renderer *composite.Renderer
+	Flip     Flip
+
+	Layers []Layer
+
+	// visible mirrors Layer.Visible of every layer so layerStates can copy it at once.
+	visible bitset
+	// digest is the XOR of visibleKey over all visible layers,
+	// kept up to date whenever a layer's visibility changes.
+	digest uint64
+	// version increases whenever a layer's visibility or the flip changes.
+	version uint64
+
+	// serialized caches Serialize until version changes.
+	serialized        string
+	serializedVersion uint64
+}
+
+// visibleKey returns a pseudo-random 64-bit key for the layer at fi (splitmix64).
+func visibleKey(fi flatIndex) uint64 {
+	z := uint64(fi+1) * 0x9e3779b97f4a7c15
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9
+	z = (z ^ (z >> 27)) * 0x94d049bb133111eb
+	return z ^ (z >> 31)
+}
+
+// setLayerVisible changes the visibility of the layer at fi and keeps the bitset and digest in sync.
+// It reports whether the visibility changed.
+func (m *LayerManager) setLayerVisible(fi flatIndex, visible bool) bool {
+	l := m.Layers[fi].Layer
+	if l.Visible == visible {
+		return false
+	}
+	l.Visible = visible
+	m.visible.set(fi, visible)
+	m.digest ^= visibleKey(fi)
+	m.version++
+	return true
+}
+
+// setFlip changes the flip state and bumps the version if it differs.
+func (m *LayerManager) setFlip(flip Flip) {
+	if m.Flip != flip {
+		m.Flip = flip
+		m.version++
+	}
+}
+
+// Version returns a counter that changes whenever the layer visibility or the flip changes.
+func (m *LayerManager) Version() uint64 {
+	return m.version
+}
+
+// VisibilityDigest returns a 64-bit digest of the visibility of all layers.
+// It is maintained incrementally, so calling it costs nothing.
+func (m *LayerManager) VisibilityDigest() uint64 {
+	return m.digest
 }
 
 func NewLayerManager(tree *composite.Tree) *LayerManager {
 	m := &LayerManager{
+		LayerTopology: &LayerTopology{
+			Mapped:   map[SeqID]flatIndex{},
+			FullPath: map[string]flatIndex{},
+
+			ForceVisible: forceVisibleMap{},
+			GroupMap:     groupMap{},
+			SyncedMap:    groupMap{},
+			FlipXMap:     flipPairMap{},
+			FlipYMap:     flipPairMap{},
+			FlipXYMap:    flipPairMap{},
+
+			StatePrograms: NewStatePrograms(),
+		},
 		Renderer: tree.Renderer,
-
-		Mapped:   map[SeqID]flatIndex{},
 		Layers:   []Layer{},
-		FullPath: map[string]flatIndex{},
-
-		ForceVisible: forceVisibleMap{},
-		GroupMap:     groupMap{},
-		SyncedMap:    groupMap{},
-		FlipXMap:     flipPairMap{},
-		FlipYMap:     flipPairMap{},
-		FlipXYMap:    flipPairMap{},
 	}
-	dup := map[string]int{}
-	var g group
-	for i := range tree.Root.Children {
-		enumChildren(m, &tree.Root.Children[i], tree.Root.Children, nil, dup)
-		if isGroup(tree.Root.Children[i].Name) {
-			g = append(g, SeqID(tree.Root.Children[i].SeqID))
+	m.firstRoot = enumLayers(m, tree.Root.Children, nil, -1)
+	buildFlips(m)
+	for _, fps := range m.flips {
+		for _, fp := range fps {
+			registerSyncs(m, fp, m.Mapped[fp.Original], m.Mapped[fp.Mirror])
 		}
 	}
-	for _, seqID := range g {
-		m.GroupMap[seqID] = &g
+	m.init()
+	return m
+}
+
+// NewLayerManagerWithTopology creates a LayerManager for tree reusing t,
+// which must have been built from the same tree or a clone of it.
+// Only the layer list and visibility are computed, so this is much cheaper than NewLayerManager.
+func NewLayerManagerWithTopology(tree *composite.Tree, t *LayerTopology) *LayerManager {
+	m := &LayerManager{
+		LayerTopology: t,
+		Renderer:      tree.Renderer,
+		Layers:        make([]Layer, 0, len(t.fullPaths)),
 	}
-	for _, fp := range m.FlipXMap {
-		registerSyncs(m, &fp.Children, fp.Original, fp.Mirror)
+	if !collectLayers(m, tree.Root.Children) || len(m.Layers) != len(t.fullPaths) {
+		return NewLayerManager(tree)
 	}
-	for _, fp := range m.FlipYMap {
-		registerSyncs(m, &fp.Children, fp.Original, fp.Mirror)
+	m.init()
+	return m
+}
+
+// collectLayers appends the layers of an already enumerated tree in flat index order.
+func collectLayers(m *LayerManager, sib []composite.Layer) bool {
+	for i := range sib {
+		fi := flatIndex(len(m.Layers))
+		if int(fi) >= len(m.fullPaths) || m.Mapped[SeqID(sib[i].SeqID)] != fi {
+			return false
+		}
+		m.Layers = append(m.Layers, Layer{
+			FlatIndex: fi,
+			Layer:     &sib[i],
+			FullPath:  m.fullPaths[fi],
+		})
+		if !collectLayers(m, sib[i].Children) {
+			return false
+		}
 	}
-	for _, fp := range m.FlipXYMap {
-		registerSyncs(m, &fp.Children, fp.Original, fp.Mirror)
+	return true
+}
+
+// init computes the visibility state from the layers and normalizes it.
+func (m *LayerManager) init() {
+	m.visible = make(bitset, bitsetWords(len(m.Layers)))
+	for fi, l := range m.Layers {
+		if l.Layer.Visible {
+			m.visible.set(flatIndex(fi), true)
+			m.digest ^= visibleKey(flatIndex(fi))
+		}
 	}
 	m.Normalize()
-	return m
 }
 
 func (m *LayerManager) FindLayerBySeqID(seqID SeqID) *Layer {
@@ -161,33 +282,67 @@ func isGroup(s string) bool {
 	return len(s) > 1 && s[0] == '*' && s[1] != '*'
 }
 
-func registerSyncs(lm *LayerManager, children *[]*group, id0 SeqID, id1 SeqID) {
-	l0, l1 := lm.FindLayerBySeqID(id0), lm.FindLayerBySeqID(id1)
-	if (l0 == nil) || (l1 == nil) {
-		return
+// baseName returns the last element of the layer's full path.
+func (m *LayerManager) baseName(fi flatIndex) string {
+	p := m.parent[fi]
+	if p < 0 {
+		return m.Layers[fi].FullPath
 	}
-	for i := range l0.Layer.Children {
-		cid0 := SeqID(l0.Layer.Children[i].SeqID)
-		cl0 := lm.FindLayerBySeqID(cid0)
-		if cl0 == nil {
-			continue
+	return m.Layers[fi].FullPath[len(m.Layers[p].FullPath)+1:]
+}
+
+// findChild returns the child of fi whose full path ends with name, or -1.
+func (m *LayerManager) findChild(fi flatIndex, name string) flatIndex {
+	for c := m.firstChild[fi]; c >= 0; c = m.nextSibling[c] {
+		if m.baseName(c) == name {
+			return c
 		}
-		path := l1.FullPath + cl0.FullPath[len(l0.FullPath):]
-		cl1 := lm.FindLayerByFullPath(path)
-		if cl1 == nil {
+	}
+	return -1
+}
+
+// registerSyncs pairs up the descendants of fi0 and fi1 that have the same relative path.
+func registerSyncs(m *LayerManager, fp *flipPair, fi0 flatIndex, fi1 flatIndex) {
+	if fi0 < 0 || fi1 < 0 {
+		return
+	}
+	for c0 := m.firstChild[fi0]; c0 >= 0; c0 = m.nextSibling[c0] {
+		c1 := m.findChild(fi1, m.baseName(c0))
+		if c1 < 0 {
 			continue
 		}
-		cid1 := SeqID(cl1.Layer.SeqID)
+		cid0, cid1 := SeqID(m.Layers[c0].Layer.SeqID), SeqID(m.Layers[c1].Layer.SeqID)
 		g := &group{cid0, cid1}
-		lm.SyncedMap[cid0] = g
-		lm.SyncedMap[cid1] = g
-		*children = append(*children, g)
-		if len(cl0.Layer.Children) > 0 && len(cl1.Layer.Children) > 0 {
-			registerSyncs(lm, children, cid0, cid1)
+		m.SyncedMap[cid0] = g
+		m.SyncedMap[cid1] = g
+		fp.Children = append(fp.Children, g)
+		fp.syncs = append(fp.syncs, [2]flatIndex{c0, c1})
+		id := int32(len(m.syncGroups))
+		m.syncGroups = append(m.syncGroups, [2]flatIndex{c0, c1})
+		m.syncOf[c0], m.syncOf[c1] = id, id
+		if m.firstChild[c0] >= 0 && m.firstChild[c1] >= 0 {
+			registerSyncs(m, fp, c0, c1)
 		}
 	}
 }
 
+// buildFlips lists every flip pair once in the order SetFlip visits them.
+func buildFlips(m *LayerManager) {
+	seen := map[*flipPair]struct{}{}
+	for i, fpMap := range []flipPairMap{m.FlipXMap, m.FlipYMap, m.FlipXYMap} {
+		var l []*flipPair
+		for _, fp := range fpMap {
+			if _, ok := seen[fp]; ok {
+				continue
+			}
+			seen[fp] = struct{}{}
+			l = append(l, fp)
+		}
+		sort.Slice(l, func(a, b int) bool { return m.Mapped[l[a].Original] < m.Mapped[l[b].Original] })
+		m.flips[i] = l
+	}
+}
+
 func registerFlips(m *LayerManager, l *composite.Layer, sib []composite.Layer) {
 	tokens := strings.Split(l.Name, ":")
 	var orgName string
@@ -236,7 +391,40 @@ func registerFlips(m *LayerManager, l *composite.Layer, sib []composite.Layer) {
 	}
 }
 
-func enumChildren(m *LayerManager, l *composite.Layer, sib []composite.Layer, dir []byte, dup map[string]int) {
+// enumLayers registers the layers in sib and their descendants under parent.
+// It returns the flat index of the first one, or -1 if sib is empty.
+func enumLayers(m *LayerManager, sib []composite.Layer, dir []byte, parent flatIndex) flatIndex {
+	dup := map[string]int{}
+	first, prev := flatIndex(-1), flatIndex(-1)
+	var g []flatIndex
+	for i := range sib {
+		fi := enumChildren(m, &sib[i], sib, dir, dup, parent)
+		if prev < 0 {
+			first = fi
+		} else {
+			m.nextSibling[prev] = fi
+		}
+		prev = fi
+		if isGroup(sib[i].Name) {
+			g = append(g, fi)
+		}
+	}
+	if len(g) > 0 {
+		sg := make(group, len(g))
+		id := int32(len(m.groups))
+		for i, fi := range g {
+			sg[i] = SeqID(m.Layers[fi].Layer.SeqID)
+			m.groupOf[fi] = id
+		}
+		for _, seqID := range sg {
+			m.GroupMap[seqID] = &sg
+		}
+		m.groups = append(m.groups, g)
+	}
+	return first
+}
+
+func enumChildren(m *LayerManager, l *composite.Layer, sib []composite.Layer, dir []byte, dup map[string]int, parent flatIndex) flatIndex {
 	if dir != nil {
 		dir = append(dir, '/')
 	}
@@ -258,23 +446,21 @@ func enumChildren(m *LayerManager, l *composite.Layer, sib []composite.Layer, di
 	})
 	m.Mapped[SeqID(l.SeqID)] = layerIndex
 	m.FullPath[fullPath] = layerIndex
+	m.fullPaths = append(m.fullPaths, fullPath)
+	m.parent = append(m.parent, parent)
+	m.firstChild = append(m.firstChild, -1)
+	m.nextSibling = append(m.nextSibling, -1)
+	m.groupOf = append(m.groupOf, -1)
+	m.syncOf = append(m.syncOf, -1)
 
 	if isForceVisible(l.Name) {
 		m.ForceVisible[SeqID(l.SeqID)] = struct{}{}
+		m.forceVisible = append(m.forceVisible, layerIndex)
 	}
 	registerFlips(m, l, sib)
 
-	dup = map[string]int{}
-	var g group
-	for i := range l.Children {
-		enumChildren(m, &l.Children[i], l.Children, dir, dup)
-		if isGroup(l.Children[i].Name) {
-			g = append(g, SeqID(l.Children[i].SeqID))
-		}
-	}
-	for _, seqID := range g {
-		m.GroupMap[seqID] = &g
-	}
+	m.firstChild[layerIndex] = enumLayers(m, l.Children, dir, layerIndex)
+	return layerIndex
 }
 
 func (m *LayerManager) GetFullPathLayerNames() []string {
@@ -293,140 +479,35 @@ func (m *LayerManager) GetFlatIndex(l *composite.Layer) int {
 	return int(fi)
 }
 
+// Deserialize applies a space-separated layer state string.
+// Each distinct string is compiled once and then replayed from StatePrograms.
 func (m *LayerManager) Deserialize(s string, pfv *PFV) (bool, error) {
-	ls := NewLayerStates(m)
-	return m.deserialize(ls, strings.Split(s, " "), pfv)
-}
-
-func (m *LayerManager) deserialize(ls *layerStates, params []string, pfv *PFV) (bool, error) {
-	for _, line := range params {
-		if len(line) < 2 {
-			continue
-		}
-		switch line[:2] {
-		case "L.":
-			if len(line) != 3 {
-				ods.ODS("unknown flip parameter: %q. skipped.", line[2:])
-				continue
-			}
-			err := ls.SetFlip(Flip(line[2] - '0'))
-			if err != nil {
-				ods.ODS("failed to apply flip. %v", err)
-				continue
-			}
-		case "V.":
-			err := ls.SetAll(line[2:])
-			if err != nil {
-				return false, fmt.Errorf("img: cannot deserialize: %w", err)
-			}
-		case "v0", "v1":
-			if len(line) < 5 || line[2] != '.' {
-				ods.ODS("unexpected format: %q. skipped.", line)
-				continue
-			}
-			ln, err := prop.Decode(line[2:])
-			if err != nil {
-				ods.ODS("%q is not a valid layer name. skipped. %v", line[2:], err)
-				continue
-			}
-			fi, ok := ls.lm.FullPath[ln]
-			if !ok {
-				ods.ODS("layer %q is not found. skipped.", ln)
-				continue
-			}
-			ls.Increment()
-			ls.setVisible(fi, line[1] == '1')
-			if line[1] == '1' {
-				// set parents too
-				for rpos := len(ln) - 1; rpos > 0; rpos-- {
-					if ln[rpos] != '/' {
-						continue
-					}
-					pfi, ok := ls.lm.FullPath[ln[:rpos]]
-					if !ok {
-						ods.ODS("layer %q is not found. skipped.", ln[:rpos])
-						break
-					}
-					ls.setVisible(pfi, true)
-				}
-			}
-		case "F.", "F_":
-			if pfv == nil {
-				ods.ODS("do not have favorite data. skipped.")
-				continue
-			}
-			s, err := prop.Decode(line[1:])
-			if err != nil {
-				ods.ODS("%q is not a valid state. skipped. %v", line[1:], err)
-				continue
-			}
-			fn, err := pfv.FindNode(s, false)
-			if err != nil {
-				ods.ODS("failed to find favorite node. %v", err)
-				continue
-			}
-			if fn == nil {
-				ods.ODS("favorite node %q not found. skipped.", s)
-				continue
-			}
-			ls.Increment()
-			if f, v := fn.RawState(); f == nil {
-				for i, visible := range v {
-					ls.setVisible(flatIndex(i), visible)
-				}
-			} else {
-				for i, pass := range f {
-					if !pass {
-						continue
-					}
-					ls.setVisible(flatIndex(i), v[i])
-				}
-			}
-		case "S.", "S_":
-			if pfv == nil {
-				ods.ODS("do not have favorite data. skipped.")
-				continue
-			}
-			s, err := prop.Decode(line[1:])
-			if err != nil {
-				ods.ODS("%q is not a valid state. skipped. %v", line[1:], err)
-				continue
-			}
-			kv := strings.Split(s, "~")
-			if len(kv) != 2 {
-				ods.ODS("unexpected format: %q. skipped. %v", s, err)
-				continue
-			}
-			fn, err := pfv.FindFaviewNode(kv[0], false)
-			if err != nil {
-				ods.ODS("failed to find faview node. %v", err)
-				continue
-			}
-			if fn == nil {
-				ods.ODS("faview node %q not found. skipped.", kv[0])
-				continue
-			}
-			idx := fn.FindItem(kv[1])
-			if idx == -1 {
-				ods.ODS("faview node item %q not found. skipped.", kv[1])
-				continue
-			}
-			ls.Increment()
-			f, v := fn.Items[idx].RawState()
-			for i, pass := range f {
-				if !pass {
-					continue
-				}
-				ls.setVisible(flatIndex(i), v[i])
-			}
-		}
+	p, err := m.StatePrograms.get(s, m, pfv)
+	if err != nil {
+		return false, err
 	}
+	ls := NewLayerStates(m)
+	p.run(ls)
 	oldFlip := m.Flip
 	modified := ls.Apply()
 	return modified || (m.Flip != oldFlip), nil
 }
 
+// Serialize returns the layer visibility as a "V." state string.
 func (m *LayerManager) Serialize() (string, error) {
+	s, err := m.SerializeWithFlip()
+	if err != nil {
+		return "", err
+	}
+	return s[strings.IndexByte(s, ' ')+1:], nil
+}
+
+// SerializeWithFlip returns the flip and layer visibility as an "L.<flip> V." state string.
+// The result is cached until version changes.
+func (m *LayerManager) SerializeWithFlip() (string, error) {
+	if m.serialized != "" && m.serializedVersion == m.version {
+		return m.serialized, nil
+	}
 	v := make([]bool, len(m.Layers))
 	for i, l := range m.Layers {
 		v[i] = l.Layer.Visible
@@ -435,7 +516,8 @@ func (m *LayerManager) Serialize() (string, error) {
 	if err != nil {
 		return "", errors.Wrap(err, "LayerManager.Serialize: failed to serialize")
 	}
-	return "V." + s, nil
+	m.serialized, m.serializedVersion = "L."+itoa(int(m.Flip))+" V."+s, m.version
+	return m.serialized, nil
 }
 
 type SerializedData struct {
@@ -460,7 +542,7 @@ func (m *LayerManager) DeserializeSafe(state map[string]SerializedData) (warn.Wa
 	for fullPath, d := range state {
 		if fi, ok := m.FullPath[fullPath]; ok {
 			l := &m.Layers[fi]
-			l.Layer.Visible = d.Visible
+			m.setLayerVisible(fi, d.Visible)
 			if l.Layer.Folder {
 				l.Layer.FolderOpen = d.FolderOpen
 			}
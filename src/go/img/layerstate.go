@@ -1,76 +1,106 @@
 package img
 
 import (
-	"encoding/binary"
 	"fmt"
+	"math/bits"
+	"sync"
 )
 
-type layerState struct {
-	Visible  bool
-	Priority int
+// bitset is a packed set of flat indices.
+type bitset []uint64
+
+func bitsetWords(n int) int {
+	return (n + 63) >> 6
+}
+
+func (b bitset) get(fi flatIndex) bool {
+	return b[fi>>6]&(1<<(uint(fi)&63)) != 0
 }
 
+func (b bitset) set(fi flatIndex, v bool) {
+	if v {
+		b[fi>>6] |= 1 << (uint(fi) & 63)
+	} else {
+		b[fi>>6] &^= 1 << (uint(fi) & 63)
+	}
+}
+
+// layerStates is a scratch copy of the layer visibility that is edited and then applied at once.
+// Only layers marked in touched can differ from the LayerManager, and priority is only valid for them.
 type layerStates struct {
-	priority int
-	flip     Flip
-	lm       *LayerManager
-	states   []layerState
+	priority   int
+	flip       Flip
+	lm         *LayerManager
+	visible    bitset
+	touched    bitset
+	priorities []int
+}
+
+var layerStatesPool = sync.Pool{
+	New: func() interface{} {
+		return &layerStates{}
+	},
 }
 
 func NewLayerStates(m *LayerManager) *layerStates {
-	ls := &layerStates{
-		flip:   m.Flip,
-		lm:     m,
-		states: make([]layerState, len(m.Layers)),
+	ls := layerStatesPool.Get().(*layerStates)
+	n, words := len(m.Layers), bitsetWords(len(m.Layers))
+	if cap(ls.visible) < words {
+		ls.visible = make(bitset, words)
+		ls.touched = make(bitset, words)
 	}
-	for fi, l := range m.Layers {
-		ls.states[fi] = layerState{
-			Visible:  l.Layer.Visible,
-			Priority: 0,
-		}
+	if cap(ls.priorities) < n {
+		ls.priorities = make([]int, n)
 	}
+	ls.visible, ls.touched, ls.priorities = ls.visible[:words], ls.touched[:words], ls.priorities[:n]
+	copy(ls.visible, m.visible)
+	for i := range ls.touched {
+		ls.touched[i] = 0
+	}
+	ls.priority = 0
+	ls.flip = m.Flip
+	ls.lm = m
 	return ls
 }
 
+// release returns ls to the pool. ls must not be used afterwards.
+func (ls *layerStates) release() {
+	ls.lm = nil
+	layerStatesPool.Put(ls)
+}
+
 func (ls *layerStates) Increment() {
 	ls.priority++
 }
 
-func (ls *layerStates) FindBySeqID(seqID SeqID) *layerState {
-	fi, ok := ls.lm.Mapped[seqID]
-	if !ok {
-		return nil
-	}
-	return &ls.states[fi]
+func (ls *layerStates) visibleAt(fi flatIndex) bool {
+	return ls.visible.get(fi)
 }
 
-func (ls *layerStates) FindByFullPath(path string) *layerState {
-	fi, ok := ls.lm.FullPath[path]
-	if !ok {
-		return nil
+func (ls *layerStates) priorityAt(fi flatIndex) int {
+	if !ls.touched.get(fi) {
+		return 0
 	}
-	return &ls.states[fi]
+	return ls.priorities[fi]
 }
 
-func copyStateRecursive(ls *layerStates, fi0 flatIndex, fi1 flatIndex) {
-	l0, l1 := &ls.lm.Layers[fi0], &ls.lm.Layers[fi1]
-	for i := range l0.Layer.Children {
-		seqID := SeqID(l0.Layer.Children[i].SeqID)
-		cfi0, ok := ls.lm.Mapped[seqID]
-		if !ok {
-			continue
-		}
-		path := l1.FullPath + ls.lm.Layers[cfi0].FullPath[len(l0.FullPath):]
-		cfi1, ok := ls.lm.FullPath[path]
-		if !ok {
-			continue
+// setState changes the visibility and priority of the layer at fi.
+func (ls *layerStates) setState(fi flatIndex, visible bool, priority int) {
+	ls.visible.set(fi, visible)
+	ls.touched.set(fi, true)
+	ls.priorities[fi] = priority
+}
+
+// copySyncs copies the visibility of every synced descendant from one side of fp to the other.
+func copySyncs(ls *layerStates, fp *flipPair, mirror bool) {
+	for _, sp := range fp.syncs {
+		src, dst := sp[0], sp[1]
+		if !mirror {
+			src, dst = dst, src
 		}
-		cs0, cs1 := &ls.states[cfi0], &ls.states[cfi1]
-		if cs1.Visible != cs0.Visible {
-			cs1.Visible = cs0.Visible
-			cs1.Priority = ls.priority
+		if v := ls.visibleAt(src); ls.visibleAt(dst) != v {
+			ls.setState(dst, v, ls.priority)
 		}
-		copyStateRecursive(ls, cfi0, cfi1)
 	}
 }
 
@@ -81,79 +111,38 @@ func intminmax(a, b int) (int, int) {
 	return a, b
 }
 
-func setFlipOne(ls *layerStates, fpMap flipPairMap, mirror bool, processed map[*flipPair]struct{}) error {
-	for _, fp := range fpMap {
-		if _, ok := processed[fp]; ok {
-			continue
-		}
-		processed[fp] = struct{}{}
-		var id0, id1 SeqID
+func setFlipOne(ls *layerStates, fps []*flipPair, mirror bool) {
+	for _, fp := range fps {
+		fi0, fi1 := ls.lm.Mapped[fp.Mirror], ls.lm.Mapped[fp.Original]
 		if mirror {
-			id0 = fp.Original
-			id1 = fp.Mirror
-		} else {
-			id0 = fp.Mirror
-			id1 = fp.Original
-		}
-		fi0, ok := ls.lm.Mapped[id0]
-		fi1, ok2 := ls.lm.Mapped[id1]
-		if !ok || !ok2 {
-			continue
+			fi0, fi1 = fi1, fi0
 		}
-		s0, s1 := &ls.states[fi0], &ls.states[fi1]
-		if !s0.Visible && !s1.Visible {
+		if !ls.visibleAt(fi0) && !ls.visibleAt(fi1) {
 			continue
 		}
-		s0.Visible, s1.Visible = false, true
-		s0.Priority, s1.Priority = intminmax(s0.Priority, s1.Priority)
-		copyStateRecursive(ls, fi0, fi1)
+		p0, p1 := intminmax(ls.priorityAt(fi0), ls.priorityAt(fi1))
+		ls.setState(fi0, false, p0)
+		ls.setState(fi1, true, p1)
+		copySyncs(ls, fp, mirror)
 	}
-
-	return nil
 }
 
 func (ls *layerStates) SetAll(serializedBits string) error {
-	buf, err := deserializeBits(serializedBits)
+	v, err := decodeAll(serializedBits, len(ls.priorities))
 	if err != nil {
-		return fmt.Errorf("img: cannot deserialize: %w", err)
-	}
-	n := int(binary.LittleEndian.Uint16(buf))
-	if len(ls.states) != n {
-		return fmt.Errorf("img: number of layers mismatch(expected %v got %v)", len(ls.states), n)
+		return err
 	}
-	i := 0
+	ls.setAll(v)
+	return nil
+}
+
+// setAll sets the visibility of every layer at once.
+func (ls *layerStates) setAll(v []bool) {
 	ls.Increment()
 	pri := ls.priority
-	for _, v := range buf[2:] {
-		if i+7 < len(ls.states) {
-			ls.states[i+0].Visible = v&0x80 != 0
-			ls.states[i+0].Priority = pri
-			ls.states[i+1].Visible = v&0x40 != 0
-			ls.states[i+1].Priority = pri
-			ls.states[i+2].Visible = v&0x20 != 0
-			ls.states[i+2].Priority = pri
-			ls.states[i+3].Visible = v&0x10 != 0
-			ls.states[i+3].Priority = pri
-			ls.states[i+4].Visible = v&0x08 != 0
-			ls.states[i+4].Priority = pri
-			ls.states[i+5].Visible = v&0x04 != 0
-			ls.states[i+5].Priority = pri
-			ls.states[i+6].Visible = v&0x02 != 0
-			ls.states[i+6].Priority = pri
-			ls.states[i+7].Visible = v&0x01 != 0
-			ls.states[i+7].Priority = pri
-			i += 8
-			continue
-		}
-		v <<= 8 - uint(len(ls.states)-i)
-		for i < len(ls.states) {
-			ls.states[i].Visible = v&0x80 != 0
-			ls.states[i].Priority = pri
-			v <<= 1
-			i++
-		}
+	for i, visible := range v {
+		ls.setState(flatIndex(i), visible, pri)
 	}
-	return nil
 }
 
 func (ls *layerStates) SetVisible(seqID SeqID, visible bool) error {
@@ -166,20 +155,13 @@ func (ls *layerStates) SetVisible(seqID SeqID, visible bool) error {
 }
 
 func (ls *layerStates) setVisible(fi flatIndex, visible bool) error {
-	s := &ls.states[fi]
-	sg, ok := ls.lm.SyncedMap[SeqID(ls.lm.Layers[fi].Layer.SeqID)]
-	if !ok {
-		s.Visible = visible
-		s.Priority = ls.priority
+	id := ls.lm.syncOf[fi]
+	if id < 0 {
+		ls.setState(fi, visible, ls.priority)
 		return nil
 	}
-	for _, seqID := range *sg {
-		ss := ls.FindBySeqID(seqID)
-		if ss == nil {
-			continue
-		}
-		ss.Visible = visible
-		ss.Priority = ls.priority
+	for _, sfi := range ls.lm.syncGroups[id] {
+		ls.setState(sfi, visible, ls.priority)
 	}
 	return nil
 }
@@ -190,15 +172,19 @@ func (ls *layerStates) SetVisibleExclusive(seqID SeqID, visible bool) error {
 		return fmt.Errorf("SeqID: %v layer not found", seqID)
 	}
 	ls.Increment()
-	l := &ls.lm.Layers[fi]
-	if isGroup(l.Layer.Name) {
+	if ls.lm.groupOf[fi] >= 0 {
 		return ls.setVisible(fi, visible)
 	}
-	for _, sib := range l.Layer.Parent.Children {
-		if isGroup(sib.Name) {
+	sib := ls.lm.firstRoot
+	if p := ls.lm.parent[fi]; p >= 0 {
+		sib = ls.lm.firstChild[p]
+	}
+	for ; sib >= 0; sib = ls.lm.nextSibling[sib] {
+		if ls.lm.groupOf[sib] >= 0 {
 			continue
 		}
-		ls.SetVisible(SeqID(sib.SeqID), seqID == SeqID(sib.SeqID) && visible)
+		ls.Increment()
+		ls.setVisible(sib, sib == fi && visible)
 	}
 	return nil
 }
@@ -208,84 +194,65 @@ func (ls *layerStates) SetFlip(flip Flip) error {
 		return fmt.Errorf("unknown flip state: %v", flip)
 	}
 	ls.Increment()
-	processed := map[*flipPair]struct{}{}
-	err := setFlipOne(ls, ls.lm.FlipXMap, flip == FlipX, processed)
-	if err != nil {
-		return err
-	}
-	err = setFlipOne(ls, ls.lm.FlipYMap, flip == FlipY, processed)
-	if err != nil {
-		return err
-	}
-	err = setFlipOne(ls, ls.lm.FlipXYMap, flip == FlipXY, processed)
-	if err != nil {
-		return err
-	}
+	setFlipOne(ls, ls.lm.flips[0], flip == FlipX)
+	setFlipOne(ls, ls.lm.flips[1], flip == FlipY)
+	setFlipOne(ls, ls.lm.flips[2], flip == FlipXY)
 	ls.flip = flip
 	return nil
 }
 
-func normalizeGroup(ls *layerStates, seqID SeqID) {
-	g, ok := ls.lm.GroupMap[seqID]
-	if !ok || len(*g) == 0 {
+func normalizeGroup(ls *layerStates, g []flatIndex) {
+	if len(g) == 0 {
 		return
 	}
 	maxPriority := -1
-	maxPriorityID := SeqID(-1)
-	for _, seqID := range *g {
-		s := ls.FindBySeqID(seqID)
-		if !s.Visible {
+	maxPriorityFI := flatIndex(-1)
+	for _, fi := range g {
+		if !ls.visibleAt(fi) {
 			continue
 		}
-		if s.Priority > maxPriority {
-			maxPriority = s.Priority
-			maxPriorityID = seqID
+		if p := ls.priorityAt(fi); p > maxPriority {
+			maxPriority = p
+			maxPriorityFI = fi
 		}
-		s.Visible = false
-		s.Priority = ls.priority
+		ls.setState(fi, false, ls.priority)
 	}
-	if maxPriorityID == SeqID(-1) {
-		maxPriorityID = (*g)[len(*g)-1]
-	}
-	s := ls.FindBySeqID(maxPriorityID)
-	if s != nil {
-		s.Visible = true
-		s.Priority = ls.priority
+	if maxPriorityFI < 0 {
+		maxPriorityFI = g[len(g)-1]
 	}
+	ls.setState(maxPriorityFI, true, ls.priority)
 }
 
 func normalize(ls *layerStates) {
 	ls.Increment()
-	for seqID := range ls.lm.ForceVisible {
-		s := ls.FindBySeqID(seqID)
-		s.Visible = true
-		s.Priority = ls.priority
+	for _, fi := range ls.lm.forceVisible {
+		ls.setState(fi, true, ls.priority)
 	}
 	ls.Increment()
-	processedGroup := map[*group]struct{}{}
-	for seqID, g := range ls.lm.GroupMap {
-		if _, ok := processedGroup[g]; ok {
-			continue
-		}
-		normalizeGroup(ls, seqID)
-		processedGroup[g] = struct{}{}
+	for _, g := range ls.lm.groups {
+		normalizeGroup(ls, g)
 	}
 	ls.Increment()
 	ls.SetFlip(ls.flip)
 }
 
+// Apply normalizes the states and writes them back to the LayerManager.
+// Only touched layers are compared, and each layer that actually changed is marked dirty in the renderer.
+// ls is released and must not be used afterwards.
 func (ls *layerStates) Apply() bool {
 	normalize(ls)
 	modified := false
-	for fi := range ls.lm.Layers {
-		dstate := &ls.states[fi]
-		l := &ls.lm.Layers[fi]
-		if l.Layer.Visible != dstate.Visible {
-			l.Layer.Visible = dstate.Visible
-			modified = true
-			ls.lm.Renderer.SetDirtyByLayer(l.Layer)
+	for w, t := range ls.touched {
+		for t != 0 {
+			fi := flatIndex(w<<6 + bits.TrailingZeros64(t))
+			t &= t - 1
+			if ls.lm.setLayerVisible(fi, ls.visibleAt(fi)) {
+				modified = true
+				ls.lm.Renderer.SetDirtyByLayer(ls.lm.Layers[fi].Layer)
+			}
 		}
 	}
-	ls.lm.Flip = ls.flip
+	ls.lm.setFlip(ls.flip)
+	ls.release()
 	return modified
 }
@@ -385,3 +385,164 @@ func TestFlipX2(t *testing.T) {
 	}
 	verifyNew(t, lm, testData)
 }
+
+func TestVisibilityDigest(t *testing.T) {
+	lm, err := loadTestFile()
+	if err != nil {
+		t.Fatal("failed to load test file.")
+	}
+	recompute := func() uint64 {
+		var d uint64
+		for fi, l := range lm.Layers {
+			if l.Layer.Visible {
+				d ^= visibleKey(flatIndex(fi))
+			}
+		}
+		return d
+	}
+	d0 := lm.VisibilityDigest()
+	if d0 != recompute() {
+		t.Fatalf("initial digest mismatch")
+	}
+	if !lm.SetVisibleExclusive(SeqID(lm.FindLayerByFullPath("!folder/c2").Layer.SeqID), true) {
+		t.Fatalf("expected a change")
+	}
+	if d := lm.VisibilityDigest(); d == d0 || d != recompute() {
+		t.Errorf("digest not updated: %016x", d)
+	}
+	lm.SetVisibleExclusive(SeqID(lm.FindLayerByFullPath("!folder/c1").Layer.SeqID), true)
+	if d := lm.VisibilityDigest(); d != d0 {
+		t.Errorf("expected %016x got %016x", d0, d)
+	}
+}
+
+func TestSerializeCache(t *testing.T) {
+	lm, err := loadTestFile()
+	if err != nil {
+		t.Fatal("failed to load test file.")
+	}
+	s0, err := lm.Serialize()
+	if err != nil {
+		t.Fatal(err)
+	}
+	v0 := lm.Version()
+	if lm.Normalize() || lm.Version() != v0 {
+		t.Errorf("version changed without a visibility change")
+	}
+	lm.SetVisibleExclusive(SeqID(lm.FindLayerByFullPath("!folder/c2").Layer.SeqID), true)
+	if lm.Version() == v0 {
+		t.Errorf("version not updated")
+	}
+	s1, err := lm.Serialize()
+	if err != nil {
+		t.Fatal(err)
+	}
+	if s1 == s0 {
+		t.Errorf("serialized state not updated")
+	}
+	if _, err = lm.Deserialize(s0, nil); err != nil {
+		t.Fatal(err)
+	}
+	if s, _ := lm.Serialize(); s != s0 {
+		t.Errorf("expected %q got %q", s0, s)
+	}
+	lm.SetFlip(FlipX)
+	sf, err := lm.SerializeWithFlip()
+	if err != nil {
+		t.Fatal(err)
+	}
+	if s, _ := lm.Serialize(); sf != "L.1 "+s {
+		t.Errorf("expected %q got %q", "L.1 "+s, sf)
+	}
+}
+
+func TestVisibleBitset(t *testing.T) {
+	lm, err := loadTestFile()
+	if err != nil {
+		t.Fatal("failed to load test file.")
+	}
+	verify := func(step string) {
+		for fi, l := range lm.Layers {
+			if lm.visible.get(flatIndex(fi)) != l.Layer.Visible {
+				t.Errorf("%s: layer %q expected %v", step, l.FullPath, l.Layer.Visible)
+			}
+		}
+	}
+	verify("load")
+	lm.SetVisible(SeqID(lm.FindLayerByFullPath("!folder:flipx/c2").Layer.SeqID), true)
+	verify("SetVisible")
+	lm.SetFlip(FlipX)
+	verify("SetFlip")
+	lm.SetVisibleExclusive(SeqID(lm.FindLayerByFullPath("!folder/c1").Layer.SeqID), true)
+	verify("SetVisibleExclusive")
+}
+
+func TestLayerIndex(t *testing.T) {
+	lm, err := loadTestFile()
+	if err != nil {
+		t.Fatal("failed to load test file.")
+	}
+	for fi, l := range lm.Layers {
+		var children []flatIndex
+		for c := lm.firstChild[fi]; c >= 0; c = lm.nextSibling[c] {
+			if lm.parent[c] != flatIndex(fi) {
+				t.Errorf("layer %q: wrong parent", lm.Layers[c].FullPath)
+			}
+			children = append(children, c)
+		}
+		if len(children) != len(l.Layer.Children) {
+			t.Fatalf("layer %q: want %d children got %d", l.FullPath, len(l.Layer.Children), len(children))
+		}
+		for i, c := range children {
+			if lm.Layers[c].Layer != &l.Layer.Children[i] {
+				t.Errorf("layer %q: child #%d mismatch", l.FullPath, i)
+			}
+		}
+		if g, ok := lm.SyncedMap[SeqID(l.Layer.SeqID)]; ok {
+			id := lm.syncOf[fi]
+			if id < 0 {
+				t.Errorf("layer %q: not synced", l.FullPath)
+				continue
+			}
+			for i, sfi := range lm.syncGroups[id] {
+				if lm.Mapped[(*g)[i]] != sfi {
+					t.Errorf("layer %q: synced group mismatch", l.FullPath)
+				}
+			}
+		}
+	}
+}
+
+func TestLayerManagerWithTopology(t *testing.T) {
+	file, err := os.Open("testdata/test.psd")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer file.Close()
+	tree, err := composite.New(context.Background(), file, &composite.Options{})
+	if err != nil {
+		t.Fatal(err)
+	}
+	lm0 := NewLayerManager(tree)
+	lm1 := NewLayerManagerWithTopology(tree.Clone(), lm0.LayerTopology)
+	if lm1.LayerTopology != lm0.LayerTopology {
+		t.Fatal("topology not shared")
+	}
+	if len(lm1.Layers) != len(lm0.Layers) {
+		t.Fatalf("want %d layers got %d", len(lm0.Layers), len(lm1.Layers))
+	}
+	for fi := range lm0.Layers {
+		l0, l1 := &lm0.Layers[fi], &lm1.Layers[fi]
+		if l0.FullPath != l1.FullPath || l0.Layer.SeqID != l1.Layer.SeqID || l0.Layer == l1.Layer {
+			t.Errorf("#%d: layer mismatch %q %q", fi, l0.FullPath, l1.FullPath)
+		}
+	}
+	s0, _ := lm0.Serialize()
+	if s1, _ := lm1.Serialize(); s1 != s0 {
+		t.Errorf("expected %q got %q", s0, s1)
+	}
+	lm1.SetVisibleExclusive(SeqID(lm1.FindLayerByFullPath("!folder/c2").Layer.SeqID), true)
+	if s, _ := lm0.Serialize(); s != s0 {
+		t.Errorf("original changed by the clone: %q", s)
+	}
+}
@@ -0,0 +1,62 @@
+package img
+
+import (
+	"image"
+)
+
+// maxMipLevels limits the pyramid to 1/256 of the canvas size.
+const maxMipLevels = 8
+
+// mipPyramid holds power-of-two downscaled copies of the canvas for one quality.
+//
+// Every scale below 1/2 is downscaled from its level rather than from the canvas.
+// Levels are built from the canvas on first use and then kept up to date from dirty
+// tiles, so when the scale keeps changing only the nearest larger level has to be
+// downscaled instead of the whole canvas.
+type mipPyramid struct {
+	levels  [maxMipLevels]*image.NRGBA
+	pending [maxMipLevels]map[image.Point]struct{}
+}
+
+// mipLevelScale returns the scale of level n relative to the canvas, 1/2 for level 0.
+func mipLevelScale(n int) float64 {
+	return 1 / float64(uint(2)<<uint(n))
+}
+
+// mipLevel returns the smallest level that is still at least as large as scale,
+// or -1 when scale needs the canvas itself.
+func mipLevel(scale float64) int {
+	n := -1
+	for n+1 < maxMipLevels && mipLevelScale(n+1) >= scale {
+		n++
+	}
+	return n
+}
+
+// invalidate marks tiles as dirty on every level built so far.
+func (p *mipPyramid) invalidate(tiles []image.Point) {
+	for i, l := range p.levels {
+		if l == nil {
+			continue
+		}
+		if p.pending[i] == nil {
+			p.pending[i] = make(map[image.Point]struct{}, len(tiles))
+		}
+		for _, t := range tiles {
+			p.pending[i][t] = struct{}{}
+		}
+	}
+}
+
+// takePending returns and clears the dirty tiles of level n.
+func (p *mipPyramid) takePending(n int) []image.Point {
+	if len(p.pending[n]) == 0 {
+		return nil
+	}
+	tiles := make([]image.Point, 0, len(p.pending[n]))
+	for t := range p.pending[n] {
+		tiles = append(tiles, t)
+	}
+	p.pending[n] = nil
+	return tiles
+}
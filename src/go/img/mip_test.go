@@ -0,0 +1,92 @@
+package img
+
+import (
+	"bytes"
+	"context"
+	"image"
+	"os"
+	"testing"
+
+	"github.com/oov/psd/composite"
+)
+
+func TestMipLevel(t *testing.T) {
+	testData := []struct {
+		Scale float64
+		Want  int
+	}{
+		{Scale: 0.9, Want: -1},
+		{Scale: 0.5, Want: 0},
+		{Scale: 0.3, Want: 0},
+		{Scale: 0.25, Want: 1},
+		{Scale: 0.2, Want: 1},
+		{Scale: 0.1, Want: 2},
+		{Scale: 0.001, Want: maxMipLevels - 1},
+	}
+	for i, data := range testData {
+		if got := mipLevel(data.Scale); got != data.Want {
+			t.Errorf("#%d: want %d got %d", i, data.Want, got)
+		}
+	}
+}
+
+func TestMipPyramidInvalidate(t *testing.T) {
+	var p mipPyramid
+	p.invalidate([]image.Point{{0, 0}})
+	if p.takePending(0) != nil {
+		t.Errorf("levels not built yet must not collect tiles")
+	}
+
+	p.levels[1] = image.NewNRGBA(image.Rect(0, 0, 1, 1))
+	p.invalidate([]image.Point{{0, 0}, {1, 0}})
+	p.invalidate([]image.Point{{1, 0}})
+	if got := p.takePending(1); len(got) != 2 {
+		t.Errorf("want 2 tiles got %v", got)
+	}
+	if got := p.takePending(1); got != nil {
+		t.Errorf("want no tiles after take got %v", got)
+	}
+}
+
+func newTestImage(t *testing.T) *Image {
+	file, err := os.Open("testdata/test.psd")
+	if err != nil {
+		t.Fatal(err)
+	}
+	defer file.Close()
+	tree, err := composite.New(context.Background(), file, &composite.Options{})
+	if err != nil {
+		t.Fatal(err)
+	}
+	return &Image{PSD: tree, Layers: NewLayerManager(tree), Scale: 1}
+}
+
+func TestRenderScaleIndependentOfHistory(t *testing.T) {
+	ctx := context.Background()
+	for _, quality := range []ScaleQuality{ScaleQualityFast, ScaleQualityBeautiful} {
+		// im0 builds its levels first and gets the visibility change as dirty tiles
+		im0 := newTestImage(t)
+		for _, scale := range []float64{0.3, 0.2} {
+			if _, err := im0.RenderWithScale(ctx, scale, quality, false); err != nil {
+				t.Fatal(err)
+			}
+			if scale == 0.3 {
+				im0.Layers.SetVisibleExclusive(SeqID(im0.Layers.FindLayerByFullPath("!folder/c2").Layer.SeqID), true)
+			}
+		}
+		got, err := im0.RenderWithScale(ctx, 0.3, quality, false)
+		if err != nil {
+			t.Fatal(err)
+		}
+
+		im1 := newTestImage(t)
+		im1.Layers.SetVisibleExclusive(SeqID(im1.Layers.FindLayerByFullPath("!folder/c2").Layer.SeqID), true)
+		want, err := im1.RenderWithScale(ctx, 0.3, quality, false)
+		if err != nil {
+			t.Fatal(err)
+		}
+		if got.Rect != want.Rect || !bytes.Equal(got.Pix, want.Pix) {
+			t.Errorf("quality %d: output depends on the scales rendered before", quality)
+		}
+	}
+}
@@ -30,3 +30,41 @@ func TestSerializeBits(t *testing.T) {
 		}
 	}
 }
+
+func TestDecodeAll(t *testing.T) {
+	for _, testData := range serializeBitsTestData {
+		got, err := decodeAll(testData.Want, len(testData.Visibility))
+		if err != nil {
+			t.Errorf("decodeAll(%q): error %v", testData.Want, err)
+			continue
+		}
+		for i := range got {
+			if got[i] != testData.Visibility[i] {
+				t.Errorf("decodeAll(%q) == %v, want %v", testData.Want, got, testData.Visibility)
+				break
+			}
+		}
+	}
+	for n := 0; n < 40; n++ {
+		v := make([]bool, n)
+		for i := range v {
+			v[i] = (i*7+n)%3 == 0
+		}
+		s, err := serializeBits(v)
+		if err != nil {
+			t.Fatal(err)
+		}
+		got, err := decodeAll(s, n)
+		if err != nil {
+			t.Fatal(err)
+		}
+		for i := range v {
+			if got[i] != v[i] {
+				t.Errorf("%d bits: bit %d differs", n, i)
+			}
+		}
+	}
+	if _, err := decodeAll(serializeBitsTestData[1].Want, 2); err == nil {
+		t.Errorf("expected a layer count mismatch error")
+	}
+}
@@ -0,0 +1,248 @@
+package img
+
+import (
+	"encoding/binary"
+	"fmt"
+	"strings"
+	"sync"
+
+	"psdtoolkit/img/prop"
+	"psdtoolkit/ods"
+)
+
+type stateOpKind int
+
+const (
+	stateOpFlip stateOpKind = iota
+	stateOpAll
+	stateOpSet
+)
+
+type stateEntry struct {
+	fi      flatIndex
+	visible bool
+}
+
+// stateOp is one token of a layer state string with names, favorites and encoded bits already resolved.
+type stateOp struct {
+	kind    stateOpKind
+	flip    Flip
+	all     []bool
+	entries []stateEntry
+}
+
+// stateProgram is a compiled layer state string. Running it on layerStates has the
+// same effect as parsing the string token by token.
+type stateProgram []stateOp
+
+// maxStatePrograms bounds the memo; Lua tends to send the same few dozen strings.
+const maxStatePrograms = 1024
+
+// StatePrograms memoizes compiled layer state strings.
+//
+// A compiled program only depends on the layer tree and favorites, so one StatePrograms
+// can be shared by every LayerManager built from the same file. It is safe for concurrent use.
+type StatePrograms struct {
+	m     sync.Mutex
+	progs map[string]stateProgram
+}
+
+func NewStatePrograms() *StatePrograms {
+	return &StatePrograms{progs: map[string]stateProgram{}}
+}
+
+// get returns the program for s, compiling and remembering it on first use.
+func (sp *StatePrograms) get(s string, m *LayerManager, pfv *PFV) (stateProgram, error) {
+	sp.m.Lock()
+	p, ok := sp.progs[s]
+	sp.m.Unlock()
+	if ok {
+		return p, nil
+	}
+	p, err := compileState(m, strings.Split(s, " "), pfv)
+	if err != nil {
+		return nil, err
+	}
+	sp.m.Lock()
+	if len(sp.progs) >= maxStatePrograms {
+		sp.progs = map[string]stateProgram{}
+	}
+	sp.progs[s] = p
+	sp.m.Unlock()
+	return p, nil
+}
+
+func (p stateProgram) run(ls *layerStates) {
+	for i := range p {
+		op := &p[i]
+		switch op.kind {
+		case stateOpFlip:
+			if err := ls.SetFlip(op.flip); err != nil {
+				ods.ODS("failed to apply flip. %v", err)
+			}
+		case stateOpAll:
+			ls.setAll(op.all)
+		case stateOpSet:
+			ls.Increment()
+			for _, e := range op.entries {
+				ls.setVisible(e.fi, e.visible)
+			}
+		}
+	}
+}
+
+// decodeAll decodes the bits of a "V." token for a tree of n layers.
+func decodeAll(serializedBits string, n int) ([]bool, error) {
+	buf, err := deserializeBits(serializedBits)
+	if err != nil {
+		return nil, fmt.Errorf("img: cannot deserialize: %w", err)
+	}
+	if len(buf) < 2 {
+		return nil, fmt.Errorf("img: cannot deserialize: too short")
+	}
+	if got := int(binary.LittleEndian.Uint16(buf)); got != n {
+		return nil, fmt.Errorf("img: number of layers mismatch(expected %v got %v)", n, got)
+	}
+	if len(buf) < 2+(n+7)/8 {
+		return nil, fmt.Errorf("img: cannot deserialize: too short")
+	}
+	v := make([]bool, n)
+	full := n &^ 7
+	for i := 0; i < full; i++ {
+		v[i] = buf[2+i/8]&(0x80>>uint(i&7)) != 0
+	}
+	// The last partial byte holds its bits in the low end
+	for i, rem := full, uint(n-full); i < n; i++ {
+		v[i] = buf[2+i/8]>>(rem-1-uint(i&7))&1 != 0
+	}
+	return v, nil
+}
+
+func compileState(m *LayerManager, params []string, pfv *PFV) (stateProgram, error) {
+	var p stateProgram
+	for _, line := range params {
+		if len(line) < 2 {
+			continue
+		}
+		switch line[:2] {
+		case "L.":
+			if len(line) != 3 {
+				ods.ODS("unknown flip parameter: %q. skipped.", line[2:])
+				continue
+			}
+			flip := Flip(line[2] - '0')
+			if flip != FlipNone && flip != FlipX && flip != FlipY && flip != FlipXY {
+				ods.ODS("failed to apply flip. unknown flip state: %v", flip)
+				continue
+			}
+			p = append(p, stateOp{kind: stateOpFlip, flip: flip})
+		case "V.":
+			v, err := decodeAll(line[2:], len(m.Layers))
+			if err != nil {
+				return nil, fmt.Errorf("img: cannot deserialize: %w", err)
+			}
+			p = append(p, stateOp{kind: stateOpAll, all: v})
+		case "v0", "v1":
+			if len(line) < 5 || line[2] != '.' {
+				ods.ODS("unexpected format: %q. skipped.", line)
+				continue
+			}
+			ln, err := prop.Decode(line[2:])
+			if err != nil {
+				ods.ODS("%q is not a valid layer name. skipped. %v", line[2:], err)
+				continue
+			}
+			fi, ok := m.FullPath[ln]
+			if !ok {
+				ods.ODS("layer %q is not found. skipped.", ln)
+				continue
+			}
+			visible := line[1] == '1'
+			op := stateOp{kind: stateOpSet, entries: []stateEntry{{fi, visible}}}
+			if visible {
+				// set parents too
+				for rpos := len(ln) - 1; rpos > 0; rpos-- {
+					if ln[rpos] != '/' {
+						continue
+					}
+					pfi, ok := m.FullPath[ln[:rpos]]
+					if !ok {
+						ods.ODS("layer %q is not found. skipped.", ln[:rpos])
+						break
+					}
+					op.entries = append(op.entries, stateEntry{pfi, true})
+				}
+			}
+			p = append(p, op)
+		case "F.", "F_":
+			if pfv == nil {
+				ods.ODS("do not have favorite data. skipped.")
+				continue
+			}
+			s, err := prop.Decode(line[1:])
+			if err != nil {
+				ods.ODS("%q is not a valid state. skipped. %v", line[1:], err)
+				continue
+			}
+			fn, err := pfv.FindNode(s, false)
+			if err != nil {
+				ods.ODS("failed to find favorite node. %v", err)
+				continue
+			}
+			if fn == nil {
+				ods.ODS("favorite node %q not found. skipped.", s)
+				continue
+			}
+			f, v := fn.RawState()
+			p = append(p, stateOp{kind: stateOpSet, entries: favoriteEntries(f, v)})
+		case "S.", "S_":
+			if pfv == nil {
+				ods.ODS("do not have favorite data. skipped.")
+				continue
+			}
+			s, err := prop.Decode(line[1:])
+			if err != nil {
+				ods.ODS("%q is not a valid state. skipped. %v", line[1:], err)
+				continue
+			}
+			kv := strings.Split(s, "~")
+			if len(kv) != 2 {
+				ods.ODS("unexpected format: %q. skipped. %v", s, err)
+				continue
+			}
+			fn, err := pfv.FindFaviewNode(kv[0], false)
+			if err != nil {
+				ods.ODS("failed to find faview node. %v", err)
+				continue
+			}
+			if fn == nil {
+				ods.ODS("faview node %q not found. skipped.", kv[0])
+				continue
+			}
+			idx := fn.FindItem(kv[1])
+			if idx == -1 {
+				ods.ODS("faview node item %q not found. skipped.", kv[1])
+				continue
+			}
+			f, v := fn.Items[idx].RawState()
+			if f == nil {
+				// Unlike favorites, a faview item without a filter sets nothing
+				f = make([]bool, len(v))
+			}
+			p = append(p, stateOp{kind: stateOpSet, entries: favoriteEntries(f, v)})
+		}
+	}
+	return p, nil
+}
+
+// favoriteEntries returns the layers a favorite sets. A nil filter selects every layer.
+func favoriteEntries(filter, visibility []bool) []stateEntry {
+	var entries []stateEntry
+	for i, visible := range visibility {
+		if filter != nil && !filter[i] {
+			continue
+		}
+		entries = append(entries, stateEntry{flatIndex(i), visible})
+	}
+	return entries
+}
@@ -0,0 +1,88 @@
+package img
+
+import (
+	"context"
+	"image"
+	"runtime"
+	"sort"
+	"sync"
+)
+
+// tileBands removes duplicate tiles and splits the rest into at most n bands.
+// Each band holds whole tile rows in top to bottom order.
+func tileBands(tiles []image.Point, n int) [][]image.Point {
+	seen := make(map[image.Point]struct{}, len(tiles))
+	sorted := make([]image.Point, 0, len(tiles))
+	for _, t := range tiles {
+		if _, ok := seen[t]; ok {
+			continue
+		}
+		seen[t] = struct{}{}
+		sorted = append(sorted, t)
+	}
+	sort.Slice(sorted, func(i, j int) bool {
+		if sorted[i].Y != sorted[j].Y {
+			return sorted[i].Y < sorted[j].Y
+		}
+		return sorted[i].X < sorted[j].X
+	})
+	if n < 1 {
+		n = 1
+	}
+	per := (len(sorted) + n - 1) / n
+	var bands [][]image.Point
+	start := 0
+	for i := 1; i <= len(sorted); i++ {
+		if i == len(sorted) || (i-start >= per && sorted[i].Y != sorted[i-1].Y) {
+			bands = append(bands, sorted[start:i])
+			start = i
+		}
+	}
+	return bands
+}
+
+// downscalePartial runs fn over the dirty tiles on up to GOMAXPROCS goroutines.
+//
+// Bands that touch each other may write the same destination row where they meet,
+// so even and odd bands are processed in two separate passes. This only holds while
+// a tile row covers at least two destination rows; below that all tiles go to a single call.
+func downscalePartial(ctx context.Context, tiles []image.Point, tileSize int, scale float64, fn func(ctx context.Context, tiles []image.Point) error) error {
+	workers := runtime.GOMAXPROCS(0)
+	if workers < 2 || float64(tileSize)*scale < 2 {
+		return fn(ctx, tiles)
+	}
+	bands := tileBands(tiles, workers*2)
+	if len(bands) < 3 {
+		var all []image.Point
+		for _, b := range bands {
+			all = append(all, b...)
+		}
+		return fn(ctx, all)
+	}
+
+	ctx, cancel := context.WithCancel(ctx)
+	defer cancel()
+	errs := make([]error, len(bands))
+	for pass := 0; pass < 2; pass++ {
+		if err := ctx.Err(); err != nil {
+			return err
+		}
+		var wg sync.WaitGroup
+		for i := pass; i < len(bands); i += 2 {
+			wg.Add(1)
+			go func(i int) {
+				defer wg.Done()
+				if errs[i] = fn(ctx, bands[i]); errs[i] != nil {
+					cancel()
+				}
+			}(i)
+		}
+		wg.Wait()
+		for _, err := range errs {
+			if err != nil {
+				return err
+			}
+		}
+	}
+	return nil
+}
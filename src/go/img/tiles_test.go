@@ -0,0 +1,84 @@
+package img
+
+import (
+	"context"
+	"errors"
+	"image"
+	"runtime"
+	"sync"
+	"testing"
+)
+
+func TestTileBands(t *testing.T) {
+	var tiles []image.Point
+	for y := 0; y < 8; y++ {
+		for x := 0; x < 3; x++ {
+			tiles = append(tiles, image.Pt(x, y))
+		}
+	}
+	tiles = append(tiles, image.Pt(1, 2), image.Pt(0, 7))
+
+	bands := tileBands(tiles, 4)
+	if len(bands) != 4 {
+		t.Fatalf("want 4 bands got %d", len(bands))
+	}
+	n := 0
+	lastY := -1
+	for i, b := range bands {
+		n += len(b)
+		if b[0].Y <= lastY {
+			t.Errorf("band #%d: row %d is split or out of order", i, b[0].Y)
+		}
+		lastY = b[len(b)-1].Y
+	}
+	if n != 24 {
+		t.Errorf("want 24 tiles got %d", n)
+	}
+}
+
+func TestDownscalePartial(t *testing.T) {
+	defer runtime.GOMAXPROCS(runtime.GOMAXPROCS(4))
+
+	var tiles []image.Point
+	for y := 0; y < 16; y++ {
+		for x := 0; x < 4; x++ {
+			tiles = append(tiles, image.Pt(x, y))
+		}
+	}
+
+	var m sync.Mutex
+	active := map[int]bool{}
+	done := 0
+	err := downscalePartial(context.Background(), tiles, 64, 0.5, func(ctx context.Context, band []image.Point) error {
+		top, bottom := band[0].Y, band[len(band)-1].Y
+		m.Lock()
+		for y := range active {
+			if y == top-1 || y == bottom+1 {
+				t.Errorf("rows %d-%d run next to row %d", top, bottom, y)
+			}
+		}
+		active[top], active[bottom] = true, true
+		m.Unlock()
+		runtime.Gosched()
+		m.Lock()
+		delete(active, top)
+		delete(active, bottom)
+		done += len(band)
+		m.Unlock()
+		return nil
+	})
+	if err != nil {
+		t.Fatal(err)
+	}
+	if done != len(tiles) {
+		t.Errorf("want %d tiles got %d", len(tiles), done)
+	}
+
+	want := errors.New("failed")
+	err = downscalePartial(context.Background(), tiles, 64, 0.5, func(ctx context.Context, band []image.Point) error {
+		return want
+	})
+	if err != want {
+		t.Errorf("want %v got %v", want, err)
+	}
+}
@@ -312,6 +312,9 @@ type serializeRoot struct {
 	Version       int             `json:"version"`
 	SplitterWidth float32         `json:"splitterWidth,omitempty"`
 	Images        []serializeData `json:"images"`
+	// Files lists every PSD loaded when the project was saved, including the ones
+	// only used by the timeline, so they can be prefetched when the project is opened.
+	Files []string `json:"files,omitempty"`
 }
 
 func (ed *Editing) serialize() (string, error) {
@@ -338,6 +341,7 @@ func (ed *Editing) serialize() (string, error) {
 		Version:       1,
 		SplitterWidth: ed.SplitterWidth,
 		Images:        images,
+		Files:         ed.srcs.Paths(),
 	}
 
 	b := bytes.NewBufferString("")
@@ -366,6 +370,7 @@ func (ed *Editing) deserialize(state string) error {
 		// New format
 		srz = root.Images
 		ed.SplitterWidth = root.SplitterWidth
+		ed.srcs.Prefetch(root.Files)
 	} else {
 		// Legacy format: the JSON is an array, not an object
 		// Re-decode as legacy format
@@ -0,0 +1,91 @@
+package source
+
+import (
+	"runtime/debug"
+	"syscall"
+	"unsafe"
+
+	"github.com/pkg/errors"
+)
+
+// mappedFile is a read-only view of a whole file.
+type mappedFile struct {
+	h    syscall.Handle
+	hMap syscall.Handle
+	addr uintptr
+	Data []byte
+}
+
+// mapFile opens name and maps it into memory. Empty files cannot be mapped and return an error.
+//
+// The file is opened without FILE_SHARE_WRITE and FILE_SHARE_DELETE and stays open
+// until Close, so it cannot be rewritten, truncated or replaced under the view.
+// It fails if another program already has the file open for writing.
+func mapFile(name string) (*mappedFile, error) {
+	p, err := syscall.UTF16PtrFromString(name)
+	if err != nil {
+		return nil, err
+	}
+	h, err := syscall.CreateFile(p, syscall.GENERIC_READ, syscall.FILE_SHARE_READ, nil, syscall.OPEN_EXISTING, syscall.FILE_ATTRIBUTE_NORMAL, 0)
+	if err != nil {
+		return nil, errors.Wrap(err, "source: CreateFile failed")
+	}
+	m := &mappedFile{h: h}
+	var st syscall.ByHandleFileInformation
+	if err = syscall.GetFileInformationByHandle(h, &st); err != nil {
+		m.Close()
+		return nil, errors.Wrap(err, "source: GetFileInformationByHandle failed")
+	}
+	size := int64(st.FileSizeHigh)<<32 | int64(st.FileSizeLow)
+	if size <= 0 || int64(int(size)) != size {
+		m.Close()
+		return nil, errors.New("source: file size not mappable")
+	}
+	m.hMap, err = syscall.CreateFileMapping(h, nil, syscall.PAGE_READONLY, 0, 0, nil)
+	if err != nil {
+		m.Close()
+		return nil, errors.Wrap(err, "source: CreateFileMapping failed")
+	}
+	m.addr, err = syscall.MapViewOfFile(m.hMap, syscall.FILE_MAP_READ, 0, 0, 0)
+	if err != nil {
+		m.Close()
+		return nil, errors.Wrap(err, "source: MapViewOfFile failed")
+	}
+	m.Data = unsafe.Slice((*byte)(unsafe.Pointer(m.addr)), int(size))
+	return m, nil
+}
+
+// guardFault runs fn and returns a memory fault raised on this goroutine, such as
+// an in-page error from a mapped file on a network drive that went away, as an error.
+func guardFault(fn func() error) (err error) {
+	defer debug.SetPanicOnFault(debug.SetPanicOnFault(true))
+	defer func() {
+		e := recover()
+		if e == nil {
+			return
+		}
+		if re, ok := e.(interface{ Addr() uintptr }); ok {
+			err = errors.Errorf("source: memory fault at %#x while reading the file", re.Addr())
+			return
+		}
+		panic(e)
+	}()
+	return fn()
+}
+
+// Close unmaps the view. Data must not be used afterwards.
+func (m *mappedFile) Close() {
+	m.Data = nil
+	if m.addr != 0 {
+		syscall.UnmapViewOfFile(m.addr)
+		m.addr = 0
+	}
+	if m.hMap != 0 {
+		syscall.CloseHandle(m.hMap)
+		m.hMap = 0
+	}
+	if m.h != 0 {
+		syscall.CloseHandle(m.h)
+		m.h = 0
+	}
+}
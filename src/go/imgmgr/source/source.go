@@ -1,20 +1,25 @@
 package source
 
 import (
+	"bytes"
 	"context"
 	"fmt"
 	"hash/fnv"
 	"io"
 	"os"
 	"path/filepath"
+	"runtime"
+	"sort"
 	"strings"
 	"sync"
+	"sync/atomic"
 	"time"
 
 	"github.com/oov/psd/composite"
 	"github.com/pkg/errors"
 
 	"psdtoolkit/img"
+	"psdtoolkit/keyqueue"
 	"psdtoolkit/warn"
 )
 
@@ -26,16 +31,23 @@ type Logger interface {
 // Source keeps initial state of the image.
 //
 // When editing an image, do it on the Image instance that duplicated Source.
+// A Source is kept loaded for as long as any Image made from it is still
+// reachable, so a file in use is not decoded again by the next NewImage.
+// Each Image still works on its own composite.Tree.Clone of PSD.
 type Source struct {
 	m          sync.Mutex
 	lastAccess time.Time
+	images     int32 // number of reachable Images created by NewImage
 
 	FilePath string
-	FileHash uint32
+	FileHash uint64
 
 	PSD *composite.Tree
 	PFV *img.PFV
 
+	// Topology is shared by the LayerManager of every Image made from this Source.
+	Topology *img.LayerTopology
+
 	InitialLayerState string
 }
 
@@ -56,8 +68,19 @@ func (src *Source) LastAccess() time.Time {
 type Sources struct {
 	m           sync.Mutex
 	srcs        map[string]*Source
+	loading     map[string]*pendingLoad
 	ProjectPath string
 	Logger      Logger
+	// Queue runs Prefetch loads. It should be the queue that renders images
+	// so that prefetching only uses workers that rendering leaves free.
+	Queue *keyqueue.KeyQueue
+}
+
+// pendingLoad lets callers that ask for a file already being loaded wait for that load.
+type pendingLoad struct {
+	done chan struct{}
+	src  *Source
+	err  error
 }
 
 func (s *Sources) openFallback(filePath string) (*os.File, error) {
@@ -77,17 +100,45 @@ func (s *Sources) load(filePath string) (*Source, error) {
 	}
 	defer f.Close()
 
-	hash := fnv.New32a()
-	if _, err = io.Copy(hash, f); err != nil {
-		return nil, errors.Wrap(err, "source: hash calculation failed")
-	}
-	if _, err = f.Seek(0, os.SEEK_SET); err != nil {
-		return nil, errors.Wrap(err, "source: cannot seek")
+	// The file is read only once. A mapped view is hashed on another goroutine
+	// while the decoder parses it, otherwise the decoder's reads are hashed as
+	// they pass through. Both run under guardFault so that a view that becomes
+	// unreadable fails the load instead of the process.
+	hash := fnv.New64a()
+	var r io.Reader
+	var hashed chan error
+	if m, err := mapFile(f.Name()); err == nil {
+		defer m.Close()
+		r = bytes.NewReader(m.Data)
+		hashed = make(chan error, 1)
+		go func() {
+			hashed <- guardFault(func() error {
+				hash.Write(m.Data)
+				return nil
+			})
+		}()
+	} else {
+		r = io.TeeReader(f, hash)
 	}
 
-	root, err := composite.New(context.Background(), f, &composite.Options{
-		LayerNameEncodingDetector: autoDetect,
+	var root *composite.Tree
+	err = guardFault(func() (err error) {
+		root, err = composite.New(context.Background(), r, &composite.Options{
+			LayerNameEncodingDetector: autoDetect,
+		})
+		return err
 	})
+	if hashed != nil {
+		// The view is unmapped on return, so the hash must finish first
+		if herr := <-hashed; herr != nil && err == nil {
+			return nil, errors.Wrap(herr, "source: hash calculation failed")
+		}
+	} else if err == nil {
+		// The decoder may stop before the end of the file
+		if _, err = io.Copy(hash, f); err != nil {
+			return nil, errors.Wrap(err, "source: hash calculation failed")
+		}
+	}
 	if err != nil {
 		return nil, errors.Wrap(err, "source: could not build the layer tree.")
 	}
@@ -123,32 +174,102 @@ func (s *Sources) load(filePath string) (*Source, error) {
 		lastAccess: time.Now(),
 
 		FilePath: filePath,
-		FileHash: hash.Sum32(),
+		FileHash: hash.Sum64(),
 
 		PSD: root,
 		PFV: pf,
 
+		Topology: lm.LayerTopology,
+
 		InitialLayerState: state,
 	}, nil
 }
 
 // get returns Source corresponding to a filePath. If the data has not yet been loaded, it will load.
+//
+// s.m must be held. It is released while the file loads so that other files can be
+// served meanwhile, and concurrent requests for the same file share one load.
 func (s *Sources) get(filePath string) (*Source, error) {
-	if s.srcs != nil {
-		if src, ok := s.srcs[filePath]; ok {
-			src.Touch()
-			return src, nil
+	if src, ok := s.srcs[filePath]; ok {
+		src.Touch()
+		return src, nil
+	}
+	l, ok := s.loading[filePath]
+	if ok {
+		s.m.Unlock()
+		<-l.done
+		s.m.Lock()
+	} else {
+		l = &pendingLoad{done: make(chan struct{})}
+		if s.loading == nil {
+			s.loading = make(map[string]*pendingLoad)
+		}
+		s.loading[filePath] = l
+		s.m.Unlock()
+		l.src, l.err = s.load(filePath)
+		s.m.Lock()
+		delete(s.loading, filePath)
+		close(l.done)
+		if l.err == nil {
+			if s.srcs == nil {
+				s.srcs = make(map[string]*Source)
+			}
+			s.srcs[filePath] = l.src
 		}
 	}
-	src, err := s.load(filePath)
-	if err != nil {
-		return nil, errors.Wrapf(err, "source: failed to load %q", filePath)
+	if l.err != nil {
+		return nil, errors.Wrapf(l.err, "source: failed to load %q", filePath)
+	}
+	l.src.Touch()
+	return l.src, nil
+}
+
+// prefetchKey is the Queue key of prefetch loads, so they run one at a time.
+type prefetchKey struct{}
+
+// Prefetch loads filePaths in the background so that the first NewImage for each of
+// them does not have to wait for the decoder. The files are loaded one at a time at
+// low priority on Queue, so a load only starts on a worker that no rendering job is
+// waiting for. Without a Queue they are loaded one at a time on a goroutine. Files that are
+// already loaded are skipped.
+func (s *Sources) Prefetch(filePaths []string) {
+	if len(filePaths) == 0 {
+		return
+	}
+	load := func(filePath string) {
+		s.m.Lock()
+		_, err := s.get(filePath)
+		s.m.Unlock()
+		if err != nil && s.Logger != nil {
+			s.Logger.Println(fmt.Sprintf("prefetch failed: %v", err))
+		}
 	}
-	if s.srcs == nil {
-		s.srcs = make(map[string]*Source)
+	if s.Queue == nil {
+		go func() {
+			for _, filePath := range filePaths {
+				load(filePath)
+			}
+		}()
+		return
+	}
+	for _, filePath := range filePaths {
+		filePath := filePath
+		s.Queue.EnqueuePriority(prefetchKey{}, keyqueue.PriorityLow, func() {
+			load(filePath)
+		})
 	}
-	s.srcs[filePath] = src
-	return src, nil
+}
+
+// Paths returns the files that are currently loaded in sorted order.
+func (s *Sources) Paths() []string {
+	s.m.Lock()
+	defer s.m.Unlock()
+	r := make([]string, 0, len(s.srcs))
+	for filePath := range s.srcs {
+		r = append(r, filePath)
+	}
+	sort.Strings(r)
+	return r
 }
 
 func (s *Sources) NewImage(filePath string) (*img.Image, error) {
@@ -164,7 +285,8 @@ func (s *Sources) NewImage(filePath string) (*img.Image, error) {
 	if err != nil {
 		return nil, err
 	}
-	return &img.Image{
+	lm := img.NewLayerManagerWithTopology(psd, src.Topology)
+	im := &img.Image{
 		Toucher: src,
 
 		FilePath: &src.FilePath,
@@ -172,12 +294,17 @@ func (s *Sources) NewImage(filePath string) (*img.Image, error) {
 
 		PSD:    psd,
 		PFV:    pfv,
-		Layers: img.NewLayerManager(psd),
+		Layers: lm,
 
 		InitialLayerState: &src.InitialLayerState,
 
 		Scale: 1,
-	}, nil
+	}
+	atomic.AddInt32(&src.images, 1)
+	runtime.SetFinalizer(im, func(*img.Image) {
+		atomic.AddInt32(&src.images, -1)
+	})
+	return im, nil
 }
 
 func (s *Sources) GC() {
@@ -188,7 +315,9 @@ func (s *Sources) GC() {
 	now := time.Now()
 
 	for k, v := range s.srcs {
-		if now.Sub(v.LastAccess()) > deadline {
+		// Dropping a Source that Images still use would make the next NewImage
+		// decode the same file again while the Images keep their clones alive.
+		if now.Sub(v.LastAccess()) > deadline && atomic.LoadInt32(&v.images) == 0 {
 			delete(s.srcs, k)
 		}
 	}
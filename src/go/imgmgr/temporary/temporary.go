@@ -1,6 +1,7 @@
 package temporary
 
 import (
+	"sync"
 	"time"
 
 	"github.com/pkg/errors"
@@ -14,31 +15,74 @@ type Key struct {
 	FilePath string
 }
 
+// Temporary is safe for concurrent use.
+// Each returned image must only be used by one goroutine at a time.
 type Temporary struct {
-	Srcs   *source.Sources
-	images map[Key]*img.Image
+	Srcs    *source.Sources
+	m       sync.Mutex
+	images  map[Key]*img.Image
+	loading map[Key]*pendingImage
 }
 
+// pendingImage lets callers that ask for an image already being created wait for it.
+type pendingImage struct {
+	done chan struct{}
+	img  *img.Image
+	err  error
+}
+
+// Load returns the image for id and filePath, creating it if needed.
+//
+// tp.m is not held while the image is created, so images that are already
+// loaded are still served while a file is being decoded.
 func (tp *Temporary) Load(id int, filePath string) (*img.Image, error) {
-	if img, ok := tp.images[Key{id, filePath}]; ok {
+	k := Key{id, filePath}
+	tp.m.Lock()
+	if img, ok := tp.images[k]; ok {
+		tp.m.Unlock()
 		img.Touch()
 		return img, nil
 	}
-	nimg, err := tp.Srcs.NewImage(filePath)
-	if err != nil {
-		return nil, errors.Wrapf(err, "temporary: failed to load %q", filePath)
+	if l, ok := tp.loading[k]; ok {
+		tp.m.Unlock()
+		<-l.done
+		if l.err != nil {
+			return nil, l.err
+		}
+		l.img.Touch()
+		return l.img, nil
+	}
+	l := &pendingImage{done: make(chan struct{})}
+	if tp.loading == nil {
+		tp.loading = make(map[Key]*pendingImage)
 	}
-	if tp.images == nil {
-		tp.images = make(map[Key]*img.Image)
+	tp.loading[k] = l
+	tp.m.Unlock()
+
+	l.img, l.err = tp.Srcs.NewImage(filePath)
+	if l.err != nil {
+		l.err = errors.Wrapf(l.err, "temporary: failed to load %q", filePath)
+	}
+
+	tp.m.Lock()
+	delete(tp.loading, k)
+	if l.err == nil {
+		if tp.images == nil {
+			tp.images = make(map[Key]*img.Image)
+		}
+		tp.images[k] = l.img
 	}
-	tp.images[Key{id, filePath}] = nimg
-	return nimg, nil
+	tp.m.Unlock()
+	close(l.done)
+	return l.img, l.err
 }
 
 func (tp *Temporary) GC() {
 	const deadline = 10 * time.Minute
 	now := time.Now()
 
+	tp.m.Lock()
+	defer tp.m.Unlock()
 	for k, v := range tp.images {
 		if now.Sub(v.LastAccess()) > deadline {
 			delete(tp.images, k)
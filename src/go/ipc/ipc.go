@@ -3,13 +3,13 @@ package ipc
 import (
 	"context"
 	"encoding/binary"
-	"fmt"
-	"hash/fnv"
 	"image"
 	"io"
 	"math"
 	"os"
+	"runtime"
 	"strings"
+	"sync"
 	"time"
 
 	"github.com/pkg/errors"
@@ -17,9 +17,20 @@ import (
 	"psdtoolkit/img"
 	"psdtoolkit/imgmgr/source"
 	"psdtoolkit/imgmgr/temporary"
+	"psdtoolkit/keyqueue"
+	"psdtoolkit/lru"
 	"psdtoolkit/ods"
 )
 
+// cacheKeyVersion changes whenever the renderer output for the same key changes,
+// so frames kept in the persistent cache by an older version are not reused.
+// Version 2 replaced the serialized state string with its digest.
+// Version 3 downscales scales below 1/2 from a mip level instead of the canvas.
+const cacheKeyVersion = 3
+
+// cacheKey identifies a rendered frame by the file content rather than its path,
+// so the key stays valid across sessions and changes when the file is edited.
+// It only holds fixed-size fields so that it is cheap to hash and to compare as a map key.
 type cacheKey struct {
 	Width        int
 	Height       int
@@ -27,42 +38,38 @@ type cacheKey struct {
 	OffsetY      int
 	Scale        float32
 	ScaleQuality img.ScaleQuality
-	Path         string
-	State        string
+	FileHash     uint64
+	Flip         img.Flip
+	StateDigest  uint64 // see LayerManager.VisibilityDigest
 }
 
-func (k *cacheKey) Hash() uint64 {
-	h := fnv.New64a()
-	if _, err := io.WriteString(h, k.Path); err != nil {
-		panic(err)
-	}
-	if err := binary.Write(h, binary.LittleEndian, uint32(k.Width)); err != nil {
-		panic(err)
-	}
-	if err := binary.Write(h, binary.LittleEndian, uint32(k.Height)); err != nil {
-		panic(err)
-	}
-	if err := binary.Write(h, binary.LittleEndian, int32(k.OffsetX)); err != nil {
-		panic(err)
-	}
-	if err := binary.Write(h, binary.LittleEndian, int32(k.OffsetY)); err != nil {
-		panic(err)
-	}
-	if err := binary.Write(h, binary.LittleEndian, math.Float32bits(k.Scale)); err != nil {
-		panic(err)
-	}
-	if err := binary.Write(h, binary.LittleEndian, int32(k.ScaleQuality)); err != nil {
-		panic(err)
-	}
-	if _, err := io.WriteString(h, k.State); err != nil {
-		panic(err)
+func newCacheKey(im *img.Image, width, height int) cacheKey {
+	return cacheKey{
+		Width:        width,
+		Height:       height,
+		OffsetX:      im.OffsetX,
+		OffsetY:      im.OffsetY,
+		Scale:        im.Scale,
+		ScaleQuality: im.ScaleQuality,
+		FileHash:     im.FileHash,
+		Flip:         im.Layers.Flip,
+		StateDigest:  im.Layers.VisibilityDigest(),
 	}
-	return h.Sum64()
 }
 
-type cacheValue struct {
-	LastAccess time.Time
-	Data       []byte
+func (k *cacheKey) Hash() uint64 {
+	h := newFNV64a()
+	h.u32(cacheKeyVersion)
+	h.u64(k.FileHash)
+	h.u32(uint32(k.Width))
+	h.u32(uint32(k.Height))
+	h.u32(uint32(int32(k.OffsetX)))
+	h.u32(uint32(int32(k.OffsetY)))
+	h.u32(math.Float32bits(k.Scale))
+	h.u32(uint32(int32(k.ScaleQuality)))
+	h.u32(uint32(int32(k.Flip)))
+	h.u64(k.StateDigest)
+	return uint64(h)
 }
 
 type IPC struct {
@@ -76,12 +83,15 @@ type IPC struct {
 	GCing                    func()
 
 	tmpImg temporary.Temporary
-	cache  map[cacheKey]cacheValue
-	shm    *SharedMemory
+	// cache holds rendered BGRA frames by cacheKey. It is disabled when
+	// the C side cache is the only one that should hold frames.
+	cache  *lru.Cache
+	images *keyqueue.KeyQueue
 
 	queue     chan func()
 	reply     chan error
-	replyDone chan struct{}
+	stdoutMu  sync.Mutex
+	requestMu sync.Mutex
 }
 
 func (ipc *IPC) do(f func()) {
@@ -97,48 +107,30 @@ func (ipc *IPC) load(id int, filePath string) (*img.Image, error) {
 	return ipc.tmpImg.Load(id, filePath)
 }
 
-func (ipc *IPC) draw(id int, filePath string, width, height int, shmResized bool) (dataLen int, err error) {
-	if ipc.shm == nil {
-		return 0, errors.New("ipc: shared memory not available")
-	}
-
+func (ipc *IPC) draw(id int, filePath string, width, height int, shmName string) (dataLen int, err error) {
 	dataLen = width * height * 4
 
-	// Open shared memory (always open fresh to allow C side to resize)
-	if err = ipc.shm.EnsureOpen(true); err != nil {
+	// The C side creates a fresh mapping per draw and adopts it as the cache entry,
+	// so the final pixels are written here exactly once.
+	shm, err := OpenSharedMemory(shmName)
+	if err != nil {
 		return 0, errors.Wrap(err, "ipc: could not open shared memory")
 	}
-	// Close when done to allow C side to resize if needed
-	defer ipc.shm.Close()
+	defer shm.Close()
+	buf := shm.GetBuffer(dataLen)
 
 	img, err := ipc.tmpImg.Load(id, filePath)
 	if err != nil {
 		return 0, errors.Wrap(err, "ipc: could not load")
 	}
-	state, err := img.Serialize()
-	if err != nil {
-		return 0, errors.Wrap(err, "ipc: could not serialize state")
-	}
-
-	ckey := cacheKey{
-		Width:        width,
-		Height:       height,
-		OffsetX:      img.OffsetX,
-		OffsetY:      img.OffsetY,
-		Scale:        img.Scale,
-		ScaleQuality: img.ScaleQuality,
-		Path:         filePath,
-		State:        state,
-	}
+	ckey := newCacheKey(img, width, height)
 
 	// Check if we have cached data
-	if cv, ok := ipc.cache[ckey]; ok {
-		cv.LastAccess = time.Now()
-		ipc.cache[ckey] = cv
+	if data, ok := ipc.cache.Get(ckey); ok {
 		ipc.tmpImg.Srcs.Logger.Println("cached")
 		img.Modified = false
 		// Copy cached data to shared memory (sequential copy)
-		copy(ipc.shm.GetBuffer(dataLen), cv.Data)
+		copy(buf, data)
 		return dataLen, nil
 	}
 
@@ -157,18 +149,12 @@ func (ipc *IPC) draw(id int, filePath string, width, height int, shmResized bool
 	flipX := img.FlipX()
 	flipY := img.FlipY()
 
-	// First write to regular memory (random access is fast)
-	// copyWithOffsetBGRA handles offset inversion for GPU-side flip
-	ret := image.NewNRGBA(image.Rect(0, 0, width, height))
-	copyWithOffsetBGRA(ret, nrgba, offsetX, offsetY, flipX, flipY)
-
-	// Then copy to shared memory (sequential copy is faster than random access)
-	copy(ipc.shm.GetBuffer(dataLen), ret.Pix)
+	// Write the final bottom-up BGRA image straight into the cache slot
+	copyWithOffsetBGRA(buf, width, height, nrgba, offsetX, offsetY, flipX, flipY)
 
 	// Cache the data
-	ipc.cache[ckey] = cacheValue{
-		LastAccess: time.Now(),
-		Data:       ret.Pix,
+	if ipc.cache.Enabled() {
+		ipc.cache.Put(ckey, append([]byte(nil), buf...))
 	}
 
 	return dataLen, nil
@@ -239,385 +225,596 @@ func (ipc *IPC) setProps(id int, filePath string, tag *int, layer *string, scale
 	r := im.ScaledCanvasRect()
 	im.Modified = modified
 
-	state, err := im.Serialize()
-	if err != nil {
-		return false, 0, 0, 0, false, false, errors.Wrap(err, "ipc: could not serialize state")
-	}
-
 	if tag != nil && *tag != 0 {
+		state, err := im.Serialize()
+		if err != nil {
+			return false, 0, 0, 0, false, false, errors.Wrap(err, "ipc: could not serialize state")
+		}
 		go func() {
 			ipc.UpdateTagState(filePath, *tag, state)
 		}()
 	}
 
-	ckey := (&cacheKey{
-		Width:        r.Dx(),
-		Height:       r.Dy(),
-		OffsetX:      im.OffsetX,
-		OffsetY:      im.OffsetY,
-		Scale:        im.Scale,
-		ScaleQuality: im.ScaleQuality,
-		Path:         filePath,
-		State:        state,
-	}).Hash()
+	ckey := newCacheKey(im, r.Dx(), r.Dy())
 
 	flipX := im.FlipX()
 	flipY := im.FlipY()
-	return modified, ckey, r.Dx(), r.Dy(), flipX, flipY, nil
+	return modified, ckey.Hash(), r.Dx(), r.Dy(), flipX, flipY, nil
+}
+
+// send writes a complete frame to stdout.
+func (ipc *IPC) send(f *frame) error {
+	ipc.stdoutMu.Lock()
+	defer ipc.stdoutMu.Unlock()
+	_, err := os.Stdout.Write(f.Bytes())
+	return err
+}
+
+// request sends a request to the C side and waits for its reply.
+// The C side replies in order without a request ID, so requests are serialized.
+func (ipc *IPC) request(f *frame) error {
+	ipc.requestMu.Lock()
+	defer ipc.requestMu.Unlock()
+	if err := ipc.send(f); err != nil {
+		return err
+	}
+	return <-ipc.reply
 }
 
 func (ipc *IPC) SendEditingImageState(filePath, state string) error {
-	var err error
-	ipc.do(func() {
-		fmt.Print("EDIS")
-		ods.ODS("  FilePath: %s", filePath)
-		if err = writeString(filePath); err != nil {
-			return
-		}
-		ods.ODS("  State: %s", state)
-		if err = writeString(state); err != nil {
-			return
-		}
-	})
-	if err != nil {
+	var f frame
+	f.WriteString("EDIS")
+	ods.ODS("  FilePath: %s", filePath)
+	if err := f.writeString(filePath); err != nil {
+		return err
+	}
+	ods.ODS("  State: %s", state)
+	if err := f.writeString(state); err != nil {
 		return err
 	}
 	ods.ODS("wait EDIS reply...")
-	err = <-ipc.reply
+	err := ipc.request(&f)
 	ods.ODS("wait EDIS reply ok")
-	ipc.replyDone <- struct{}{}
 	return err
 }
 
 func (ipc *IPC) ExportFaviewSlider(filePath, sliderName string, names, values []string, selectedIndex int) error {
-	var err error
-	ipc.do(func() {
-		fmt.Print("EXFS")
-		ods.ODS("  FilePath: %s", filePath)
-		if err = writeString(filePath); err != nil {
-			return
-		}
-		ods.ODS("  SliderName: %s / Names: %v / Values: %v", sliderName, names, values)
-		if err = writeString(sliderName); err != nil {
-			return
-		}
-		if err = writeString(strings.Join(names, "\x00")); err != nil {
-			return
-		}
-		if err = writeString(strings.Join(values, "\x00")); err != nil {
-			return
-		}
-		if err = writeInt32(int32(selectedIndex)); err != nil {
-			return
-		}
-	})
-	if err != nil {
+	var f frame
+	f.WriteString("EXFS")
+	ods.ODS("  FilePath: %s", filePath)
+	if err := f.writeString(filePath); err != nil {
+		return err
+	}
+	ods.ODS("  SliderName: %s / Names: %v / Values: %v", sliderName, names, values)
+	if err := f.writeString(sliderName); err != nil {
+		return err
+	}
+	if err := f.writeString(strings.Join(names, "\x00")); err != nil {
+		return err
+	}
+	if err := f.writeString(strings.Join(values, "\x00")); err != nil {
+		return err
+	}
+	if err := f.writeInt32(int32(selectedIndex)); err != nil {
 		return err
 	}
 	ods.ODS("wait EXFS reply...")
-	err = <-ipc.reply
+	err := ipc.request(&f)
 	ods.ODS("wait EXFS reply ok")
-	ipc.replyDone <- struct{}{}
 	return err
 }
 
 func (ipc *IPC) ExportLayerNames(filePath string, names, values []string, selectedIndex int) error {
-	var err error
-	ipc.do(func() {
-		fmt.Print("EXLN")
-		ods.ODS("  FilePath: %s", filePath)
-		if err = writeString(filePath); err != nil {
-			return
-		}
-		if err = writeString(strings.Join(names, "\x00")); err != nil {
-			return
-		}
-		if err = writeString(strings.Join(values, "\x00")); err != nil {
-			return
-		}
-		if err = writeInt32(int32(selectedIndex)); err != nil {
-			return
-		}
-	})
-	if err != nil {
+	var f frame
+	f.WriteString("EXLN")
+	ods.ODS("  FilePath: %s", filePath)
+	if err := f.writeString(filePath); err != nil {
+		return err
+	}
+	if err := f.writeString(strings.Join(names, "\x00")); err != nil {
+		return err
+	}
+	if err := f.writeString(strings.Join(values, "\x00")); err != nil {
+		return err
+	}
+	if err := f.writeInt32(int32(selectedIndex)); err != nil {
 		return err
 	}
 	ods.ODS("wait EXLN reply...")
-	err = <-ipc.reply
+	err := ipc.request(&f)
 	ods.ODS("wait EXLN reply ok")
-	ipc.replyDone <- struct{}{}
 	return err
 }
 
+// Abort stops the main loop and fails every request waiting on the C side.
+// Request ID 0 is never assigned by the C side and addresses all pending requests.
 func (ipc *IPC) Abort(err error) {
 	ipc.queue <- nil
-	writeReply(err)
+	var f frame
+	if e := f.writeReply(0, nil, err); e != nil {
+		return
+	}
+	ipc.send(&f)
+}
+
+// request from the C side, parsed and ready to execute.
+type request struct {
+	ID  uint32
+	Cmd string
+	// Key is set for commands that only touch one temporary image.
+	// Those run concurrently with requests for other images.
+	Key *temporary.Key
+	// Parts are run on their images' queues before Exec, which then only
+	// writes the collected results. Used by batched commands.
+	Parts []part
+	Exec  func(w *frame) error
+}
+
+// part is a piece of a batched request that touches one temporary image.
+type part struct {
+	Key temporary.Key
+	Run func()
+}
+
+// props holds the optional properties sent with PROP and PRPB.
+type props struct {
+	Tag          *int
+	Layer        *string
+	Scale        *float32
+	ScaleQuality *img.ScaleQuality
+	OffsetX      *int
+	OffsetY      *int
+}
+
+// readProps reads tagged properties from stdin until propEnd.
+func readProps() (*props, error) {
+	const (
+		propEnd = iota
+		propLayer
+		propScale
+		propOffsetX
+		propOffsetY
+		propTag
+		propScaleQuality
+	)
+	var p props
+	for {
+		pid, err := readInt32()
+		if err != nil {
+			return nil, err
+		}
+		switch pid {
+		case propEnd:
+			return &p, nil
+		case propTag:
+			ui, err := readUInt32()
+			if err != nil {
+				return nil, err
+			}
+			p.Tag = &ui
+			ods.ODS("  Tag: %d", ui)
+		case propLayer:
+			s, err := readString()
+			if err != nil {
+				return nil, err
+			}
+			p.Layer = &s
+			ods.ODS("  Layer: %s", s)
+		case propScale:
+			f, err := readFloat32()
+			if err != nil {
+				return nil, err
+			}
+			p.Scale = &f
+			ods.ODS("  Scale: %f", f)
+		case propScaleQuality:
+			i, err := readInt32()
+			if err != nil {
+				return nil, err
+			}
+			q := img.ScaleQuality(i)
+			p.ScaleQuality = &q
+			ods.ODS("  ScaleQuality: %d", i)
+		case propOffsetX:
+			i, err := readInt32()
+			if err != nil {
+				return nil, err
+			}
+			p.OffsetX = &i
+			ods.ODS("  OffsetX: %d", i)
+		case propOffsetY:
+			i, err := readInt32()
+			if err != nil {
+				return nil, err
+			}
+			p.OffsetY = &i
+			ods.ODS("  OffsetY: %d", i)
+		}
+	}
 }
 
-func (ipc *IPC) dispatch(cmd string) error {
+// propResult is the reply of PROP, and of each PRPB item.
+type propResult struct {
+	Modified     bool
+	CacheKey     uint64
+	Width        int
+	Height       int
+	FlipX, FlipY bool
+}
+
+func (r *propResult) write(w *frame) error {
+	if err := w.writeBool(r.Modified); err != nil {
+		return err
+	}
+	if err := w.writeUint64(r.CacheKey); err != nil {
+		return err
+	}
+	if err := w.writeUint32(uint32(r.Width)); err != nil {
+		return err
+	}
+	if err := w.writeUint32(uint32(r.Height)); err != nil {
+		return err
+	}
+	if err := w.writeBool(r.FlipX); err != nil {
+		return err
+	}
+	return w.writeBool(r.FlipY)
+}
+
+func (ipc *IPC) setPropsResult(id int, filePath string, p *props) (propResult, error) {
+	modified, ckey, width, height, flipX, flipY, err := ipc.setProps(id, filePath, p.Tag, p.Layer, p.Scale, p.ScaleQuality, p.OffsetX, p.OffsetY)
+	if err != nil {
+		return propResult{}, err
+	}
+	ods.ODS("  Modified: %v / CacheKey: %016x / Width: %d / Height: %d", modified, ckey, width, height)
+	return propResult{Modified: modified, CacheKey: ckey, Width: width, Height: height, FlipX: flipX, FlipY: flipY}, nil
+}
+
+// readRequest reads the arguments of cmd from stdin.
+func (ipc *IPC) readRequest(cmd string, reqID uint32) (*request, error) {
+	req := &request{ID: reqID, Cmd: cmd}
 	switch cmd {
 	case "HELO":
-		return writeUint32(0x80000000)
+		req.Exec = func(w *frame) error { return nil }
 
 	case "ADDF":
 		file, err := readString()
 		if err != nil {
-			return err
+			return nil, err
 		}
 		tag, err := readUInt32()
 		if err != nil {
-			return err
+			return nil, err
 		}
-		if err = ipc.AddFile(file, tag); err != nil {
-			return err
+		req.Exec = func(w *frame) error {
+			return ipc.AddFile(file, tag)
 		}
-		return writeUint32(0x80000000)
 
 	case "UPDP":
 		file, err := readString()
 		if err != nil {
-			return err
+			return nil, err
 		}
-		if err = ipc.UpdateCurrentProjectPath(file); err != nil {
-			return err
+		req.Exec = func(w *frame) error {
+			return ipc.UpdateCurrentProjectPath(file)
 		}
-		return writeUint32(0x80000000)
 
 	case "CLRF":
-		if err := ipc.ClearFiles(); err != nil {
-			return err
+		req.Exec = func(w *frame) error {
+			return ipc.ClearFiles()
 		}
-		return writeUint32(0x80000000)
 
 	case "DRAW":
 		id, filePath, err := readIDAndFilePath()
 		if err != nil {
-			return err
+			return nil, err
 		}
 		width, err := readInt32()
 		if err != nil {
-			return err
+			return nil, err
 		}
 		height, err := readInt32()
 		if err != nil {
-			return err
-		}
-		shmResizedInt, err := readInt32()
-		if err != nil {
-			return err
+			return nil, err
 		}
-		shmResized := shmResizedInt != 0
-		ods.ODS("  Width: %d / Height: %d / ShmResized: %v", width, height, shmResized)
-		dataLen, err := ipc.draw(id, filePath, width, height, shmResized)
+		shmName, err := readString()
 		if err != nil {
-			return err
-		}
-		// Write reply: success flag, data length
-		if err = writeUint32(0x80000000); err != nil {
-			return err
+			return nil, err
 		}
-		if err = writeInt32(int32(dataLen)); err != nil {
-			return err
+		ods.ODS("  Width: %d / Height: %d / Shm: %s", width, height, shmName)
+		req.Key = &temporary.Key{ID: id, FilePath: filePath}
+		req.Exec = func(w *frame) error {
+			dataLen, err := ipc.draw(id, filePath, width, height, shmName)
+			if err != nil {
+				return err
+			}
+			ods.ODS("  -> SharedMem(Len: %d)", dataLen)
+			return w.writeInt32(int32(dataLen))
 		}
-		ods.ODS("  -> SharedMem(Len: %d)", dataLen)
-		return nil
 
 	case "LNAM":
 		id, filePath, err := readIDAndFilePath()
 		if err != nil {
-			return err
-		}
-		s, err := ipc.getLayerNames(id, filePath)
-		if err != nil {
-			return err
+			return nil, err
 		}
-		if err = writeUint32(0x80000000); err != nil {
-			return err
+		req.Key = &temporary.Key{ID: id, FilePath: filePath}
+		req.Exec = func(w *frame) error {
+			s, err := ipc.getLayerNames(id, filePath)
+			if err != nil {
+				return err
+			}
+			return w.writeString(s)
 		}
-		return writeString(s)
 
 	case "PROP":
 		id, filePath, err := readIDAndFilePath()
 		if err != nil {
-			return err
-		}
-		const (
-			propEnd = iota
-			propLayer
-			propScale
-			propOffsetX
-			propOffsetY
-			propTag
-			propScaleQuality
-		)
-		var tag *int
-		var layer *string
-		var scale *float32
-		var scaleQuality *img.ScaleQuality
-		var offsetX, offsetY *int
-	readProps:
-		for {
-			pid, err := readInt32()
+			return nil, err
+		}
+		p, err := readProps()
+		if err != nil {
+			return nil, err
+		}
+		req.Key = &temporary.Key{ID: id, FilePath: filePath}
+		req.Exec = func(w *frame) error {
+			r, err := ipc.setPropsResult(id, filePath, p)
 			if err != nil {
 				return err
 			}
-			switch pid {
-			case propEnd:
-				break readProps
-			case propTag:
-				ui, err := readUInt32()
-				if err != nil {
-					return err
-				}
-				tag = &ui
-				ods.ODS("  Tag: %d", ui)
-			case propLayer:
-				s, err := readString()
-				if err != nil {
-					return err
-				}
-				layer = &s
-				ods.ODS("  Layer: %s", s)
-			case propScale:
-				f, err := readFloat32()
-				if err != nil {
-					return err
-				}
-				scale = &f
-				ods.ODS("  Scale: %f", f)
-			case propScaleQuality:
-				i, err := readInt32()
-				if err != nil {
-					return err
-				}
-				q := img.ScaleQuality(i)
-				scaleQuality = &q
-				ods.ODS("  ScaleQuality: %d", i)
-			case propOffsetX:
-				i, err := readInt32()
-				if err != nil {
-					return err
+			return r.write(w)
+		}
+
+	case "PRPB":
+		n, err := readInt32()
+		if err != nil {
+			return nil, err
+		}
+		if n < 0 {
+			return nil, errors.New("ipc: invalid batch size")
+		}
+		results := make([]propResult, n)
+		errs := make([]error, n)
+		for i := 0; i < n; i++ {
+			id, filePath, err := readIDAndFilePath()
+			if err != nil {
+				return nil, err
+			}
+			p, err := readProps()
+			if err != nil {
+				return nil, err
+			}
+			i := i
+			req.Parts = append(req.Parts, part{
+				Key: temporary.Key{ID: id, FilePath: filePath},
+				Run: func() {
+					results[i], errs[i] = ipc.setPropsResult(id, filePath, p)
+				},
+			})
+		}
+		req.Exec = func(w *frame) error {
+			for i := range results {
+				if errs[i] != nil {
+					return errs[i]
 				}
-				offsetX = &i
-				ods.ODS("  OffsetX: %d", i)
-			case propOffsetY:
-				i, err := readInt32()
-				if err != nil {
+				if err := results[i].write(w); err != nil {
 					return err
 				}
-				offsetY = &i
-				ods.ODS("  OffsetY: %d", i)
 			}
+			return nil
 		}
-		modified, ckey, width, height, flipX, flipY, err := ipc.setProps(id, filePath, tag, layer, scale, scaleQuality, offsetX, offsetY)
+
+	case "DRWB":
+		n, err := readInt32()
 		if err != nil {
-			return err
-		}
-		ods.ODS("  Modified: %v / CacheKey: %016x / Width: %d / Height: %d", modified, ckey, width, height)
-		if err = writeUint32(0x80000000); err != nil {
-			return err
-		}
-		if err = writeBool(modified); err != nil {
-			return err
+			return nil, err
 		}
-		if err = writeUint64(ckey); err != nil {
-			return err
+		if n < 0 {
+			return nil, errors.New("ipc: invalid batch size")
 		}
-		if err = writeUint32(uint32(width)); err != nil {
-			return err
-		}
-		if err = writeUint32(uint32(height)); err != nil {
-			return err
+		lens := make([]int, n)
+		errs := make([]error, n)
+		for i := 0; i < n; i++ {
+			id, filePath, err := readIDAndFilePath()
+			if err != nil {
+				return nil, err
+			}
+			width, err := readInt32()
+			if err != nil {
+				return nil, err
+			}
+			height, err := readInt32()
+			if err != nil {
+				return nil, err
+			}
+			shmName, err := readString()
+			if err != nil {
+				return nil, err
+			}
+			ods.ODS("  [%d] Width: %d / Height: %d / Shm: %s", i, width, height, shmName)
+			i := i
+			req.Parts = append(req.Parts, part{
+				Key: temporary.Key{ID: id, FilePath: filePath},
+				Run: func() {
+					lens[i], errs[i] = ipc.draw(id, filePath, width, height, shmName)
+				},
+			})
+		}
+		req.Exec = func(w *frame) error {
+			for i := range lens {
+				if errs[i] != nil {
+					return errs[i]
+				}
+				if err := w.writeInt32(int32(lens[i])); err != nil {
+					return err
+				}
+			}
+			return nil
 		}
-		if err = writeBool(flipX); err != nil {
-			return err
+
+	case "STAT":
+		req.Exec = func(w *frame) error {
+			s := ipc.cache.Stats()
+			for _, v := range []uint64{s.Hits, s.Misses, s.Evictions, uint64(s.Entries), uint64(s.Bytes), uint64(s.Limit)} {
+				if err := w.writeUint64(v); err != nil {
+					return err
+				}
+			}
+			return nil
 		}
-		return writeBool(flipY)
 
 	case "GWND":
-		h, err := ipc.GetWindowHandle()
-		if err != nil {
-			return errors.Wrap(err, "ipc: cannot get window handle")
-		}
-		if err = writeUint32(0x80000000); err != nil {
-			return err
+		req.Exec = func(w *frame) error {
+			h, err := ipc.GetWindowHandle()
+			if err != nil {
+				return errors.Wrap(err, "ipc: cannot get window handle")
+			}
+			return w.writeUint64(uint64(h))
 		}
-		return writeUint64(uint64(h))
 
 	case "SRLZ":
-		s, err := ipc.Serialize()
-		if err != nil {
-			return errors.Wrap(err, "ipc: cannot serialize")
-		}
-		if err = writeUint32(0x80000000); err != nil {
-			return err
+		req.Exec = func(w *frame) error {
+			s, err := ipc.Serialize()
+			if err != nil {
+				return errors.Wrap(err, "ipc: cannot serialize")
+			}
+			return w.writeString(s)
 		}
-		return writeString(s)
 
 	case "DSLZ":
 		s, err := readString()
 		if err != nil {
-			return err
+			return nil, err
 		}
-		err = ipc.Deserialize(s)
-		if err != nil {
-			return errors.Wrap(err, "ipc: cannot deserialize")
+		req.Exec = func(w *frame) error {
+			if err := ipc.Deserialize(s); err != nil {
+				return errors.Wrap(err, "ipc: cannot deserialize")
+			}
+			return w.writeBool(true)
 		}
-		if err = writeUint32(0x80000000); err != nil {
-			return err
+
+	default:
+		req.Exec = func(w *frame) error {
+			return errors.New("unknown command")
 		}
-		return writeBool(true)
 	}
-	return errors.New("unknown command")
+	return req, nil
+}
+
+// execute runs req and sends its reply.
+func (ipc *IPC) execute(req *request) {
+	ods.ODS("%s #%d", req.Cmd, req.ID)
+	var payload, reply frame
+	err := req.Exec(&payload)
+	if err != nil {
+		ods.ODS("error: %v", err)
+		payload.Reset()
+	}
+	if err = reply.writeReply(req.ID, payload.Bytes(), err); err == nil {
+		err = ipc.send(&reply)
+	}
+	if err != nil {
+		ods.ODS("reply error: %v", err)
+	}
+	ods.ODS("%s #%d END", req.Cmd, req.ID)
+}
+
+// schedule runs requests for the same image in order, requests for different
+// images concurrently, and all other requests in order on the main goroutine.
+// Parts of a batched request are queued like individual requests, and the
+// reply is sent once all of them have finished.
+// Requests from the C side serve the timeline, so they are queued with the
+// highest priority and go ahead of GUI previews when all workers are busy.
+func (ipc *IPC) schedule(req *request) {
+	if len(req.Parts) > 0 {
+		var wg sync.WaitGroup
+		wg.Add(len(req.Parts))
+		for _, p := range req.Parts {
+			run := p.Run
+			ipc.images.EnqueuePriority(p.Key, keyqueue.PriorityHigh, func() {
+				defer wg.Done()
+				run()
+			})
+		}
+		go func() {
+			wg.Wait()
+			ipc.execute(req)
+		}()
+		return
+	}
+	if req.Key != nil {
+		ipc.images.EnqueuePriority(*req.Key, keyqueue.PriorityHigh, func() {
+			ipc.execute(req)
+		})
+		return
+	}
+	ipc.images.EnqueuePriority(mainQueueKey{}, keyqueue.PriorityHigh, func() {
+		ipc.do(func() {
+			ipc.execute(req)
+		})
+	})
 }
 
-func (ipc *IPC) readCommand(r chan string) {
+// mainQueueKey is the keyqueue key of requests that run on the main goroutine.
+type mainQueueKey struct{}
+
+// readCommands reads messages from stdin until an error occurs.
+//
+// Request: FOURCC command, uint32 request ID, arguments
+// Reply to a Go side request: 0x80000000 | error message length, error message
+func (ipc *IPC) readCommands(errCh chan<- error) {
 	cmd := make([]byte, 4)
 	for {
 		ods.ODS("wait next command...")
-		if read, err := io.ReadFull(os.Stdin, cmd); err != nil || read != 4 {
-			r <- fmt.Sprintf("error: %v", err)
+		if _, err := io.ReadFull(os.Stdin, cmd); err != nil {
+			errCh <- err
 			return
 		}
 		l := binary.LittleEndian.Uint32(cmd)
-		if l&0x80000000 == 0 {
-			break
-		}
-		l &= 0x7fffffff
-		if l == 0 {
-			ods.ODS("readCommand: reply no error")
-			ipc.reply <- nil
-		} else {
-			buf := make([]byte, l)
-			read, err := io.ReadFull(os.Stdin, buf)
-			if err != nil {
-				r <- fmt.Sprintf("error: %v", err)
-				return
+		if l&0x80000000 != 0 {
+			l &= 0x7fffffff
+			if l == 0 {
+				ods.ODS("readCommands: reply no error")
+				ipc.reply <- nil
+				continue
 			}
-			if read != int(l) {
-				r <- fmt.Sprintf("error: %v", errors.New("unexcepted read size"))
+			buf := make([]byte, l)
+			if _, err := io.ReadFull(os.Stdin, buf); err != nil {
+				errCh <- err
 				return
 			}
-			ods.ODS("readCommand: reply %s", string(buf))
+			ods.ODS("readCommands: reply %s", string(buf))
 			ipc.reply <- errors.New(string(buf))
+			continue
 		}
-		<-ipc.replyDone
+		reqID, err := readUInt32()
+		if err != nil {
+			errCh <- err
+			return
+		}
+		ods.ODS("readCommands: cmd %s #%d", string(cmd), reqID)
+		req, err := ipc.readRequest(string(cmd), uint32(reqID))
+		if err != nil {
+			errCh <- err
+			return
+		}
+		ipc.schedule(req)
 	}
-	ods.ODS("readCommand: cmd %s", string(cmd))
-	r <- string(cmd)
 }
 
 func (ipc *IPC) gc() {
-	const deadline = 1 * time.Minute
-	now := time.Now()
-
-	for k, v := range ipc.cache {
-		if now.Sub(v.LastAccess) > deadline {
-			delete(ipc.cache, k)
-		}
+	ipc.cache.Prune(1 * time.Minute)
+	if ipc.cache.Enabled() {
+		s := ipc.cache.Stats()
+		ods.ODS("draw cache: %d entries / %d of %d bytes / hits %d / misses %d / evictions %d",
+			s.Entries, s.Bytes, s.Limit, s.Hits, s.Misses, s.Evictions)
 	}
 }
 
+// DrawCacheStats returns the counters of the rendered frame cache.
+func (ipc *IPC) DrawCacheStats() lru.Stats {
+	return ipc.cache.Stats()
+}
+
 func (ipc *IPC) Main(exitCh chan<- struct{}) {
 	gcTicker := time.NewTicker(1 * time.Minute)
 	defer func() {
@@ -628,8 +825,8 @@ func (ipc *IPC) Main(exitCh chan<- struct{}) {
 		close(exitCh)
 	}()
 
-	cmdCh := make(chan string)
-	go ipc.readCommand(cmdCh)
+	errCh := make(chan error, 1)
+	go ipc.readCommands(errCh)
 	for {
 		select {
 		case <-gcTicker.C:
@@ -642,56 +839,48 @@ func (ipc *IPC) Main(exitCh chan<- struct{}) {
 				return
 			}
 			f()
-		case cmd := <-cmdCh:
-			if len(cmd) != 4 {
-				ods.ODS("%s", cmd) // error report
-				return
-			}
-			ods.ODS("%s", cmd)
-			if err := ipc.dispatch(cmd); err != nil {
-				ods.ODS("error: %v", err)
-				if err = writeReply(err); err != nil {
-					return
-				}
-			}
-			ods.ODS("%s END", cmd)
-			go ipc.readCommand(cmdCh)
+		case err := <-errCh:
+			ods.ODS("error: %v", err) // error report
+			return
 		}
 	}
 }
 
-func New(srcs *source.Sources) *IPC {
-	// Get parent process PID (C side) for shared memory name
-	cPID := GetParentPID()
-	shm := NewSharedMemory(cPID)
-
+// New creates an IPC. drawCacheLimit is the size limit of the rendered frame
+// cache in bytes, 0 disables it.
+// It also makes srcs prefetch on the image queue, so call it before anything uses srcs.
+func New(srcs *source.Sources, drawCacheLimit int64) *IPC {
 	r := &IPC{
 		tmpImg: temporary.Temporary{Srcs: srcs},
-		cache:  map[cacheKey]cacheValue{},
-		shm:    shm,
+		cache:  lru.New(drawCacheLimit),
+		images: keyqueue.New(runtime.GOMAXPROCS(0)),
 
-		queue:     make(chan func()),
-		reply:     make(chan error),
-		replyDone: make(chan struct{}),
+		queue: make(chan func()),
+		reply: make(chan error, 1),
 	}
+	// Prefetching shares the workers with rendering at the lowest priority
+	srcs.Queue = r.images
 	return r
 }
 
 // RenderScaled renders an image at a specific scale with the given quality.
-// This method is safe to call from any goroutine as it uses the IPC queue for serialization.
+// This method is safe to call from any goroutine. It runs on the main goroutine
+// like other requests that are not tied to a temporary image, but with a lower
+// priority, so timeline requests get free workers first.
 func (ipc *IPC) RenderScaled(ctx context.Context, im *img.Image, scale float64, quality img.ScaleQuality) (*image.NRGBA, error) {
 	var result *image.NRGBA
 	var err error
 
 	done := make(chan struct{})
-	select {
-	case ipc.queue <- func() {
-		result, err = im.RenderWithScale(ctx, scale, quality, true)
-		close(done)
-	}:
-	case <-ctx.Done():
-		return nil, ctx.Err()
-	}
+	ipc.images.EnqueuePriority(mainQueueKey{}, keyqueue.PriorityNormal, func() {
+		defer close(done)
+		if err = ctx.Err(); err != nil {
+			return
+		}
+		ipc.do(func() {
+			result, err = im.RenderWithScale(ctx, scale, quality, true)
+		})
+	})
 
 	select {
 	case <-done:
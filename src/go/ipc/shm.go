@@ -2,78 +2,64 @@ package ipc
 
 import (
 	"fmt"
-	"os"
 	"syscall"
 	"unsafe"
 )
 
 var (
-	kernel32                = syscall.NewLazyDLL("kernel32.dll")
-	procOpenFileMappingW    = kernel32.NewProc("OpenFileMappingW")
-	procMapViewOfFile       = kernel32.NewProc("MapViewOfFile")
-	procUnmapViewOfFile     = kernel32.NewProc("UnmapViewOfFile")
-	procGetCurrentProcessId = kernel32.NewProc("GetCurrentProcessId")
+	kernel32             = syscall.NewLazyDLL("kernel32.dll")
+	procOpenFileMappingW = kernel32.NewProc("OpenFileMappingW")
+	procMapViewOfFile    = kernel32.NewProc("MapViewOfFile")
+	procUnmapViewOfFile  = kernel32.NewProc("UnmapViewOfFile")
 )
 
 const (
-	fileMapRead = 0x0004
+	fileMapRead  = 0x0004
+	fileMapWrite = 0x0002
 )
 
-// SharedMemory holds shared memory resources for zero-copy IPC
-// C side creates the mapping, Go side opens and writes to it
+// SharedMemory holds a view of a cache slot created by the C side.
+// The C side creates one mapping per draw and adopts it as the cache entry,
+// so the pixels written here are never copied again.
 type SharedMemory struct {
-	hMapFile   syscall.Handle
-	mappedPtr  unsafe.Pointer
-	bufferSize int
-	cPID       int // C side PID (parent process)
+	hMapFile  syscall.Handle
+	mappedPtr unsafe.Pointer
 }
 
-// NewSharedMemory creates a SharedMemory instance
-// The actual mapping is opened on first use or when size changes
-func NewSharedMemory(cPID int) *SharedMemory {
-	return &SharedMemory{
-		cPID: cPID,
+// OpenSharedMemory opens the named shared memory created by the C side.
+func OpenSharedMemory(name string) (*SharedMemory, error) {
+	namePtr, err := syscall.UTF16PtrFromString(name)
+	if err != nil {
+		return nil, err
 	}
-}
-
-// openMapping opens the shared memory mapping created by C side
-func (shm *SharedMemory) openMapping() error {
-	// Close existing mapping if any
-	shm.closeMapping()
-
-	// Open shared memory created by C side using C's PID
-	name := fmt.Sprintf("Local\\PSDTKit_Pixel_%d", shm.cPID)
-	namePtr, _ := syscall.UTF16PtrFromString(name)
 
 	ret, _, errno := procOpenFileMappingW.Call(
-		fileMapRead|0x0002, // FILE_MAP_READ | FILE_MAP_WRITE
+		fileMapRead|fileMapWrite,
 		0,
 		uintptr(unsafe.Pointer(namePtr)),
 	)
 	if ret == 0 {
-		return fmt.Errorf("OpenFileMappingW failed: %v", errno)
+		return nil, fmt.Errorf("OpenFileMappingW failed: %v", errno)
 	}
-	shm.hMapFile = syscall.Handle(ret)
+	shm := &SharedMemory{hMapFile: syscall.Handle(ret)}
 
 	// Map the entire view (size 0 means entire mapping)
 	ret, _, errno = procMapViewOfFile.Call(
 		uintptr(shm.hMapFile),
-		fileMapRead|0x0002, // FILE_MAP_READ | FILE_MAP_WRITE
+		fileMapRead|fileMapWrite,
 		0, 0,
 		0, // Map entire file
 	)
 	if ret == 0 {
 		syscall.CloseHandle(shm.hMapFile)
-		shm.hMapFile = 0
-		return fmt.Errorf("MapViewOfFile failed: %v", errno)
+		return nil, fmt.Errorf("MapViewOfFile failed: %v", errno)
 	}
 	shm.mappedPtr = unsafe.Pointer(ret)
-
-	return nil
+	return shm, nil
 }
 
-// closeMapping releases the current mapping
-func (shm *SharedMemory) closeMapping() {
+// Close releases shared memory resources
+func (shm *SharedMemory) Close() {
 	if shm.mappedPtr != nil {
 		procUnmapViewOfFile.Call(uintptr(shm.mappedPtr))
 		shm.mappedPtr = nil
@@ -82,26 +68,6 @@ func (shm *SharedMemory) closeMapping() {
 		syscall.CloseHandle(shm.hMapFile)
 		shm.hMapFile = 0
 	}
-	shm.bufferSize = 0
-}
-
-// EnsureOpen ensures the shared memory is opened
-// If shmResized is true, reopens the mapping
-func (shm *SharedMemory) EnsureOpen(shmResized bool) error {
-	if shmResized || shm.mappedPtr == nil {
-		return shm.openMapping()
-	}
-	return nil
-}
-
-// Close releases shared memory resources
-func (shm *SharedMemory) Close() {
-	shm.closeMapping()
-}
-
-// CPID returns the C side process ID
-func (shm *SharedMemory) CPID() int {
-	return shm.cPID
 }
 
 // GetBuffer returns the shared memory buffer as a byte slice
@@ -112,11 +78,3 @@ func (shm *SharedMemory) GetBuffer(maxLen int) []byte {
 	}
 	return unsafe.Slice((*byte)(shm.mappedPtr), maxLen)
 }
-
-// GetParentPID returns the parent process ID (C side)
-func GetParentPID() int {
-	// On Windows, we need to find the parent process
-	// For simplicity, use environment variable or PPID
-	// Since we're launched by C side, use PPID
-	return os.Getppid()
-}
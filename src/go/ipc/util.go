@@ -1,6 +1,7 @@
 package ipc
 
 import (
+	"bytes"
 	"encoding/binary"
 	"errors"
 	"image"
@@ -13,16 +14,15 @@ import (
 	"psdtoolkit/ods"
 )
 
-func nrgbaToNBGRA(p []byte) {
-	for i := 0; i < len(p); i += 4 {
-		if p[i+3] > 0 {
-			p[i+2], p[i+0] = p[i+0], p[i+2]
-		}
-	}
-}
-
 // copyWithOffsetBGRA copies src to dst with offset and NRGBA->NBGRA conversion in a single pass.
 //
+// dst is a dstW x dstH BGRA buffer laid out bottom-up (the first row in memory is
+// the bottom row of the image), which is the layout of a bottom-up DIB. Writing it
+// in this order lets the C side adopt the buffer without flipping rows.
+// dst must be zero-filled; pixels outside src are left untouched. Pixels with zero
+// alpha are written as zero so transparent areas never carry hidden color, which keeps
+// them compressible by the zero run-length codec of the file cache tier.
+//
 // GPU-side Flip Optimization:
 // Flip processing is NOT done here - it's delegated to AviUtl's GPU-based flip filter
 // (obj.effect("反転")) which runs on the GPU with essentially zero CPU cost.
@@ -37,10 +37,11 @@ func nrgbaToNBGRA(p []byte) {
 // Example: if flipY is on and offsetY is +100, we use -100 so the final position
 // after GPU flip matches what it would be if we did CPU flip with +100 offset.
 //
-// Uses parallel processing for performance.
-func copyWithOffsetBGRA(dst, src *image.NRGBA, offsetX, offsetY int, flipX, flipY bool) {
-	dstW, dstH := dst.Rect.Dx(), dst.Rect.Dy()
+// The visible part of src is clipped once up front, so each row is a single span copy
+// without per-pixel bounds checks. Rows are split across goroutines.
+func copyWithOffsetBGRA(dst []byte, dstW, dstH int, src *image.NRGBA, offsetX, offsetY int, flipX, flipY bool) {
 	srcW, srcH := src.Rect.Dx(), src.Rect.Dy()
+	dstStride := dstW * 4
 
 	// Invert offset for flipped axes to maintain correct positioning after GPU flip
 	// (see function comment for detailed explanation)
@@ -51,52 +52,85 @@ func copyWithOffsetBGRA(dst, src *image.NRGBA, offsetX, offsetY int, flipX, flip
 		offsetY = -offsetY
 	}
 
+	// Destination span covered by src: dst (x, y) reads src (x-offsetX, y-offsetY),
+	// which is in src only within src.Rect
+	x0, x1 := clipSpan(offsetX+src.Rect.Min.X, srcW, dstW)
+	y0, y1 := clipSpan(offsetY+src.Rect.Min.Y, srcH, dstH)
+	if x0 >= x1 || y0 >= y1 {
+		return
+	}
+	spanLen := (x1 - x0) * 4
+
 	numWorkers := runtime.NumCPU()
-	rowsPerWorker := (dstH + numWorkers - 1) / numWorkers
+	rowsPerWorker := (y1 - y0 + numWorkers - 1) / numWorkers
 
 	var wg sync.WaitGroup
-	for w := 0; w < numWorkers; w++ {
-		startY := w * rowsPerWorker
+	for startY := y0; startY < y1; startY += rowsPerWorker {
 		endY := startY + rowsPerWorker
-		if endY > dstH {
-			endY = dstH
-		}
-		if startY >= dstH {
-			break
+		if endY > y1 {
+			endY = y1
 		}
-
 		wg.Add(1)
 		go func(startY, endY int) {
 			defer wg.Done()
 			for dy := startY; dy < endY; dy++ {
-				dstRowStart := (dy-dst.Rect.Min.Y)*dst.Stride - dst.Rect.Min.X*4
-				for dx := 0; dx < dstW; dx++ {
-					// Calculate source coordinates with offset
-					sx := dx - offsetX
-					sy := dy - offsetY
-
-					// Bounds check
-					if sx < 0 || sx >= srcW || sy < 0 || sy >= srcH {
-						continue // Leave dst pixel as zero (transparent)
-					}
-
-					srcIdx := (sy-src.Rect.Min.Y)*src.Stride + (sx-src.Rect.Min.X)*4
-					dstIdx := dstRowStart + dx*4
-
-					// Copy with RGBA -> BGRA swap (only if alpha > 0)
-					if src.Pix[srcIdx+3] > 0 {
-						dst.Pix[dstIdx+0] = src.Pix[srcIdx+2] // B <- R
-						dst.Pix[dstIdx+1] = src.Pix[srcIdx+1] // G <- G
-						dst.Pix[dstIdx+2] = src.Pix[srcIdx+0] // R <- B
-						dst.Pix[dstIdx+3] = src.Pix[srcIdx+3] // A <- A
-					}
-				}
+				// Bottom-up: image row dy is stored at memory row dstH-1-dy
+				d := (dstH-1-dy)*dstStride + x0*4
+				s := (dy-offsetY-src.Rect.Min.Y)*src.Stride + (x0-offsetX-src.Rect.Min.X)*4
+				swizzleRowBGRA(dst[d:d+spanLen], src.Pix[s:s+spanLen])
 			}
 		}(startY, endY)
 	}
 	wg.Wait()
 }
 
+// clipSpan returns the range of [0, dstLen) that a srcLen long span placed at offset covers.
+func clipSpan(offset, srcLen, dstLen int) (int, int) {
+	lo, hi := offset, offset+srcLen
+	if lo < 0 {
+		lo = 0
+	}
+	if hi > dstLen {
+		hi = dstLen
+	}
+	return lo, hi
+}
+
+// swizzleRowBGRA converts one row of NRGBA pixels to NBGRA.
+// Pixels with zero alpha are written as zero, matching a zero-filled destination.
+func swizzleRowBGRA(dst, src []byte) {
+	dst = dst[:len(src)]
+	for i := 0; i+4 <= len(src); i += 4 {
+		v := binary.LittleEndian.Uint32(src[i : i+4])
+		// All ones when alpha > 0, zero otherwise
+		mask := -((v>>24 + 0xff) >> 8)
+		v = (v & 0xff00ff00) | (v >> 16 & 0xff) | (v & 0xff << 16)
+		binary.LittleEndian.PutUint32(dst[i:i+4], v&mask)
+	}
+}
+
+// fnv64a is an FNV-1a hasher for fixed-size little-endian fields that never allocates.
+// It produces the same values as hash/fnv.New64a fed with the same bytes.
+type fnv64a uint64
+
+func newFNV64a() fnv64a {
+	return 14695981039346656037
+}
+
+func (h *fnv64a) u32(v uint32) {
+	x := *h
+	for i := 0; i < 4; i++ {
+		x = (x ^ fnv64a(byte(v))) * 1099511628211
+		v >>= 8
+	}
+	*h = x
+}
+
+func (h *fnv64a) u64(v uint64) {
+	h.u32(uint32(v))
+	h.u32(uint32(v >> 32))
+}
+
 func readIDAndFilePath() (int, string, error) {
 	id, err := readInt32()
 	if err != nil {
@@ -167,63 +201,89 @@ func readString() (string, error) {
 	return string(buf), nil
 }
 
-func writeUint64(i uint64) error {
-	return binary.Write(os.Stdout, binary.LittleEndian, i)
+// frame collects an outgoing message so that it can be written to stdout atomically.
+// Requests run concurrently, so every message must reach stdout in one piece.
+type frame struct {
+	bytes.Buffer
+}
+
+func (f *frame) writeUint64(i uint64) error {
+	return binary.Write(f, binary.LittleEndian, i)
 }
 
-func writeInt32(i int32) error {
-	return binary.Write(os.Stdout, binary.LittleEndian, i)
+func (f *frame) writeInt32(i int32) error {
+	return binary.Write(f, binary.LittleEndian, i)
 }
 
-func writeUint32(i uint32) error {
-	return binary.Write(os.Stdout, binary.LittleEndian, i)
+func (f *frame) writeUint32(i uint32) error {
+	return binary.Write(f, binary.LittleEndian, i)
 }
 
-func writeFloat32(v float32) error {
-	return binary.Write(os.Stdout, binary.LittleEndian, math.Float32bits(v))
+func (f *frame) writeFloat32(v float32) error {
+	return binary.Write(f, binary.LittleEndian, math.Float32bits(v))
 }
 
-func writeBool(v bool) error {
+func (f *frame) writeBool(v bool) error {
 	if v {
-		return writeInt32(1)
+		return f.writeInt32(1)
 	}
-	return writeInt32(0)
+	return f.writeInt32(0)
 }
 
-func writeString(s string) error {
-	if err := writeInt32(int32(len(s))); err != nil {
+func (f *frame) writeString(s string) error {
+	if err := f.writeInt32(int32(len(s))); err != nil {
 		return err
 	}
-	if _, err := os.Stdout.WriteString(s); err != nil {
+	if _, err := f.WriteString(s); err != nil {
 		return err
 	}
 	ods.ODS("  -> String(Len: %d)", len(s))
 	return nil
 }
 
-func writeReply(err error) error {
-	if err == nil {
-		return writeUint32(0x80000000)
-	}
-	s := err.Error()
-	if err := writeUint32(uint32(len(s)&0x7fffffff) | 0x80000000); err != nil {
+func (f *frame) writeBinary(b []byte) error {
+	if err := f.writeInt32(int32(len(b))); err != nil {
 		return err
 	}
-	if _, err := os.Stdout.WriteString(s); err != nil {
+	if _, err := f.Write(b); err != nil {
 		return err
 	}
-	ods.ODS("  -> Error: %v", err)
+	ods.ODS("  -> Binary(Len: %d)", len(b))
 	return nil
 }
 
-func writeBinary(b []byte) error {
-	if err := writeInt32(int32(len(b))); err != nil {
-		return err
+// writeReply builds a reply frame for the request reqID.
+//
+// Success: 0x80000000, reqID, payload length, payload
+// Failure: 0x80000000 | message length, reqID, message
+func (f *frame) writeReply(reqID uint32, payload []byte, err error) error {
+	if err == nil {
+		if e := f.writeUint32(0x80000000); e != nil {
+			return e
+		}
+		if e := f.writeUint32(reqID); e != nil {
+			return e
+		}
+		if e := f.writeUint32(uint32(len(payload))); e != nil {
+			return e
+		}
+		_, e := f.Write(payload)
+		return e
 	}
-	if _, err := os.Stdout.Write(b); err != nil {
-		return err
+	s := err.Error()
+	if s == "" {
+		s = "unknown error"
 	}
-	ods.ODS("  -> Binary(Len: %d)", len(b))
+	if e := f.writeUint32(uint32(len(s)&0x7fffffff) | 0x80000000); e != nil {
+		return e
+	}
+	if e := f.writeUint32(reqID); e != nil {
+		return e
+	}
+	if _, e := f.WriteString(s); e != nil {
+		return e
+	}
+	ods.ODS("  -> Error: %v", err)
 	return nil
 }
 
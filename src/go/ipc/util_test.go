@@ -0,0 +1,166 @@
+package ipc
+
+import (
+	"bytes"
+	"encoding/binary"
+	"hash/fnv"
+	"image"
+	"runtime"
+	"sync"
+	"testing"
+)
+
+// copyWithOffsetBGRAPerPixel is the per-pixel implementation that copyWithOffsetBGRA replaced.
+// It is kept as the reference for tests and benchmarks.
+func copyWithOffsetBGRAPerPixel(dst []byte, dstW, dstH int, src *image.NRGBA, offsetX, offsetY int, flipX, flipY bool) {
+	dstStride := dstW * 4
+
+	// Invert offset for flipped axes to maintain correct positioning after GPU flip
+	// (see function comment for detailed explanation)
+	if flipX {
+		offsetX = -offsetX
+	}
+	if flipY {
+		offsetY = -offsetY
+	}
+
+	numWorkers := runtime.NumCPU()
+	rowsPerWorker := (dstH + numWorkers - 1) / numWorkers
+
+	var wg sync.WaitGroup
+	for w := 0; w < numWorkers; w++ {
+		startY := w * rowsPerWorker
+		endY := startY + rowsPerWorker
+		if endY > dstH {
+			endY = dstH
+		}
+		if startY >= dstH {
+			break
+		}
+
+		wg.Add(1)
+		go func(startY, endY int) {
+			defer wg.Done()
+			for dy := startY; dy < endY; dy++ {
+				// Bottom-up: image row dy is stored at memory row dstH-1-dy
+				dstRowStart := (dstH - 1 - dy) * dstStride
+				for dx := 0; dx < dstW; dx++ {
+					// Calculate source coordinates with offset
+					sx := dx - offsetX
+					sy := dy - offsetY
+
+					// Bounds check
+					if !image.Pt(sx, sy).In(src.Rect) {
+						continue // Leave dst pixel as zero (transparent)
+					}
+
+					srcIdx := (sy-src.Rect.Min.Y)*src.Stride + (sx-src.Rect.Min.X)*4
+					dstIdx := dstRowStart + dx*4
+
+					// Copy with RGBA -> BGRA swap (only if alpha > 0)
+					if src.Pix[srcIdx+3] > 0 {
+						dst[dstIdx+0] = src.Pix[srcIdx+2] // B <- R
+						dst[dstIdx+1] = src.Pix[srcIdx+1] // G <- G
+						dst[dstIdx+2] = src.Pix[srcIdx+0] // R <- B
+						dst[dstIdx+3] = src.Pix[srcIdx+3] // A <- A
+					}
+				}
+			}
+		}(startY, endY)
+	}
+	wg.Wait()
+}
+
+func testImage(w, h int) *image.NRGBA {
+	img := image.NewNRGBA(image.Rect(0, 0, w, h))
+	v := uint32(0x12345678)
+	for i := range img.Pix {
+		v = v*1664525 + 1013904223
+		img.Pix[i] = byte(v >> 24)
+	}
+	// Make some pixels fully transparent with leftover color
+	for i := 3; i < len(img.Pix); i += 12 {
+		img.Pix[i] = 0
+	}
+	return img
+}
+
+func TestCopyWithOffsetBGRA(t *testing.T) {
+	src := testImage(37, 23)
+	testData := []struct {
+		W, H, X, Y   int
+		FlipX, FlipY bool
+	}{
+		{W: 37, H: 23},
+		{W: 50, H: 40, X: 5, Y: 7},
+		{W: 20, H: 10, X: -8, Y: -3},
+		{W: 40, H: 30, X: 10, Y: -5, FlipX: true},
+		{W: 40, H: 30, X: -10, Y: 5, FlipY: true},
+		{W: 40, H: 30, X: 100, Y: 0},
+		{W: 40, H: 30, X: 0, Y: -100},
+		{W: 1, H: 1, X: -36, Y: -22},
+	}
+	// A sub-image keeps the coordinates of its parent, so it lands at its own Rect.Min plus the offset
+	sub := src.SubImage(image.Rect(6, 4, 30, 19)).(*image.NRGBA)
+	for i, data := range testData {
+		for _, im := range []*image.NRGBA{src, sub} {
+			want := make([]byte, data.W*data.H*4)
+			got := make([]byte, data.W*data.H*4)
+			copyWithOffsetBGRAPerPixel(want, data.W, data.H, im, data.X, data.Y, data.FlipX, data.FlipY)
+			copyWithOffsetBGRA(got, data.W, data.H, im, data.X, data.Y, data.FlipX, data.FlipY)
+			if !bytes.Equal(want, got) {
+				t.Errorf("#%d %v: output differs from the per-pixel implementation", i, im.Rect)
+			}
+		}
+	}
+	want := make([]byte, 40*30*4)
+	copyWithOffsetBGRA(want, 40, 30, sub, 2, 3, false, false)
+	for y := 0; y < 30; y++ {
+		for x := 0; x < 40; x++ {
+			d := want[((30-1-y)*40+x)*4:][:4]
+			var c [4]byte
+			if p := image.Pt(x-2, y-3); p.In(sub.Rect) {
+				if s := sub.Pix[sub.PixOffset(p.X, p.Y):][:4]; s[3] > 0 {
+					c = [4]byte{s[2], s[1], s[0], s[3]}
+				}
+			}
+			if !bytes.Equal(d, c[:]) {
+				t.Fatalf("sub-image: pixel (%d, %d) want %v got %v", x, y, c, d)
+			}
+		}
+	}
+}
+
+func benchmarkCopy(b *testing.B, fn func([]byte, int, int, *image.NRGBA, int, int, bool, bool)) {
+	src := testImage(1000, 1600)
+	dst := make([]byte, 1200*1800*4)
+	b.SetBytes(int64(len(src.Pix)))
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		fn(dst, 1200, 1800, src, 100, 100, false, false)
+	}
+}
+
+func BenchmarkCopyWithOffsetBGRA(b *testing.B) {
+	benchmarkCopy(b, copyWithOffsetBGRA)
+}
+
+func BenchmarkCopyWithOffsetBGRAPerPixel(b *testing.B) {
+	benchmarkCopy(b, copyWithOffsetBGRAPerPixel)
+}
+
+func TestFNV64a(t *testing.T) {
+	want := fnv.New64a()
+	var b [8]byte
+	binary.LittleEndian.PutUint32(b[:4], 0xdeadbeef)
+	want.Write(b[:4])
+	binary.LittleEndian.PutUint64(b[:], 0x0123456789abcdef)
+	want.Write(b[:])
+
+	got := newFNV64a()
+	got.u32(0xdeadbeef)
+	got.u64(0x0123456789abcdef)
+	if uint64(got) != want.Sum64() {
+		t.Errorf("want %016x got %016x", want.Sum64(), uint64(got))
+	}
+}
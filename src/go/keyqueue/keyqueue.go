@@ -0,0 +1,185 @@
+// Package keyqueue runs jobs in FIFO order per key while jobs for different keys run concurrently.
+package keyqueue
+
+import (
+	"sync"
+)
+
+// Priority decides which waiting key gets the next free worker.
+type Priority int
+
+const (
+	// PriorityHigh is for rendering requested by the timeline.
+	PriorityHigh Priority = iota
+	// PriorityNormal is for interactive previews.
+	PriorityNormal
+	// PriorityLow is for background work such as prefetching files.
+	PriorityLow
+
+	numPriorities
+)
+
+type job struct {
+	fn  func()
+	pri Priority
+}
+
+// keyState holds the jobs waiting for one key.
+type keyState struct {
+	jobs    []job
+	running bool
+	// queued is the ready list the key is waiting in, or -1.
+	// Entries in other lists are stale and skipped.
+	queued Priority
+}
+
+// priority returns the highest priority among the jobs of the key,
+// so a job is never held back by a less urgent job queued before it.
+func (ks *keyState) priority() Priority {
+	p := numPriorities - 1
+	for _, j := range ks.jobs {
+		if j.pri < p {
+			p = j.pri
+		}
+	}
+	return p
+}
+
+type KeyQueue struct {
+	m       sync.Mutex
+	pending map[interface{}]*keyState
+	ready   [numPriorities][]interface{}
+	workers int
+	idle    int
+	running [numPriorities]int
+}
+
+// New creates a KeyQueue that runs at most workers jobs at the same time.
+func New(workers int) *KeyQueue {
+	if workers < 1 {
+		workers = 1
+	}
+	return &KeyQueue{
+		pending: map[interface{}]*keyState{},
+		workers: workers,
+		idle:    workers,
+	}
+}
+
+// Enqueue schedules job with PriorityNormal.
+func (kq *KeyQueue) Enqueue(key interface{}, job func()) {
+	kq.EnqueuePriority(key, PriorityNormal, job)
+}
+
+// EnqueuePriority schedules job to run after all jobs previously enqueued with the same key.
+// When workers are busy, keys with more urgent jobs are started first.
+// key must be comparable.
+func (kq *KeyQueue) EnqueuePriority(key interface{}, pri Priority, fn func()) {
+	if pri < PriorityHigh || pri >= numPriorities {
+		pri = PriorityNormal
+	}
+	kq.m.Lock()
+	defer kq.m.Unlock()
+	ks, ok := kq.pending[key]
+	if !ok {
+		ks = &keyState{queued: -1}
+		kq.pending[key] = ks
+	}
+	ks.jobs = append(ks.jobs, job{fn: fn, pri: pri})
+	if !ks.running {
+		kq.makeReady(key, ks)
+	}
+	for kq.idle > 0 {
+		key, p, ok := kq.pick()
+		if !ok {
+			break
+		}
+		ks := kq.pending[key]
+		go kq.work(key, ks, kq.start(ks, p), p)
+	}
+}
+
+// makeReady puts key in the ready list that matches its jobs.
+func (kq *KeyQueue) makeReady(key interface{}, ks *keyState) {
+	p := ks.priority()
+	if ks.queued >= 0 && ks.queued <= p {
+		return
+	}
+	ks.queued = p
+	kq.ready[p] = append(kq.ready[p], key)
+}
+
+// head drops stale entries from the ready list of p and reports whether a key is waiting in it.
+func (kq *KeyQueue) head(p Priority) bool {
+	for len(kq.ready[p]) > 0 {
+		if ks := kq.pending[kq.ready[p][0]]; ks != nil && !ks.running && ks.queued == p {
+			return true
+		}
+		kq.ready[p][0] = nil
+		kq.ready[p] = kq.ready[p][1:]
+	}
+	return false
+}
+
+// pick removes and returns the next key to run.
+func (kq *KeyQueue) pick() (interface{}, Priority, bool) {
+	var waiting [numPriorities]bool
+	for p := range waiting {
+		waiting[p] = kq.head(Priority(p))
+	}
+	for p := range waiting {
+		if !waiting[p] {
+			continue
+		}
+		// The last free worker goes to the other of High and Normal if this one already holds all the others,
+		// so a burst of one class never makes the other wait for a whole batch.
+		// Low is tried last and is never given the worker in place of them.
+		if Priority(p) != PriorityLow && waiting[PriorityHigh] && waiting[PriorityNormal] &&
+			kq.workers > 1 && kq.idle == 1 && kq.running[p] == kq.workers-1 {
+			continue
+		}
+		key := kq.ready[p][0]
+		kq.ready[p][0] = nil
+		kq.ready[p] = kq.ready[p][1:]
+		return key, Priority(p), true
+	}
+	return nil, 0, false
+}
+
+// start takes a worker and the first job of ks.
+func (kq *KeyQueue) start(ks *keyState, p Priority) job {
+	kq.idle--
+	kq.running[p]++
+	ks.running = true
+	ks.queued = -1
+	j := ks.jobs[0]
+	ks.jobs[0] = job{}
+	ks.jobs = ks.jobs[1:]
+	return j
+}
+
+// work runs j and then keeps taking the most urgent waiting key until none is left.
+func (kq *KeyQueue) work(key interface{}, ks *keyState, j job, p Priority) {
+	for {
+		j.fn()
+
+		kq.m.Lock()
+		kq.idle++
+		kq.running[p]--
+		ks.running = false
+		if len(ks.jobs) == 0 {
+			delete(kq.pending, key)
+		} else {
+			kq.makeReady(key, ks)
+		}
+		var ok bool
+		key, p, ok = kq.pick()
+		if !ok {
+			kq.m.Unlock()
+			return
+		}
+		ks = kq.pending[key]
+		j = kq.start(ks, p)
+		kq.m.Unlock()
+	}
+}
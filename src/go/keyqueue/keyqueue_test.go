@@ -0,0 +1,228 @@
+package keyqueue
+
+import (
+	"sync"
+	"testing"
+	"time"
+)
+
+func TestSameKeyInOrder(t *testing.T) {
+	kq := New(4)
+
+	var got []int
+	var m sync.Mutex
+	var wg sync.WaitGroup
+	for i := 0; i < 10; i++ {
+		i := i
+		wg.Add(1)
+		kq.Enqueue("a", func() {
+			defer wg.Done()
+			time.Sleep(time.Duration(10-i) * time.Millisecond)
+			m.Lock()
+			got = append(got, i)
+			m.Unlock()
+		})
+	}
+	wg.Wait()
+	for i, v := range got {
+		if v != i {
+			t.Fatalf("want in order, got %v", got)
+		}
+	}
+}
+
+func TestDifferentKeysConcurrently(t *testing.T) {
+	kq := New(2)
+
+	started := make(chan struct{}, 2)
+	release := make(chan struct{})
+	var wg sync.WaitGroup
+	for _, key := range []string{"a", "b"} {
+		wg.Add(1)
+		kq.Enqueue(key, func() {
+			defer wg.Done()
+			started <- struct{}{}
+			<-release
+		})
+	}
+	for i := 0; i < 2; i++ {
+		select {
+		case <-started:
+		case <-time.After(time.Second):
+			t.Fatal("jobs for different keys did not run concurrently")
+		}
+	}
+	close(release)
+	wg.Wait()
+}
+
+func TestWorkerLimit(t *testing.T) {
+	kq := New(1)
+
+	var running, peak int
+	var m sync.Mutex
+	var wg sync.WaitGroup
+	for i := 0; i < 4; i++ {
+		wg.Add(1)
+		kq.Enqueue(i, func() {
+			defer wg.Done()
+			m.Lock()
+			running++
+			if running > peak {
+				peak = running
+			}
+			m.Unlock()
+			time.Sleep(5 * time.Millisecond)
+			m.Lock()
+			running--
+			m.Unlock()
+		})
+	}
+	wg.Wait()
+	if peak != 1 {
+		t.Errorf("want peak 1, got %d", peak)
+	}
+}
+
+func TestPriorityOrder(t *testing.T) {
+	kq := New(1)
+
+	release := make(chan struct{})
+	var got []string
+	var m sync.Mutex
+	var wg sync.WaitGroup
+	wg.Add(4)
+	kq.Enqueue("busy", func() {
+		defer wg.Done()
+		<-release
+	})
+	for _, v := range []struct {
+		key string
+		pri Priority
+	}{
+		{"low", PriorityLow},
+		{"normal", PriorityNormal},
+		{"high", PriorityHigh},
+	} {
+		key := v.key
+		kq.EnqueuePriority(key, v.pri, func() {
+			defer wg.Done()
+			m.Lock()
+			got = append(got, key)
+			m.Unlock()
+		})
+	}
+	close(release)
+	wg.Wait()
+	want := []string{"high", "normal", "low"}
+	for i := range want {
+		if got[i] != want[i] {
+			t.Fatalf("want %v, got %v", want, got)
+		}
+	}
+}
+
+func TestLastWorkerGoesToOtherClass(t *testing.T) {
+	kq := New(2)
+
+	releaseA, releaseC, release := make(chan struct{}), make(chan struct{}), make(chan struct{})
+	started := make(chan string, 4)
+	var wg sync.WaitGroup
+	wg.Add(4)
+	run := func(name string, release chan struct{}) func() {
+		return func() {
+			defer wg.Done()
+			started <- name
+			<-release
+		}
+	}
+	kq.EnqueuePriority("a", PriorityHigh, run("a", releaseA))
+	kq.EnqueuePriority("c", PriorityNormal, run("c", releaseC))
+	<-started
+	<-started
+	kq.EnqueuePriority("b", PriorityHigh, run("b", release))
+	kq.EnqueuePriority("preview", PriorityNormal, run("preview", release))
+	// "a" still holds one worker, so the freed one must not go to another high priority job.
+	close(releaseC)
+	select {
+	case v := <-started:
+		if v != "preview" {
+			t.Errorf("want preview, got %s", v)
+		}
+	case <-time.After(time.Second):
+		t.Fatal("no job started")
+	}
+	close(releaseA)
+	close(release)
+	wg.Wait()
+}
+
+func TestLastWorkerNotGivenToLow(t *testing.T) {
+	kq := New(3)
+
+	releaseC, release := make(chan struct{}), make(chan struct{})
+	started := make(chan string, 5)
+	var wg sync.WaitGroup
+	wg.Add(5)
+	run := func(name string, release chan struct{}) func() {
+		return func() {
+			defer wg.Done()
+			started <- name
+			<-release
+		}
+	}
+	kq.EnqueuePriority("a", PriorityHigh, run("a", release))
+	kq.EnqueuePriority("b", PriorityHigh, run("b", release))
+	kq.EnqueuePriority("c", PriorityNormal, run("c", releaseC))
+	for i := 0; i < 3; i++ {
+		<-started
+	}
+	kq.EnqueuePriority("prefetch", PriorityLow, run("prefetch", release))
+	kq.EnqueuePriority("d", PriorityHigh, run("d", release))
+	// High already holds all but one worker, but the freed one must still not go to the low priority job.
+	close(releaseC)
+	select {
+	case v := <-started:
+		if v != "d" {
+			t.Errorf("want d, got %s", v)
+		}
+	case <-time.After(time.Second):
+		t.Fatal("no job started")
+	}
+	close(release)
+	wg.Wait()
+}
+
+func TestRaisedPriority(t *testing.T) {
+	kq := New(1)
+
+	release := make(chan struct{})
+	var got []string
+	var m sync.Mutex
+	var wg sync.WaitGroup
+	wg.Add(4)
+	record := func(name string) func() {
+		return func() {
+			defer wg.Done()
+			m.Lock()
+			got = append(got, name)
+			m.Unlock()
+		}
+	}
+	kq.Enqueue("busy", func() {
+		defer wg.Done()
+		<-release
+	})
+	kq.EnqueuePriority("a", PriorityNormal, record("a"))
+	kq.EnqueuePriority("b", PriorityLow, record("b1"))
+	// b now has a high priority job behind its low one, so it goes first and both run in order.
+	kq.EnqueuePriority("b", PriorityHigh, record("b2"))
+	close(release)
+	wg.Wait()
+	want := []string{"b1", "b2", "a"}
+	for i := range want {
+		if got[i] != want[i] {
+			t.Fatalf("want %v, got %v", want, got)
+		}
+	}
+}
@@ -0,0 +1,127 @@
+// Package lru implements a byte-budgeted least recently used cache.
+package lru
+
+import (
+	"container/list"
+	"sync"
+	"time"
+)
+
+type entry struct {
+	key        interface{}
+	data       []byte
+	lastAccess time.Time
+}
+
+// Stats is a snapshot of the cache counters.
+type Stats struct {
+	Hits      uint64
+	Misses    uint64
+	Evictions uint64
+	Entries   int
+	Bytes     int64
+	Limit     int64
+}
+
+// Cache holds byte slices up to a total size limit, evicting the least recently used first.
+// It is safe for concurrent use.
+type Cache struct {
+	m       sync.Mutex
+	limit   int64
+	bytes   int64
+	ll      *list.List // front is the most recently used
+	entries map[interface{}]*list.Element
+
+	hits, misses, evictions uint64
+}
+
+// New creates a Cache that holds at most limit bytes.
+// If limit is 0 or less, the cache is disabled and never stores anything.
+func New(limit int64) *Cache {
+	return &Cache{
+		limit:   limit,
+		ll:      list.New(),
+		entries: map[interface{}]*list.Element{},
+	}
+}
+
+// Enabled reports whether the cache stores anything.
+func (c *Cache) Enabled() bool {
+	return c.limit > 0
+}
+
+// Get returns the data stored for key and marks it as recently used.
+// The returned slice must not be modified.
+func (c *Cache) Get(key interface{}) ([]byte, bool) {
+	c.m.Lock()
+	defer c.m.Unlock()
+	e, ok := c.entries[key]
+	if !ok {
+		c.misses++
+		return nil, false
+	}
+	c.hits++
+	ent := e.Value.(*entry)
+	ent.lastAccess = time.Now()
+	c.ll.MoveToFront(e)
+	return ent.data, true
+}
+
+// Put stores data for key, evicting old entries as needed.
+// Data larger than the limit is not stored. The cache keeps a reference to data.
+func (c *Cache) Put(key interface{}, data []byte) {
+	size := int64(len(data))
+	if c.limit <= 0 || size > c.limit {
+		return
+	}
+	c.m.Lock()
+	defer c.m.Unlock()
+	if e, ok := c.entries[key]; ok {
+		ent := e.Value.(*entry)
+		c.bytes += size - int64(len(ent.data))
+		ent.data = data
+		ent.lastAccess = time.Now()
+		c.ll.MoveToFront(e)
+	} else {
+		c.entries[key] = c.ll.PushFront(&entry{key: key, data: data, lastAccess: time.Now()})
+		c.bytes += size
+	}
+	for c.bytes > c.limit {
+		c.removeElement(c.ll.Back())
+		c.evictions++
+	}
+}
+
+// Prune removes entries that have not been used for d.
+func (c *Cache) Prune(d time.Duration) {
+	deadline := time.Now().Add(-d)
+	c.m.Lock()
+	defer c.m.Unlock()
+	for e := c.ll.Back(); e != nil; e = c.ll.Back() {
+		if e.Value.(*entry).lastAccess.After(deadline) {
+			return
+		}
+		c.removeElement(e)
+		c.evictions++
+	}
+}
+
+// Stats returns a snapshot of the cache counters.
+func (c *Cache) Stats() Stats {
+	c.m.Lock()
+	defer c.m.Unlock()
+	return Stats{
+		Hits:      c.hits,
+		Misses:    c.misses,
+		Evictions: c.evictions,
+		Entries:   len(c.entries),
+		Bytes:     c.bytes,
+		Limit:     c.limit,
+	}
+}
+
+func (c *Cache) removeElement(e *list.Element) {
+	ent := c.ll.Remove(e).(*entry)
+	delete(c.entries, ent.key)
+	c.bytes -= int64(len(ent.data))
+}
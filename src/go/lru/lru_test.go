@@ -0,0 +1,77 @@
+package lru
+
+import (
+	"testing"
+	"time"
+)
+
+func TestEvictsLeastRecentlyUsed(t *testing.T) {
+	c := New(30)
+	c.Put("a", make([]byte, 10))
+	c.Put("b", make([]byte, 10))
+	c.Put("c", make([]byte, 10))
+	if _, ok := c.Get("a"); !ok {
+		t.Fatal("want a to be cached")
+	}
+	c.Put("d", make([]byte, 10))
+	if _, ok := c.Get("b"); ok {
+		t.Fatal("want b to be evicted")
+	}
+	for _, k := range []string{"a", "c", "d"} {
+		if _, ok := c.Get(k); !ok {
+			t.Fatalf("want %s to be cached", k)
+		}
+	}
+	s := c.Stats()
+	if s.Hits != 4 || s.Misses != 1 || s.Evictions != 1 || s.Entries != 3 || s.Bytes != 30 {
+		t.Fatalf("unexpected stats %+v", s)
+	}
+}
+
+func TestReplaceUpdatesSize(t *testing.T) {
+	c := New(100)
+	c.Put("a", make([]byte, 10))
+	c.Put("a", make([]byte, 40))
+	if s := c.Stats(); s.Entries != 1 || s.Bytes != 40 {
+		t.Fatalf("unexpected stats %+v", s)
+	}
+	c.Put("b", make([]byte, 70))
+	if _, ok := c.Get("a"); ok {
+		t.Fatal("want a to be evicted")
+	}
+	if s := c.Stats(); s.Bytes != 70 {
+		t.Fatalf("unexpected stats %+v", s)
+	}
+}
+
+func TestTooLargeAndDisabled(t *testing.T) {
+	c := New(10)
+	c.Put("a", make([]byte, 11))
+	if _, ok := c.Get("a"); ok {
+		t.Fatal("want data larger than the limit to be dropped")
+	}
+
+	d := New(0)
+	if d.Enabled() {
+		t.Fatal("want disabled cache")
+	}
+	d.Put("a", nil)
+	d.Put("b", make([]byte, 1))
+	if s := d.Stats(); s.Entries != 0 {
+		t.Fatalf("unexpected stats %+v", s)
+	}
+}
+
+func TestPrune(t *testing.T) {
+	c := New(100)
+	c.Put("old", make([]byte, 10))
+	time.Sleep(20 * time.Millisecond)
+	c.Put("new", make([]byte, 10))
+	c.Prune(10 * time.Millisecond)
+	if _, ok := c.Get("old"); ok {
+		t.Fatal("want old to be pruned")
+	}
+	if _, ok := c.Get("new"); !ok {
+		t.Fatal("want new to be kept")
+	}
+}
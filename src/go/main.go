@@ -20,6 +20,10 @@ import (
 var gitTag string
 var gitRevision string
 
+// drawCacheMB is passed by the plugin from the draw_cache_size setting. It defaults to 0
+// because the plugin's own frame cache already holds what this one would.
+var drawCacheMB = flag.Int("drawcache", 0, "size limit of the rendered frame cache in MiB, 0 disables it")
+
 func init() {
 	runtime.LockOSThread()
 }
@@ -43,6 +47,7 @@ func main() {
 	flag.Parse()
 
 	srcs := &source.Sources{Logger: odsLogger{}}
+	ipcm := ipc.New(srcs, int64(*drawCacheMB)*1024*1024)
 
 	// Create and start the Editing actor
 	ed := editing.New(srcs)
@@ -50,7 +55,6 @@ func main() {
 	defer cancelEditing()
 	go ed.Run(ctx)
 
-	ipcm := ipc.New(srcs)
 	g := gui.New(ed)
 
 	ipcm.AddFile = g.AddFileSync
@@ -139,54 +139,45 @@ function PSD:draw(obj)
 	-- Get resize quality from config
 	local quality = config.get().resize_quality
 
-	-- Call set_props to get cache key, dimensions, and flip flags
-	-- modified: indicates whether properties (layer, scale, offset) changed since last call.
-	--           This does NOT indicate cache existence. Even if modified=false, cache may not exist
-	--           (e.g., after state changes A->B->A, modified=false but cache for A may be evicted).
+	-- Call draw_batch to get cache key, dimensions, and flip flags.
+	-- Properties are sent and, if the image is not in the cache yet, it is rendered
+	-- in the same call. Sizes are already clamped to image_max.
 	-- flip_x, flip_y: flip flags for GPU-side flip processing
-	local modified, cachekey_hex, width, height, flip_x, flip_y = ptk.set_props(self.id, self.file, {
+	local mw, mh = obj.getinfo("image_max")
+	local item = {
+		id = self.id,
+		file = self.file,
 		tag = self.tag,
 		layer = layer_str,
 		scale = self.scale,
 		offsetx = self.offsetx,
 		offsety = self.offsety,
 		quality = quality,
-	})
+	}
+	local cachekeys, widths, heights, flip_xs, flip_ys = ptk.draw_batch(mw, mh, item)
+	if #cachekeys ~= 1 then
+		error("failed to render image")
+	end
+	local cachekey_hex = cachekeys[1]
+	local flip_x, flip_y = flip_xs[1] ~= 0, flip_ys[1] ~= 0
 	dbg(
-		"PSD:draw: id=%s modified=%s cachekey=%s size=%sx%s flip=%s,%s",
+		"PSD:draw: id=%s cachekey=%s size=%sx%s flip=%s,%s",
 		tostring(self.id),
-		tostring(modified),
 		tostring(cachekey_hex),
-		tostring(width),
-		tostring(height),
+		tostring(widths[1]),
+		tostring(heights[1]),
 		tostring(flip_x),
 		tostring(flip_y)
 	)
 
-	local mw, mh = obj.getinfo("image_max")
-	if width > mw then
-		width = mw
-	end
-	if height > mh then
-		height = mh
-	end
-
-	if modified then
-		-- Properties changed, need to draw first
-		local ok = ptk.draw(self.id, self.file, width, height, cachekey_hex)
-		if not ok then
-			error("failed to render image")
-		end
-	end
-
 	-- Try to load from cache
 	obj.load("image", cachekey_hex .. ".ptkcache")
 
-	-- If cache miss and not modified, draw and retry
-	if (obj.w == 0 or obj.h == 0) and not modified then
+	-- The entry may have been evicted in the meantime, render it again and retry
+	if obj.w == 0 or obj.h == 0 then
 		dbg("PSD:draw: cache miss, rendering")
-		local ok = ptk.draw(self.id, self.file, width, height, cachekey_hex)
-		if not ok then
+		cachekeys = ptk.draw_batch(mw, mh, item)
+		if #cachekeys ~= 1 then
 			error("failed to render image")
 		end
 		obj.load("image", cachekey_hex .. ".ptkcache")